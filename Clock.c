@@ -0,0 +1,48 @@
+#include "Clock.h"
+#include "Param.h"
+#include "Trace.h"
+
+#if defined(BUILD_MODULE)
+    #include "module_cfg.h"
+#else
+    #include "kernel_cfg.h"
+#endif
+
+/* マクロ定義 */
+#define WAIT_TIMEOUT    (CLOCK_PERIOD_US * 4)   // 周期ハンドラが停止している場合に待機を打ち切る時間[us]
+
+/* グローバル宣言 */
+static volatile uint32_t ticks = 0;     // 周期ハンドラの起動回数
+static uint32_t wait_ticks = 0;         // 前回のClock_waitから戻ったときの起動回数
+
+/* 関数 */
+
+// 時刻を進めて待機中のループを起こす(周期ハンドラのみが呼ぶ)
+// セマフォの上限は1のため、ループの処理が周期に間に合わなかった場合も溜まる起床は1回分のみ
+void Clock_tick(void)
+{
+    ticks = ticks + 1;
+    sig_sem(CLOCK_SEM);
+}
+
+// 次の周期まで待機
+// 待機から戻った直後(周期の境目)に、Bluetoothから受け取ったパラメータの変更を反映する(Param.h)
+uint32_t Clock_wait(void)
+{
+    uint32_t now, elapsed;
+    uint32_t start = Trace_now();
+
+    twai_sem(CLOCK_SEM, WAIT_TIMEOUT);
+    now = ticks;
+    elapsed = now - wait_ticks;
+    wait_ticks = now;
+    Trace_span(TRACE_WAIT, start, elapsed);     // 待機した時間をトレースに記録
+    Param_apply();
+    return elapsed;
+}
+
+// 周期ハンドラの起動回数を取得
+uint32_t Clock_getTicks(void)
+{
+    return ticks;
+}
@@ -0,0 +1,30 @@
+#ifndef INCLUDED_Clock_h_
+#define INCLUDED_Clock_h_
+
+// 制御周期の時刻
+// 周期ハンドラ(datalog_cyc)の起動1回を1周期とし、走行データの更新・走行命令の実行・各区間のループをすべてこの周期で動かす
+// 各区間のループは処理後にtslp_tskで待つのではなく、Clock_waitで周期ハンドラの次の更新を待つ(処理時間によって周期がずれない)
+// *app.cfgからもインクルードするため、マクロ以外はTOPPERS_MACRO_ONLYの外に書くこと
+
+/* マクロ定義 */
+#ifndef CLOCK_PERIOD_MS
+#define CLOCK_PERIOD_MS     5       // 制御周期[ms](1ms単位。ビルド時に -DCLOCK_PERIOD_MS=2 などで変更できる)
+#endif
+
+#define CLOCK_PERIOD_US     (CLOCK_PERIOD_MS * 1000)            // 制御周期[us](周期ハンドラの周期)
+#define CLOCK_DT            (CLOCK_PERIOD_MS / 1000.0)          // 制御周期[s]
+#define CLOCK_TICKS(ms)     (((ms) + CLOCK_PERIOD_MS - 1) / CLOCK_PERIOD_MS)   // 指定時間[ms]に相当する周期数(切り上げ)
+
+#ifndef TOPPERS_MACRO_ONLY
+
+#include "ev3api.h"
+
+/* 関数プロトタイプ宣言 */
+void     Clock_tick(void);          // 周期ハンドラ：1周期分の更新を終えたら呼び、時刻を進めて待機中のループを起こす
+uint32_t Clock_wait(void);          // 区間のループ：次の周期まで待機し、前回の待機からの経過周期数を返す(処理が1周期を超えた場合は2以上)
+                                    //  戻る前にパラメータの変更要求を反映する(Param_apply)
+uint32_t Clock_getTicks(void);      // 周期ハンドラの起動回数(初期化しない通算の値)
+
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+#include "Color.h"
+
+/* マクロ定義 */
+#define BIN_MAX     (COLOR_RULE_MAX * 2 + 1)    // 1チャンネルあたりの区間数の最大値
+#define RULE(set, rule)     Color_build(set, rule, sizeof(rule) / sizeof(rule[0]))  // 判定条件の配列から組の参照テーブルを作成
+
+/* グローバル宣言 */
+// 既定の判定条件(実機の走行ログから決めた値。各区間で使っていた条件をそのまま組にしたもの)
+//  色              R(min, max)         G(min, max)         B(min, max)
+static const color_rule_t rule_line[] = {
+    {   COLOR_BLACK,     0,  60,             0,  90,             0,  90             },
+};
+static const color_rule_t rule_linetrace[] = {
+    {   COLOR_BLUE,      0,  65,             0,  90,            71, COLOR_RAW_MAX   },
+};
+static const color_rule_t rule_slalom[] = {
+    {   COLOR_BLACK,     0,  65,             0,  75,             0,  95             },
+    {   COLOR_BLUE,      0,  75,             0,  95,           121, COLOR_RAW_MAX   },
+};
+static const color_rule_t rule_block[] = {
+    {   COLOR_YELLOW,   91, COLOR_RAW_MAX,  91, COLOR_RAW_MAX,   0,  30             },
+    {   COLOR_RED,      76, COLOR_RAW_MAX,   0,  40,             0,  50             },
+    {   COLOR_BLACK,     0,  60,             0,  60,             0,  60             },
+    {   COLOR_BLUE,      0,  75,             0,  95,           121, COLOR_RAW_MAX   },
+};
+
+/* 組ごとの参照テーブル */
+typedef struct {
+    uint8_t bin_r[COLOR_RAW_MAX], bin_g[COLOR_RAW_MAX], bin_b[COLOR_RAW_MAX];   // チャンネルごとの区間番号(生値 -> 区間)
+    uint8_t num_g, num_b;
+    uint8_t lut[BIN_MAX * BIN_MAX * BIN_MAX];                                   // 区間の組み合わせごとの色
+} color_table_t;
+
+static color_table_t table[TNUM_COLOR_SET];
+
+/* 関数 */
+
+// 区切り値の一覧から、生値 -> 区間番号のテーブルを作成する。区間の下端の値をlowerに返す
+static uint8_t Color_makeBins(uint8_t *bin, const uint16_t *edge, int num_edge, uint16_t *lower)
+{
+    uint8_t n = 0;
+    int v, i;
+
+    lower[0] = 0;
+    for(v = 0; v < COLOR_RAW_MAX; v++)
+    {
+        for(i = 0; i < num_edge; i++)
+        {
+            if(edge[i] == v && v != 0 && lower[n] != v) // 区切り値で新しい区間を始める
+            {
+                lower[++n] = v;
+                break;
+            }
+        }
+        bin[v] = n;
+    }
+    return n + 1;
+}
+
+// 既定の判定条件ですべての組の参照テーブルを作成
+void Color_init(void)
+{
+    RULE(COLOR_SET_LINE,      rule_line);
+    RULE(COLOR_SET_LINETRACE, rule_linetrace);
+    RULE(COLOR_SET_SLALOM,    rule_slalom);
+    RULE(COLOR_SET_BLOCK,     rule_block);
+}
+
+// 判定条件を指定して組の参照テーブルを作成
+void Color_build(color_set_t set, const color_rule_t *rule, int num)
+{
+    color_table_t *t = &table[set];
+    uint16_t edge_r[COLOR_RULE_MAX * 2], edge_g[COLOR_RULE_MAX * 2], edge_b[COLOR_RULE_MAX * 2];
+    uint16_t low_r[BIN_MAX], low_g[BIN_MAX], low_b[BIN_MAX];
+    uint8_t num_r;
+    int r, g, b, i;
+    colorid_t color;
+
+    if(num > COLOR_RULE_MAX)
+        num = COLOR_RULE_MAX;
+
+    for(i = 0; i < num; i++)        // 判定条件の境界を区切り値とする
+    {
+        edge_r[i * 2] = rule[i].r_min;  edge_r[i * 2 + 1] = rule[i].r_max;
+        edge_g[i * 2] = rule[i].g_min;  edge_g[i * 2 + 1] = rule[i].g_max;
+        edge_b[i * 2] = rule[i].b_min;  edge_b[i * 2 + 1] = rule[i].b_max;
+    }
+    num_r    = Color_makeBins(t->bin_r, edge_r, num * 2, low_r);
+    t->num_g = Color_makeBins(t->bin_g, edge_g, num * 2, low_g);
+    t->num_b = Color_makeBins(t->bin_b, edge_b, num * 2, low_b);
+
+    for(r = 0; r < num_r; r++)      // 区間の下端の値で判定条件を評価して表を埋める(区間内では判定結果が変わらない)
+    for(g = 0; g < t->num_g; g++)
+    for(b = 0; b < t->num_b; b++)
+    {
+        color = COLOR_WHITE;
+        for(i = 0; i < num; i++)
+        {
+            if(rule[i].r_min <= low_r[r] && low_r[r] < rule[i].r_max
+            && rule[i].g_min <= low_g[g] && low_g[g] < rule[i].g_max
+            && rule[i].b_min <= low_b[b] && low_b[b] < rule[i].b_max)
+            {
+                color = rule[i].color;
+                break;
+            }
+        }
+        t->lut[(r * t->num_g + g) * t->num_b + b] = color;
+    }
+}
+
+// RGB値を組の判定条件で色に分類
+colorid_t Color_classify(color_set_t set, const rgb_raw_t *rgb)
+{
+    const color_table_t *t = &table[set];
+    uint16_t r = (rgb->r < COLOR_RAW_MAX) ? rgb->r : COLOR_RAW_MAX - 1;
+    uint16_t g = (rgb->g < COLOR_RAW_MAX) ? rgb->g : COLOR_RAW_MAX - 1;
+    uint16_t b = (rgb->b < COLOR_RAW_MAX) ? rgb->b : COLOR_RAW_MAX - 1;
+
+    return (colorid_t)t->lut[(t->bin_r[r] * t->num_g + t->bin_g[g]) * t->num_b + t->bin_b[b]];
+}
@@ -0,0 +1,42 @@
+#ifndef INCLUDED_Color_h_
+#define INCLUDED_Color_h_
+
+#include "ev3api.h"
+
+// カラーセンサーのRGB値を色(colorid_t)に分類するモジュール
+// 起動時に判定条件(キャリブレーション値)から参照テーブルを作成し、走行中は表引きだけで色を判定する
+// 判定条件は実機の走行ログから区間・用途ごとに決めた値のため、用途ごとの組(color_set_t)として別々に参照テーブルを持つ
+
+/* マクロ定義 */
+#define COLOR_RAW_MAX   1024    // RGBの生値の上限(これ以上の値は上限に丸める)
+#define COLOR_RULE_MAX  8       // 判定条件の最大数
+
+/* 判定条件の組 */
+typedef enum {
+    COLOR_SET_LINE,         // 黒ラインへの復帰(ライントレース区間の区間表、Ctrl_runStop_Line)
+    COLOR_SET_LINETRACE,    // ライントレース区間の終了(2つ目の青ライン)
+    COLOR_SET_SLALOM,       // スラローム区間の終了(黒ライン、青ライン)
+    COLOR_SET_BLOCK,        // ブロック搬入区間(青・黄・黒・赤)
+    TNUM_COLOR_SET
+} color_set_t;
+
+/* 判定条件(各チャンネルが min <= 値 < max の範囲にあればその色とする) */
+typedef struct {
+    colorid_t   color;
+    uint16_t    r_min, r_max;
+    uint16_t    g_min, g_max;
+    uint16_t    b_min, b_max;
+} color_rule_t;
+
+/* 関数プロトタイプ宣言 */
+
+// 既定の判定条件ですべての組の参照テーブルを作成
+void        Color_init(void);
+
+// 判定条件を指定して組の参照テーブルを作成(先に書いた条件が優先。どの条件にも当てはまらない場合はCOLOR_WHITE)
+void        Color_build(color_set_t set, const color_rule_t *rule, int num);
+
+// RGB値を組の判定条件で色に分類
+colorid_t   Color_classify(color_set_t set, const rgb_raw_t *rgb);
+
+#endif
@@ -1,4 +1,6 @@
+#include <assert.h>
 #include "Controller.h"
+#include "Motion.h"
 
 // 英単語の省略表記についての参考サイト
 // https://progeigo.org/learning/essential-words-600-plus/#abbreviation-70
@@ -9,19 +11,15 @@
 // R/Lコースの変換
 #define EDGE 1  // 1でLコース、-1でRコース
 
-// PID用の定義
-#define DELTA_T 0.004   // 処理周期(4msの場合)
-// 下記のPID値が走行に与える影響については次のサイトが参考になります https://www.tsone.co.jp/blog/archives/889
-#define KP      1.38    // sim_power100 1.68     //sim_power80-70 1.68     //実機_power50 1.38
-#define KI      0.0     // sim_power100 0.47?    //sim_power80-70 0.00     //実機_power50 0.00
-#define KD      0.15    // sim_power100 0.50     //sim_power80-70 0.30     //実機_power50 0.15
+#define CHANGE_PERIOD_MS    5   // Ctrl_getPower_Change, Ctrl_getTurn_Changeの変化量の基準とする時間[ms]
 
-/* グローバル宣言 */
-static int32_t diff[2] = {0, 0};    // PID制御の偏差用変数
-static float integral = 0.0;        // PID制御の積分用変数
+// モーターと加減速の状態を操作してよいかの確認(周期ハンドラのMotion.cから呼ばれているか、走行命令のキューが空であること)
+#define CTRL_ASSERT_OWNER() assert(motion_owner || !Motion_isBusy())
 
+/* グローバル宣言 */
 static int8_t input_power = 0;      // 現在のモーターへの入力値を保存
 static int8_t input_turn = 0;      // 現在の旋回量を保存
+static bool_t motion_owner = false; // 走行命令のキュー(Ctrl_motion_steer*)から呼ばれている間true
 
 /* 戻り値の最大・最小値を制限する関数 *************************************/
 // n    : 制限したい値
@@ -63,6 +61,8 @@ float Ctrl_math_limit(float n, float min, float max)
 /******************************************************************************************************************************************/
 void Ctrl_motor_steer(int8_t power, int16_t turn)
 {
+    CTRL_ASSERT_OWNER();
+
     turn = turn * EDGE;   // R/Lコースの変換処理
 
     input_power = power;    // 現在の入力値を記録
@@ -76,23 +76,23 @@ void Ctrl_motor_steer(int8_t power, int16_t turn)
     
     if(power != 0 && turn == 0)                                     // 前後進
     {
-        ev3_motor_set_power(EV3_PORT_C, power);
-        ev3_motor_set_power(EV3_PORT_B, power);
+        Motor_setPower(EV3_PORT_C, power);
+        Motor_setPower(EV3_PORT_B, power);
     }
     else if(turn > 0)                                               // 右旋回
     {
-        ev3_motor_set_power(EV3_PORT_C, power);
-        ev3_motor_set_power(EV3_PORT_B, power - (turn * power / 100)); // turnをpowerの比率に合わせる
+        Motor_setPower(EV3_PORT_C, power);
+        Motor_setPower(EV3_PORT_B, power - (turn * power / 100));      // turnをpowerの比率に合わせる
     }
     else if(turn < 0)                                               // 左旋回
     {
-        ev3_motor_set_power(EV3_PORT_C, power + (turn * power / 100));  // turnをpowerの比率に合わせる
-        ev3_motor_set_power(EV3_PORT_B, power);
+        Motor_setPower(EV3_PORT_C, power + (turn * power / 100));       // turnをpowerの比率に合わせる
+        Motor_setPower(EV3_PORT_B, power);
     }
     else                                                            // 引数(0, 0)で左右モーター停止
     {
-        ev3_motor_stop(EV3_PORT_C, true);
-        ev3_motor_stop(EV3_PORT_B, true);
+        Motor_stop(EV3_PORT_C, true);
+        Motor_stop(EV3_PORT_B, true);
     }
 }
 
@@ -106,6 +106,23 @@ void Ctrl_motor_steer_alt(int8_t power, int16_t turn, float change_rate)
     Ctrl_motor_steer(power, turn);
 }
 
+/* 走行命令のキュー用のモーター制御関数 ****************************************************************************************************/
+// Motion_update(周期ハンドラ)から呼ぶ。キューの実行中はメインタスクがモーターを操作しないため、同じ状態を順番に引き継いで使う
+/******************************************************************************************************************************************/
+void Ctrl_motion_steer(int8_t power, int16_t turn)
+{
+    motion_owner = true;
+    Ctrl_motor_steer(power, turn);
+    motion_owner = false;
+}
+
+void Ctrl_motion_steer_alt(int8_t power, int16_t turn, float change_rate)
+{
+    motion_owner = true;
+    Ctrl_motor_steer_alt(power, turn, change_rate);
+    motion_owner = false;
+}
+
 //*****************************************************************************
 // 関数名 : arm_up, arm_down
 // 引数 : 無し
@@ -118,7 +135,7 @@ void Ctrl_motor_steer_alt(int8_t power, int16_t turn, float change_rate)
 void Ctrl_arm_up(uint8_t power, bool_t loop)
 {
     int32_t cur_angle = ev3_motor_get_counts(EV3_PORT_A);    // 現在のモーター角度
-    int8_t cur_power = ev3_motor_get_power(EV3_PORT_A);      // 現在のモーター出力
+    int8_t cur_power = Motor_getPower(EV3_PORT_A);           // 現在のモーター出力
 
     do
     {
@@ -136,17 +153,17 @@ void Ctrl_arm_up(uint8_t power, bool_t loop)
             }
             else                                                    // モーター出力が0となった場合
             {
-                ev3_motor_stop(EV3_PORT_A, true);                       // モーターを停止
+                Motor_stop(EV3_PORT_A, true);                           // モーターを停止
                 return;                                                 // 関数を終了
             }
         }
-        ev3_motor_set_power(EV3_PORT_A, cur_power);             // アームモーターに出力を設定
+        Motor_setPower(EV3_PORT_A, cur_power);                  // アームモーターに出力を設定
 
         if(loop)                    // loopがtrueの場合
         {
-            tslp_tsk(4 * 1000U);    /* 4msec周期起動 */
+            Clock_wait();           /* 制御周期ごとに起動 */
             cur_angle = ev3_motor_get_counts(EV3_PORT_A);    // 現在のモーター角度を更新
-            cur_power = ev3_motor_get_power(EV3_PORT_A);     // 現在のモーター出力を更新
+            cur_power = Motor_getPower(EV3_PORT_A);          // 現在のモーター出力を更新
         }
     }
     while(loop);
@@ -156,7 +173,7 @@ void Ctrl_arm_up(uint8_t power, bool_t loop)
 void Ctrl_arm_down(uint8_t power, bool_t loop)
 {
     int32_t cur_angle = ev3_motor_get_counts(EV3_PORT_A);    // 現在のモーター角度
-    int8_t cur_power = ev3_motor_get_power(EV3_PORT_A);      // 現在のモーター出力
+    int8_t cur_power = Motor_getPower(EV3_PORT_A);           // 現在のモーター出力
 
     do
     {
@@ -174,17 +191,17 @@ void Ctrl_arm_down(uint8_t power, bool_t loop)
             }
             else                                                            // モーター出力が0となった場合
             {
-                ev3_motor_stop(EV3_PORT_A, true);                               // モーターを停止
+                Motor_stop(EV3_PORT_A, true);                                   // モーターを停止
                 return;                                                         // 関数を終了
             }
         }
-        ev3_motor_set_power(EV3_PORT_A, cur_power);                     // アームモーターに出力を設定
+        Motor_setPower(EV3_PORT_A, cur_power);                          // アームモーターに出力を設定
 
         if(loop)                    // loopがtrueの場合
         {
-            tslp_tsk(4 * 1000U);    /* 4msec周期起動 */
+            Clock_wait();           /* 制御周期ごとに起動 */
             cur_angle = ev3_motor_get_counts(EV3_PORT_A);    // 現在のモーター角度を更新
-            cur_power = ev3_motor_get_power(EV3_PORT_A);     // 現在のモーター出力を更新
+            cur_power = Motor_getPower(EV3_PORT_A);          // 現在のモーター出力を更新
         }
     }
     while(loop);
@@ -201,7 +218,7 @@ void Ctrl_arm_down(uint8_t power, bool_t loop)
 void Ctrl_tale_open(uint8_t power, bool_t loop)
 {
     int32_t cur_angle = ev3_motor_get_counts(EV3_PORT_D);   // 現在のモーター角度
-    int8_t cur_power = ev3_motor_get_power(EV3_PORT_D);     // 現在のモーター出力
+    int8_t cur_power = Motor_getPower(EV3_PORT_D);          // 現在のモーター出力
 
     do
     {
@@ -219,17 +236,17 @@ void Ctrl_tale_open(uint8_t power, bool_t loop)
             }
             else                                                    // モーター出力が0となった場合
             {
-                ev3_motor_stop(EV3_PORT_D, true);                       // モーターを停止
+                Motor_stop(EV3_PORT_D, true);                           // モーターを停止
                 return;                                                 // 関数を終了
             }
         }
-        ev3_motor_set_power(EV3_PORT_D, cur_power);             // テールモーターに出力を設定
+        Motor_setPower(EV3_PORT_D, cur_power);                  // テールモーターに出力を設定
 
         if(loop)                    // loopがtrueの場合
         {
-            tslp_tsk(4 * 1000U);    /* 4msec周期起動 */
+            Clock_wait();           /* 制御周期ごとに起動 */
             cur_angle = ev3_motor_get_counts(EV3_PORT_D);    // 現在のモーター角度を更新
-            cur_power = ev3_motor_get_power(EV3_PORT_D);     // 現在のモーター出力を更新
+            cur_power = Motor_getPower(EV3_PORT_D);          // 現在のモーター出力を更新
         }
     }
     while(loop);
@@ -239,7 +256,7 @@ void Ctrl_tale_open(uint8_t power, bool_t loop)
 void Ctrl_tale_close(uint8_t power, bool_t loop)
 {
     int32_t cur_angle = ev3_motor_get_counts(EV3_PORT_D);   // 現在のモーター角度
-    int8_t cur_power = ev3_motor_get_power(EV3_PORT_D);     // 現在のモーター出力
+    int8_t cur_power = Motor_getPower(EV3_PORT_D);          // 現在のモーター出力
 
     do
     {
@@ -257,17 +274,17 @@ void Ctrl_tale_close(uint8_t power, bool_t loop)
             }
             else                                                            // モーター出力が0となった場合
             {
-                ev3_motor_stop(EV3_PORT_D, true);                               // モーターを停止
+                Motor_stop(EV3_PORT_D, true);                                   // モーターを停止
                 return;                                                         // 関数を終了
             }
         }
-        ev3_motor_set_power(EV3_PORT_D, cur_power);                     // アームモーターに出力を設定
+        Motor_setPower(EV3_PORT_D, cur_power);                          // アームモーターに出力を設定
 
         if(loop)                    // loopがtrueの場合
         {
-            tslp_tsk(4 * 1000U);    /* 4msec周期起動 */
+            Clock_wait();           /* 制御周期ごとに起動 */
             cur_angle = ev3_motor_get_counts(EV3_PORT_D);   // 現在のモーター角度を更新
-            cur_power = ev3_motor_get_power(EV3_PORT_D);    // 現在のモーター出力を更新
+            cur_power = Motor_getPower(EV3_PORT_D);         // 現在のモーター出力を更新
         }
     }
     while(loop);
@@ -283,20 +300,22 @@ void Ctrl_runStop_Line(bool_t loop)
 {
     do
     {
-        if(Run_getRGB_R() < 60 && Run_getRGB_G() < 90 && Run_getRGB_B() < 90)  // 黒ラインを検知した場合
+        if(Run_getColor(COLOR_SET_LINE) == COLOR_BLACK)   // 黒ラインを検知した場合
         {
             Ctrl_motor_steer(0, 0);     // 左右モーター停止
             return;                     // 関数を終了
         }
 
         if(loop)                    // ループ処理の場合
-            tslp_tsk(4 * 1000U);    /* 4msec周期起動 */
+            Clock_wait();           /* 制御周期ごとに起動 */
     }
     while(loop);
 }
 
 /* 指定した距離に到達するまで、指定出力で移動または旋回する関数 *********************************/
-// 加減速ありの場合は関数Ctrl_motor_steer_altを使用する
+// 加減速はCtrl_motor_steer_altと同じ。目標に到達してから減速するため、減速の分だけ目標を越えて止まる(各区間はこれを前提に調整済み)
+// 目標の距離で止める場合はMotion_pushDistancePlanned(速度プロファイル *Profile.c)を使用する
+// 処理は走行命令のキュー(Motion.c)で行い、この関数は完了するまで待機する。待機せずに続けて命令を積む場合はMotion_push*を使用する
 //
 // 引数
 //  power        : Ctrl_motor_steer関数のpower値(-100 ~ +100)
@@ -305,51 +324,19 @@ void Ctrl_runStop_Line(bool_t loop)
 /******************************************************************************************/
 void Ctrl_runDistance(int8_t power, int16_t turn, float distance)
 {
-    float ref_distance = Run_getDistance();             // 処理開始時点での距離を取得
+    uint32_t id = Motion_pushDistance(power, turn, distance);   // 命令をキューに積み、周期ハンドラ(Motion_update)に実行させる
 
-    if(power > 0 && distance > 0)                       // 前進の場合
+    if(id == 0)                                         // 正しい引数が得られなかった場合
     {
-        while(1)                                            // モーターが停止するまでループ
-        {
-            if(Run_getDistance() >= (ref_distance + distance))  // 指定距離に到達した場合
-            {
-                Ctrl_motor_steer_alt(0, turn, 0.1);                 // モーターが停止するまで減速
-                if(Run_getPower() == 0)                             // モーターが完全に停止した場合
-                    return;                                             // 関数を終了
-            }
-            else                                                // 指定距離に到達していない場合
-            {
-                Ctrl_motor_steer_alt(power, turn, 0.1);             // 指定出力になるまで加速して走行
-            }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
-    }
-    else if(power < 0 && distance < 0)                  // 後退の場合
-    {
-        while(1)                                            // モーターが停止するまでループ
-        {
-            if(Run_getDistance() <= (ref_distance + distance))  // 指定距離に到達した場合
-            {
-                Ctrl_motor_steer_alt(0, turn, 0.1);                 // モーターが停止するまで減速
-                if(Run_getPower() == 0)                             // モーターが完全に停止した場合
-                    return;                                             // 関数を終了
-            }
-            else                                                // 指定距離に到達していない場合
-            {
-                Ctrl_motor_steer_alt(power, turn, 0.1);             // 指定出力になるまで加速して走行
-            }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
-    }
-    else                                                // 正しい引数が得られなかった場合
-    {
-        printf("argument out of range @ Ctrl_runDistance()\n"); // エラーメッセージを出して
-        return;                                                 // 終了
+        printf("argument out of range @ Ctrl_runDistance()\n");   // エラーメッセージを出して
+        return;                                             // 終了
     }
+    Motion_wait(id);                                    // 命令が完了するまで待機
 }
 
 /* 指定した方位に到達するまで、指定出力で旋回または移動する関数 *********************************/
-// 加減速ありの場合は関数Ctrl_motor_steer_altを使用する
+// 加減速はCtrl_motor_steer_altと同じ。目標に到達してから減速するため、減速の分だけ目標を越えて止まる(各区間はこれを前提に調整済み)
+// 目標の方位で止める場合はMotion_pushDirectionPlanned(速度プロファイル *Profile.c)を使用する
 //
 // 引数
 //  power        : Ctrl_motor_steer関数のpower値(-100 ~ +100)
@@ -358,53 +345,18 @@ void Ctrl_runDistance(int8_t power, int16_t turn, float distance)
 /******************************************************************************************/
 void Ctrl_runDirection(int8_t power, int16_t turn, float direction)
 {
-    float ref_direction = Run_getDirection();               // 処理開始時点での方位を取得
-    
-    direction = direction * EDGE;                           // R/Lコースの変換処理
-    
-    if(power != 0 && turn > 0 && direction > 0)             // 右旋回の場合
-    {
-        while(1)                                                // モーターが停止するまでループ
-        {
-            if(Run_getDirection() >= (ref_direction + direction))   // 指定方位に到達した場合
-            {
-                Ctrl_motor_steer_alt(0, turn, 0.1);                     // モーターが停止するまで減速
-                if(Run_getPower() == 0)                                 // モーターが完全に停止した場合
-                    return;                                                 // 関数を終了
-            }
-            else                                                    // 指定方位に到達していない場合
-            {
-                Ctrl_motor_steer_alt(power, turn, 0.1);                 // 指定出力になるまで加速して旋回
-            }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
-    }
-    else if(power != 0 && turn < 0 && direction < 0)        // 左旋回の場合
-    {
-        while(1)                                                // モーターが停止するまでループ
-        {
-            if(Run_getDirection() <= (ref_direction + direction))   // 指定方位に到達した場合
-            {
-                Ctrl_motor_steer_alt(0, turn, 0.1);                     // モーターが停止するまで減速
-                if(Run_getPower() == 0)                                 // モーターが完全に停止した場合
-                    return;                                                 // 関数を終了
-            }
-            else                                                    // 指定方位に到達していない場合
-            {
-                Ctrl_motor_steer_alt(power, turn, 0.1);                 // 指定出力になるまで加速して旋回
-            }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
-    }
-    else                                                    // 正しい引数が得られなかった場合
+    uint32_t id = Motion_pushDirection(power, turn, direction);   // 命令をキューに積み、周期ハンドラ(Motion_update)に実行させる
+
+    if(id == 0)                                         // 正しい引数が得られなかった場合
     {
-        printf("argument out of range @ Ctrl_runDirection()\n");    // エラーメッセージを出して
-        return;                                                     // 異常終了
+        printf("argument out of range @ Ctrl_runDirection()\n");   // エラーメッセージを出して
+        return;                                             // 終了
     }
+    Motion_wait(id);                                    // 命令が完了するまで待機
 }
 
 /* 指定した距離に障害物を検知するまで、指定出力で前進または旋回する関数 ***********************/
-// 加減速ありの場合は関数Ctrl_motor_steer_altを使用する
+// 加減速はCtrl_motor_steer_altと同じ(検知してから減速する)
 //
 // 引数
 //  power        : Ctrl_motor_steer関数のpower値(-100 ~ +100)
@@ -414,88 +366,30 @@ void Ctrl_runDirection(int8_t power, int16_t turn, float direction)
 /****************************************************************************************/
 void Ctrl_runDetection(int8_t power, int16_t turn, int16_t detection, float distance)
 {
-    float ref_distance = Run_getDistance();                         // 処理開始時点での距離を取得
-    
-    if(power > 0 && distance == 0)                                      // 距離の指定がない場合
-    {
-        while(1)                                                            // モーターが停止するまでループ
-        {
-            if(ev3_ultrasonic_sensor_get_distance(EV3_PORT_3) <= detection)     // 障害物を検知した場合
-            {
-                Ctrl_motor_steer_alt(0, turn, 0.1);                                 // モーターが停止するまで減速
-                if(Run_getPower() == 0)                                             // モーターが完全に停止した場合
-                    return;                                                             // 関数を終了
-            }
-            else                                                                // 障害物を検知していない場合
-            {
-                Ctrl_motor_steer_alt(power, turn, 0.1);                                   // 指定出力になるまで加速して走行
-            }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
-    }
-    else if(power > 0 && distance > 0)                              // 距離の指定がある場合
-    {        
-        while(1)                                                        // モーターが停止するまでループ
-        {
-            if(ev3_ultrasonic_sensor_get_distance(EV3_PORT_3) <= detection || Run_getDistance() >= (ref_distance + distance))
-            {                                                               // 障害物を検知した場合、または指定距離に到達した場合
-                Ctrl_motor_steer_alt(0, turn, 0.1);                             // モーターが停止するまで減速
-                if(Run_getPower() == 0)                                         // モーターが完全に停止した場合
-                    return;                                                         // 関数を終了
-            }
-            else                                                            // 障害物を未検知、かつ指定距離に到達していない場合
-            {
-                Ctrl_motor_steer_alt(power, turn, 0.1);                         // 指定出力になるまで加速して走行
-            }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
-    }
-    else                                                            // 正しい引数が得られなかった場合
+    uint32_t id = Motion_pushDetection(power, turn, detection, distance);   // 命令をキューに積み、周期ハンドラ(Motion_update)に実行させる
+
+    if(id == 0)                                         // 正しい引数が得られなかった場合
     {
-        printf("argument out of range @ Ctrl_runDetection()\n");        // エラーメッセージを出して
-        return;                                                         // 異常終了
+        printf("argument out of range @ Ctrl_runDetection()\n");   // エラーメッセージを出して
+        return;                                             // 終了
     }
+    Motion_wait(id);                                    // 命令が完了するまで待機
 }
 
 
-/* PID初期化関数 *********************************************************/
-// PID用のグローバル変数の初期化
-/************************************************************************/
-void Ctrl_initPID()
+// 前回の呼び出しからの経過時間を、変化量の基準とする時間の何倍かで返す(制御周期を変えても加減速の速さが変わらないようにする)
+// 同じ周期に2回呼ばれた場合や、長く空いてから呼ばれた場合(区間の開始時など)は1周期分とする
+static float Ctrl_getElapsed(uint32_t *pre_tick)
 {
-    diff[0] = 0;
-    integral = 0.0;
-}
+    uint32_t now = Clock_getTicks();
+    uint32_t ticks = now - *pre_tick;
 
-/* PID制御関数(定数) * (センサー入力値 - 目標値) **********************************************************/
-// 参考：https://monoist.atmarkit.co.jp/mn/articles/1007/26/news083.html
-//
-// 使用グローバル変数
-// int32_t  diff[2]    : 偏差を記録
-// float    integral   : 積分を記録
-//
-// 引数
-// sensor_val   : センサーの現在値
-// taget_val    : センサーの目標値
-//
-// 戻り値       : Ctrl_motor_steer関数のturn値(-200 ~ +200)
-/*******************************************************************************************************/
-int16_t Ctrl_getTurn_PID(uint16_t sensor_val, uint16_t target_val)    // センサー値, センサーの目標値
-{
-    float p, i, d;
-
-    diff[0] = diff[1];
-    diff[1] = sensor_val - target_val;  // 偏差を取得
-    integral += (diff[1] + diff[0]) / 2.0 * DELTA_T;
-
-    p = KP * diff[1];
-    i = KI * integral;
-    d = KD * (diff[1] - diff[0]) / DELTA_T;
-
-    return roundf(Ctrl_math_limit(p + i + d, -200.0, 200.0));    // 最大・最小値を制限し、四捨五入した値を返す
+    *pre_tick = now;
+    if(ticks == 0 || ticks > CLOCK_TICKS(100))
+        ticks = 1;
+    return ticks * (float)CLOCK_PERIOD_MS / CHANGE_PERIOD_MS;
 }
 
-
 /* 目標の出力値に到達するまで、指定量の出力値の増減を行い、その結果を返す関数 *********************************************************************/
 // 徐々に加速、減速を行えるようにするための関数。線形で示すと、通常の加減速は _|￣|_ であり、この関数で実現したい加減速は _／￣＼_　のような形。
 //
@@ -504,15 +398,20 @@ int16_t Ctrl_getTurn_PID(uint16_t sensor_val, uint16_t target_val)    // セン
 //
 // 引数
 //  target_power  : 目標の出力値
-//  change_rate   : 増減の変化量 *例として0.2とした場合、4ms(1周期)で出力値が0.2ずつ変化し、20ms経過すると出力値が 1 変化することになる
+//  change_rate   : 増減の変化量 *例として0.2とした場合、5msで出力値が0.2ずつ変化し、25ms経過すると出力値が 1 変化することになる
+//                  (変化量は前回の呼び出しからの経過時間に比例させるため、制御周期によらず同じ速さで変化する)
 //
 // 戻り値        : 指定量の加減速を行ったモーターの出力値(小数点以下の値はモーター制御の関数が対応していないため切り捨て)
 /*******************************************************************************************************************************************/
 int8_t Ctrl_getPower_Change(int8_t target_power, float change_rate)
 {
     static float power = 0.0;               // 出力値を保持する変数
+    static uint32_t pre_tick = 0;           // 前回の呼び出し時の周期ハンドラの起動回数
     int8_t current_power = input_power;     // 現在の入力値
 
+    CTRL_ASSERT_OWNER();
+    change_rate = change_rate * Ctrl_getElapsed(&pre_tick); // 経過時間分の変化量
+
     if(current_power < target_power)        // 現在値 < 目標値 の時
     {
         if(floorf(power) != current_power)      // 現在値が指定した変化量を超えて増減した場合の対策
@@ -537,8 +436,12 @@ int8_t Ctrl_getPower_Change(int8_t target_power, float change_rate)
 int8_t Ctrl_getTurn_Change(int8_t target_turn, float change_rate)
 {
     static float turn = 0.0;            // 出力値を保持する変数
+    static uint32_t pre_tick = 0;       // 前回の呼び出し時の周期ハンドラの起動回数
     int8_t current_turn = input_turn;   // 現在の入力値
 
+    CTRL_ASSERT_OWNER();
+    change_rate = change_rate * Ctrl_getElapsed(&pre_tick); // 経過時間分の変化量
+
     if(current_turn < target_turn)      // 現在値 < 目標値 の時
     {
         if(floorf(turn) != current_turn)    // 現在値が指定した変化量を超えて増減した場合の対策
@@ -559,65 +462,36 @@ int8_t Ctrl_getTurn_Change(int8_t target_turn, float change_rate)
         return current_turn;                // 現在値をそのまま返す
 }
 
-/* サンプリングを用いたパターン判別関数*******************************************************************************************************/
-// 説明: パターン判別のためにサンプリングを１００回行う。
-//       過半数以上の障害物検知をした場合のみパターンAと判別する。
+/* 超音波センサーの値を用いたパターン判別関数***********************************************************************************************/
+// 説明: 周期ハンドラで平滑化した超音波センサーの値(Run_getSonar)を用いてパターンを判別する。待機はしない。
+//       直近の測定値の8割以上が揃って障害物を検知している場合のみパターンAと判別する。
 /******************************************************************************************************************************************/
 int8_t sampling_sonic(void)
 {
-    int loop;
-    int sampling_cnt = 0;
-    int8_t pattern;
-
-    for(loop=0;loop<100;loop++)                                                 // サンプリングを１００回行う
-    {
-        if(ev3_ultrasonic_sensor_get_distance(EV3_PORT_3) <= 25)
-            sampling_cnt++;
-        tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-    }
-
-    if(sampling_cnt >= 80)                                                      // サンプリングを基にパターン判別を行う
-        pattern = 1;
+    if(Run_getSonar() <= 25 && Run_getSonarConfidence() >= 80)     // 判別を行う
+        return 1;
     else
-        pattern = 0;
-
-    return pattern;
+        return 0;
 }
 
 /* サンプリングを用いた直進検知関数***********************************************/
+// 直近100回分の旋回量の絶対値の平均が7未満であれば直進しているとみなす
+/*******************************************************************************/
 int8_t sampling_turn(int16_t turn)
 {
-    static uint8_t flag = 0;
-    static uint8_t cnt = 0;
-    static int16_t sampling_data[100] = {0};
+    static stat_window_t window;        // 旋回量の絶対値の直近100回分
+    static uint8_t flag = 0;            // 初期化済みフラグ
 
-    uint8_t i = 0;
-    int16_t avg = 0;
-
-    if(cnt < 100)
+    if(flag == 0)
     {
-        if(turn < 0)
-            sampling_data[cnt] = turn * (-1);
-        else
-            sampling_data[cnt] = turn;
-
-        cnt++;
-
-        if(cnt == 99)
-        {
-            cnt = 0;
-            flag = 1;
-        }
+        Stat_init(&window, 100);
+        flag = 1;
     }
 
-    for(i = 0; i < 100; i++)
-    {
-        avg += sampling_data[i];
-    }
-    avg = avg / 100;
+    Stat_push(&window, (turn < 0) ? -turn : turn);
 
-    if(flag == 1 && avg < 7)
+    if(Stat_isFull(&window) && Stat_getMean(&window) < 7)
         return 1;
     else
         return 0;
-}
\ No newline at end of file
+}
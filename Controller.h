@@ -3,6 +3,9 @@
 
 #include <math.h>
 #include "Run.h"
+#include "Pid.h"
+#include "Stat.h"
+#include "Motor.h"
 
 /* 関数プロトタイプ宣言 */
 
@@ -20,6 +23,12 @@ void    Ctrl_motor_steer(int8_t power, int16_t turn);
 // モーターの制御を加減速を伴って行う関数
 void    Ctrl_motor_steer_alt(int8_t power, int16_t turn, float change_rate);
 
+// 走行命令のキュー(Motion.c)が周期ハンドラから使うモーター制御関数
+// *キューに命令がある間は、これらの関数だけがモーターと加減速の状態(input_power, Ctrl_getPower_Change)を操作する
+//  メインタスクからCtrl_motor_steer等を呼ぶのはキューが空になってから(Motion_wait, Motion_isDoneで待つ)。守られない場合はassertで止まる
+void    Ctrl_motion_steer(int8_t power, int16_t turn);
+void    Ctrl_motion_steer_alt(int8_t power, int16_t turn, float change_rate);
+
 
 // アームの上下を制御する関数
 void    Ctrl_arm_up(uint8_t power, bool_t loop);
@@ -43,11 +52,7 @@ void    Ctrl_runDirection(int8_t power, int16_t turn, float direction);
 void    Ctrl_runDetection(int8_t power, int16_t turn, int16_t detection, float distance);
 
 
-// PID初期化関数
-void    Ctrl_initPID();
-
-// PID制御関数(定数) * (センサ入力値 - 目標値)
-int16_t Ctrl_getTurn_PID(uint16_t sensor_val, uint16_t target_val);
+// *PID制御は各区間がpid_ctrl_tを持って行う(Pid.hを参照)
 
 
 // 目標の出力値に到達するまで、指定量の出力値の増減を行い、その結果を返す関数
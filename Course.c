@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include "Course.h"
+#include "Controller.h"
+#include "Line.h"
+
+/* マクロ定義 */
+// 区間表の記述用
+#define NONE                    { COURSE_VAR_NONE, 0, 0, 0 }
+#define COND(var, op, value)    { COURSE_VAR_##var, COURSE_OP_##op, 0, value }
+
+/* グローバル宣言 */
+// 組み込みの区間表(ライントレース区間のショートカット走行 *tools/Course_Linetrace.txtと同じ内容)
+static const course_seg_t default_seg[] = {
+    //  ステアリング         出力  旋回  開始条件  終了条件1                      終了条件2
+    {   COURSE_STEER_ACCEL,  100,    0,  NONE,  { COND(DISTANCE, GT, 1850),     NONE                        } },   // 直進
+    {   COURSE_STEER_FIXED,  100,  -50,  NONE,  { COND(DIRECTION, LE, -80),     NONE                        } },   // カーブ1
+    {   COURSE_STEER_ACCEL,  100,    0,  NONE,  { COND(DISTANCE, GT, 2900),     NONE                        } },
+    {   COURSE_STEER_FIXED,  100,  -65,  NONE,  { COND(DIRECTION, LE, -220),    NONE                        } },   // カーブ2
+    {   COURSE_STEER_ACCEL,  100,    0,  NONE,  { COND(DISTANCE, GT, 3750),     NONE                        } },
+    {   COURSE_STEER_FIXED,  100,   65,  NONE,  { COND(DISTANCE, GE, 4300),     COND(DIRECTION, GE, -170)   } },   // Z字カーブ
+    {   COURSE_STEER_FIXED,  100,    0,  NONE,  { COND(DISTANCE, GE, 4400),     NONE                        } },
+    {   COURSE_STEER_FIXED,  100,   70,  NONE,  { COND(DISTANCE, GE, 4800),     COND(DIRECTION, GE, -40)    } },
+    {   COURSE_STEER_FIXED,  100,    0,  NONE,  { COND(DISTANCE, GE, 4900),     NONE                        } },
+    {   COURSE_STEER_FIXED,  100,  -70,  NONE,  { COND(DIRECTION, LE, -155),    NONE                        } },
+    {   COURSE_STEER_ACCEL,  100,    0,  NONE,  { COND(DISTANCE, GT, 5750),     NONE                        } },
+    {   COURSE_STEER_FIXED,  100,  -70,  NONE,  { COND(DISTANCE, GE, 6100),     COND(DIRECTION, LE, -230)   } },   // カーブ4
+    {   COURSE_STEER_FIXED,  100,    0,  NONE,  { COND(DISTANCE, GE, 6200),     NONE                        } },
+    {   COURSE_STEER_FIXED,  100,   55,  NONE,  { COND(DIRECTION, GE, -90),     NONE                        } },
+    {   COURSE_STEER_FIXED,  100,   18,  NONE,  { COND(COLOR, EQ, COLOR_BLACK), NONE                        } },   // 黒ラインに復帰
+};
+
+// 実行する区間表(ファイルの内容は4byte境界に置くためuint32_tの配列に読み込む)
+static uint32_t file_buf[(sizeof(course_header_t) + sizeof(course_seg_t) * COURSE_SEG_MAX) / sizeof(uint32_t)];
+static const course_seg_t *table = default_seg;
+static uint16_t table_num = sizeof(default_seg) / sizeof(default_seg[0]);
+
+/* 関数 */
+
+// 初期化
+bool_t Course_init(void)
+{
+    const course_header_t *header = (const course_header_t *)file_buf;
+    FILE *fp;
+    size_t n;
+
+    table = default_seg;
+    table_num = sizeof(default_seg) / sizeof(default_seg[0]);
+
+    fp = fopen(COURSE_FILE, "rb");
+    if(fp == NULL)
+        return false;
+    n = fread(file_buf, 1, sizeof(file_buf), fp);  // ファイル全体を1回で読み込む
+    fclose(fp);
+
+    if(n < sizeof(course_header_t) || header->magic != COURSE_MAGIC || header->version != COURSE_VERSION
+       || header->seg_size != sizeof(course_seg_t) || header->num == 0 || header->num > COURSE_SEG_MAX
+       || n != sizeof(course_header_t) + sizeof(course_seg_t) * header->num)
+    {
+        printf("Course_init: invalid %s, using built-in course\n", COURSE_FILE);
+        return false;
+    }
+
+    table = (const course_seg_t *)(header + 1);
+    table_num = header->num;
+    return true;
+}
+
+// 実行を開始
+void Course_start(course_t *course, pid_ctrl_t *pid)
+{
+    course->pos = 0;
+    course->entered = false;
+    course->seg_start = 0.0;
+    course->pid = pid;
+}
+
+// 条件が成立しているかどうか
+static bool_t Course_test(const course_t *course, const course_cond_t *cond, const run_data_t *run)
+{
+    float v;
+
+    switch(cond->var)
+    {
+        case COURSE_VAR_DISTANCE:       v = run->distance;                      break;
+        case COURSE_VAR_DIRECTION:      v = run->direction;                     break;
+        case COURSE_VAR_SEG_DISTANCE:   v = run->distance - course->seg_start;  break;
+        case COURSE_VAR_COLOR:          v = run->color[COLOR_SET_LINE];                         break;
+        default:                        return false;
+    }
+
+    switch(cond->op)
+    {
+        case COURSE_OP_GT:  return v >  cond->value;
+        case COURSE_OP_GE:  return v >= cond->value;
+        case COURSE_OP_LT:  return v <  cond->value;
+        case COURSE_OP_LE:  return v <= cond->value;
+        case COURSE_OP_EQ:  return v == cond->value;
+        default:            return false;
+    }
+}
+
+// 1周期分実行
+bool_t Course_step(course_t *course, const run_data_t *run, float dt)
+{
+    const course_seg_t *seg;
+    int8_t power;
+
+    while(course->pos < table_num)      // 終了条件が成立した区間は同じ周期のうちに次の区間へ進む
+    {
+        seg = &table[course->pos];
+
+        if(!course->entered)                // 区間の開始
+        {
+            if(seg->entry.var != COURSE_VAR_NONE && !Course_test(course, &seg->entry, run))
+            {
+                course->pos++;                  // 開始条件が成立しない区間は飛ばす
+                continue;
+            }
+            course->entered = true;
+            course->seg_start = run->distance;
+            if(seg->steer == COURSE_STEER_ACCEL)    // 現在の出力から加速を始める
+            {
+                Profile_init(&course->profile, PROFILE_UNLIMITED, Profile_fromPower(seg->power), Profile_fromPower(seg->power), PROFILE_ACCEL, PROFILE_JERK);
+                Profile_start(&course->profile, Profile_fromPower(run->power));
+            }
+        }
+
+        if(Course_test(course, &seg->exit[0], run) || Course_test(course, &seg->exit[1], run))
+        {
+            course->pos++;                  // 終了条件が成立した場合は次の区間へ
+            course->entered = false;
+            continue;
+        }
+
+        switch(seg->steer)
+        {
+            case COURSE_STEER_ACCEL:
+                power = Profile_toPower(Profile_update(&course->profile, run->distance - course->seg_start, dt));
+                Ctrl_motor_steer(power, seg->turn);
+                break;
+
+            case COURSE_STEER_PID:
+                Ctrl_motor_steer(seg->power, (course->pid != NULL) ? Pid_update(course->pid, run->offset, Line_offsetFromR(seg->turn)) : 0);
+                break;
+
+            default:
+                Ctrl_motor_steer(seg->power, seg->turn);
+                break;
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef INCLUDED_Course_h_
+#define INCLUDED_Course_h_
+
+// コースの区間表(区間の開始条件・ステアリングの種類・出力・終了条件を並べたもの)と、それを実行するエンジン
+// 区間表は起動時にSDカードのCourse_Linetrace.binを1回のfreadで読み込む(無い場合・壊れている場合は組み込みの表を使う)
+// 走行中は構造体の表を順に参照するだけで、文字列の解析などは行わない
+// 区間表のファイルはtools/course_buildでテキスト形式(tools/Course_Linetrace.txt)から作成する
+// *ホスト側のツール(tools/course_build.c)からもインクルードするため、COURSE_HOSTを定義した場合はev3api.hに依存させないこと
+
+#include <stdint.h>
+
+/* マクロ定義 */
+#define COURSE_MAGIC        0x45535243u // ファイル先頭の識別子("CRSE")
+#define COURSE_VERSION      1           // 区間表の形式のバージョン
+#define COURSE_SEG_MAX      32          // 区間の最大数
+#define COURSE_FILE         "Course_Linetrace.bin"
+
+/* 条件の対象 */
+enum {
+    COURSE_VAR_NONE = 0,    // 条件なし(開始条件は常に成立、終了条件は常に不成立)
+    COURSE_VAR_DISTANCE,    // 区間(section_*)の開始からの走行距離[mm]
+    COURSE_VAR_DIRECTION,   // 区間(section_*)の開始からの方位[deg]
+    COURSE_VAR_SEG_DISTANCE,// この区間の開始からの走行距離[mm]
+    COURSE_VAR_COLOR        // 判定した色(colorid_tの値 *COLOR_SET_LINEの判定条件)
+};
+
+/* 条件の比較方法(値 op 条件値) */
+enum {
+    COURSE_OP_GT = 0,       // >
+    COURSE_OP_GE,           // >=
+    COURSE_OP_LT,           // <
+    COURSE_OP_LE,           // <=
+    COURSE_OP_EQ            // ==
+};
+
+/* ステアリングの種類 */
+enum {
+    COURSE_STEER_FIXED = 0, // 指定の出力・旋回値で走行
+    COURSE_STEER_ACCEL,     // 指定の出力まで速度プロファイルに従って加速し、旋回値は指定値
+    COURSE_STEER_PID        // ライントレース(旋回値の欄はPID制御の目標値 = R値 *Line_offsetFromRでずれに換算する)
+};
+
+/* 条件(8byte) */
+typedef struct {
+    uint8_t     var;        // COURSE_VAR_*
+    uint8_t     op;         // COURSE_OP_*
+    uint16_t    reserved;
+    float       value;
+} course_cond_t;
+
+/* 区間(32byte) */
+typedef struct {
+    uint8_t     steer;      // COURSE_STEER_*
+    int8_t      power;      // Ctrl_motor_steer関数のpower値(-100 ~ +100)
+    int16_t     turn;       // Ctrl_motor_steer関数のturn値(-200 ~ +200)、またはPID制御の目標値(R値)
+    course_cond_t entry;    // 開始条件(成立しない場合はこの区間を飛ばす)
+    course_cond_t exit[2];  // 終了条件(どちらかが成立したら次の区間へ)
+    uint32_t    reserved;
+} course_seg_t;
+
+/* ファイルヘッダ(8byte) *この後に区間がnum個続く */
+typedef struct {
+    uint32_t    magic;      // COURSE_MAGIC
+    uint8_t     version;    // COURSE_VERSION
+    uint8_t     seg_size;   // sizeof(course_seg_t)
+    uint16_t    num;        // 区間の数
+} course_header_t;
+
+/* 関数プロトタイプ宣言 */
+#ifndef COURSE_HOST
+
+#include "Run.h"
+#include "Pid.h"
+#include "Profile.h"
+
+/* 実行状態 */
+typedef struct {
+    uint16_t    pos;            // 実行中の区間
+    bool_t      entered;        // 実行中の区間を開始済みかどうか
+    float       seg_start;      // 区間の開始時点の走行距離
+    pid_ctrl_t  *pid;           // COURSE_STEER_PIDで使用するPID制御器
+    profile_t   profile;        // COURSE_STEER_ACCELで使用する速度プロファイル
+} course_t;
+
+// 初期化(区間表をSDカードから読み込む。読み込めなかった場合は組み込みの表を使い、偽を返す)
+bool_t  Course_init(void);
+
+// 実行を開始(pidはCOURSE_STEER_PIDの区間で使用する。使わない場合はNULL)
+void    Course_start(course_t *course, pid_ctrl_t *pid);
+
+// 1周期分実行(runはこの周期の走行データ、dtは前回からの経過時間[s])。全区間が終了した場合は真を返す
+bool_t  Course_step(course_t *course, const run_data_t *run, float dt);
+
+#endif
+
+#endif
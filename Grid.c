@@ -0,0 +1,205 @@
+// 参考：https://qiita.com/TetsuroAkagawa
+// 引用：https://qiita.com/TetsuroAkagawa/items/075d74f5ab49f592450b
+
+#include <stdlib.h>
+#include "Grid.h"
+
+/* マクロ定義 */
+#define EDGE        1       // 1でLコース、-1でRコース(Controller.cと合わせること)
+#define COST_STRAIGHT   10  // 上下左右のマスへの移動コスト
+#define COST_DIAGONAL   14  // 斜めのマスへの移動コスト(10 * √2)
+#define COST_INF        0xFFFF
+#define CELL_NUM    (GRID_W * GRID_H)
+
+/* グローバル宣言 */
+// ブロック搬入区間の地図(赤ラインを検知した位置を(1, 1)、そのときの向きをx軸とする)
+// '#'は走行できないマス(ブロック置き場・壁など。車体の幅の半分の余裕を含めて塗ること) *コースに合わせて調整すること
+static const char *const grid_map[GRID_H] = {
+    // x: 0123456789ABCD
+    "..............",   // y = 0
+    "..............",   // y = 1
+    "..............",   // y = 2
+    "........##....",   // y = 3
+    "........##....",   // y = 4
+    "..###.........",   // y = 5
+    "..###.........",   // y = 6
+    "..###.........",   // y = 7
+    "..............",   // y = 8
+    "..............",   // y = 9
+};
+
+// 各経路の始点と終点
+static const struct {
+    grid_cell_t start;
+    grid_cell_t goal;
+} route_def[GRID_ROUTE_NUM] = {
+    [GRID_ROUTE_RETURN] = { { 1, 1 }, { 11, 8 } },  // 赤ライン -> 黒ラインの手前
+};
+
+// 8方向の移動量
+static const int8_t dir_x[8] = { 1, 1, 0, -1, -1, -1,  0,  1 };
+static const int8_t dir_y[8] = { 0, 1, 1,  1,  0, -1, -1, -1 };
+
+static grid_route_t route[GRID_ROUTE_NUM];
+
+/* 関数 */
+
+// 走行できるマスかどうか
+static bool_t Grid_isFree(int x, int y)
+{
+    return x >= 0 && x < GRID_W && y >= 0 && y < GRID_H && grid_map[y][x] != '#';
+}
+
+// 残りコストの見積もり(斜め移動を含む最短距離)
+static uint16_t Grid_heuristic(int x, int y, grid_cell_t goal)
+{
+    int dx = abs(goal.x - x);
+    int dy = abs(goal.y - y);
+
+    if(dx < dy)
+        return COST_DIAGONAL * dx + COST_STRAIGHT * (dy - dx);
+    return COST_DIAGONAL * dy + COST_STRAIGHT * (dx - dy);
+}
+
+// A*でstartからgoalまでの最短経路を探索し、向きが変わるマスを通過点としてrに格納する
+static bool_t Grid_search(grid_cell_t start, grid_cell_t goal, grid_route_t *r)
+{
+    static uint16_t cost[CELL_NUM];     // 始点からのコスト
+    static uint8_t  from[CELL_NUM];     // 直前のマスからの移動方向
+    static uint8_t  state[CELL_NUM];    // 0:未探索, 1:探索候補, 2:探索済み
+    grid_cell_t path[CELL_NUM];
+    int cur, next, best, nx, ny, cx, cy, i, d, n;
+    uint32_t f, best_f;
+    uint16_t c;
+
+    r->num = 0;
+    if(!Grid_isFree(start.x, start.y) || !Grid_isFree(goal.x, goal.y))
+        return false;
+
+    for(i = 0; i < CELL_NUM; i++)
+    {
+        cost[i] = COST_INF;
+        state[i] = 0;
+    }
+    cur = start.y * GRID_W + start.x;
+    cost[cur] = 0;
+    state[cur] = 1;
+
+    while(1)
+    {
+        // 探索候補のうち、見積もりの総コストが最小のマスを選ぶ(マス数が少ないため線形探索)
+        best = -1;
+        best_f = UINT32_MAX;
+        for(i = 0; i < CELL_NUM; i++)
+        {
+            if(state[i] != 1)
+                continue;
+            f = cost[i] + Grid_heuristic(i % GRID_W, i / GRID_W, goal);
+            if(f < best_f)
+            {
+                best_f = f;
+                best = i;
+            }
+        }
+        if(best < 0)                    // 探索候補がなくなった場合は経路なし
+            return false;
+
+        cur = best;
+        state[cur] = 2;
+        cx = cur % GRID_W;
+        cy = cur / GRID_W;
+        if(cx == goal.x && cy == goal.y)
+            break;
+
+        for(d = 0; d < 8; d++)
+        {
+            nx = cx + dir_x[d];
+            ny = cy + dir_y[d];
+            if(!Grid_isFree(nx, ny))
+                continue;
+            if((d & 1) && (!Grid_isFree(cx + dir_x[d], cy) || !Grid_isFree(cx, cy + dir_y[d])))
+                continue;               // 斜め移動で走行できないマスの角をかすめる場合は除く
+
+            next = ny * GRID_W + nx;
+            c = cost[cur] + ((d & 1) ? COST_DIAGONAL : COST_STRAIGHT);
+            if(state[next] == 2 || c >= cost[next])
+                continue;
+            cost[next] = c;
+            from[next] = d;
+            state[next] = 1;
+        }
+    }
+
+    // 終点から始点へたどって経路を作る
+    n = 0;
+    cx = goal.x;
+    cy = goal.y;
+    while(cx != start.x || cy != start.y)
+    {
+        path[n].x = cx;
+        path[n].y = cy;
+        n++;
+        d = from[cy * GRID_W + cx];
+        cx -= dir_x[d];
+        cy -= dir_y[d];
+    }
+
+    // 始点側から、移動方向が変わるマスと終点だけを通過点として残す
+    for(i = n - 1; i >= 0; i--)
+    {
+        if(i > 0 && from[path[i].y * GRID_W + path[i].x] == from[path[i - 1].y * GRID_W + path[i - 1].x])
+            continue;                   // 次のマスへも同じ方向に進む場合は通過点にしない
+        if(r->num >= GRID_WAYPOINT_MAX)
+        {
+            r->num = 0;
+            return false;
+        }
+        r->point[r->num++] = path[i];
+    }
+    return true;
+}
+
+// 初期化
+bool_t Grid_init(void)
+{
+    bool_t ok = true;
+    int i;
+
+    for(i = 0; i < GRID_ROUTE_NUM; i++)
+    {
+        if(!Grid_search(route_def[i].start, route_def[i].goal, &route[i]))
+        {
+            printf("Grid_init: route %d not found\n", i);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// 経路を取得
+const grid_route_t *Grid_getRoute(grid_route_id_t id)
+{
+    return &route[id];
+}
+
+// 現在位置をマスの座標と向きで設定
+void Grid_setPose(int x, int y, float heading)
+{
+    Run_setPose(x * GRID_SIZE, y * GRID_SIZE * EDGE, heading * EDGE);   // R/Lコースの変換処理
+}
+
+// 経路の通過点をキューに積む
+uint32_t Grid_pushRoute(grid_route_id_t id, int8_t power, int16_t turn_max)
+{
+    uint32_t last = 0;
+    int i;
+
+    if(id >= GRID_ROUTE_NUM || route[id].num == 0 || !(power > 0 && turn_max > 0))
+        return 0;
+    if(Motion_getFree() < route[id].num)    // 経路の途中までだけ積まないよう、全部入らない場合は何も積まない
+        return 0;
+
+    for(i = 0; i < route[id].num; i++)
+        last = Motion_pushGoto(power, turn_max, route[id].point[i].x * GRID_SIZE, route[id].point[i].y * GRID_SIZE);
+    return last;
+}
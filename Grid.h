@@ -0,0 +1,51 @@
+#ifndef INCLUDED_Grid_h_
+#define INCLUDED_Grid_h_
+
+#include "Motion.h"
+
+// ブロック搬入区間の格子地図と経路計画
+// 区間を100mm間隔の格子(マス)で表し、起動時にA*で各経路の最短経路を求めて、向きが変わるマスだけを通過点として保存する
+// 走行中は保存した通過点をMOTION_GOTOとしてキューに積むだけで、経路の探索は行わない
+// *地図(Grid.c)は実測前の見積もり。section_Blockで経路を使うのはapp_Block.cのUSE_GRID_ROUTEを1にした場合のみ
+// *座標はLコースの値(x軸が区間の基準の向き、y軸が右方向)。Rコースの変換はMotion.c、Grid_setPoseで行う
+// 参考：https://qiita.com/TetsuroAkagawa/items/075d74f5ab49f592450b
+
+/* マクロ定義 */
+#define GRID_SIZE       100.0   // 座標のマス幅(100mm)
+#define GRID_W          14      // 地図の横(x方向)のマス数
+#define GRID_H          10      // 地図の縦(y方向)のマス数
+#define GRID_WAYPOINT_MAX   12  // 1つの経路の通過点の最大数(Motion.hのMOTION_QUEUE_SIZE以下にすること)
+
+/* 経路の番号(経路の始点・終点はGrid.cのroute_defに記述) */
+typedef enum {
+    GRID_ROUTE_RETURN,          // 赤ライン -> 黒ライン(section_BlockのRETURN)
+    GRID_ROUTE_NUM
+} grid_route_id_t;
+
+/* マス */
+typedef struct {
+    int8_t      x;
+    int8_t      y;
+} grid_cell_t;
+
+/* 経路(始点を除く通過点の列。最後の点が終点) */
+typedef struct {
+    uint8_t     num;
+    grid_cell_t point[GRID_WAYPOINT_MAX];
+} grid_route_t;
+
+/* 関数プロトタイプ宣言 */
+
+// 初期化(全経路を探索して通過点を作成する。経路が見つからない経路があれば偽を返す)
+bool_t  Grid_init(void);
+
+// 経路を取得(探索に失敗した経路は通過点の数が0)
+const grid_route_t *Grid_getRoute(grid_route_id_t id);
+
+// 現在位置をマスの座標と向き[deg](x軸から右回転が正)で設定する
+void    Grid_setPose(int x, int y, float heading);
+
+// 経路の通過点をMOTION_GOTOとしてキューに積む。戻り値は最後の命令の番号(失敗した場合は0 *キューに全部入らない場合は1つも積まない)
+uint32_t Grid_pushRoute(grid_route_id_t id, int8_t power, int16_t turn_max);
+
+#endif
@@ -0,0 +1,174 @@
+#include "Line.h"
+#include "Param.h"
+
+/* マクロ定義 */
+#define PI          3.14159265358
+#define LUT_NUM     64          // 換算表の区間数
+#define WEIGHT_R    0.5         // 明るさを求めるときの各チャンネルの重み(合計1.0)
+#define WEIGHT_G    0.25
+#define WEIGHT_B    0.25
+
+/* グローバル宣言 */
+// 白・黒の参照値(既定値はホストの模擬コースと同じ値。実機ではLine_calibrateまたはBluetoothで測り直す)
+static int16_t white[3] = { 150, 170, 170 };
+static int16_t black[3] = {  20,  40,  40 };
+static int16_t applied[2][3] = {        // 係数を求めたときの参照値(Bluetoothからの変更の検知用)
+    { 150, 170, 170 },
+    {  20,  40,  40 }
+};
+static bool_t calibrated[2] = { false, false };     // 参照値を測定・変更したかどうか(白, 黒)
+
+static float gain[3];                   // 正規化の係数(重み / (白 - 黒))
+static uint32_t version = 0xffffffff;   // 係数を求めたときのパラメータの変更回数
+static int16_t lut[LUT_NUM + 1];        // 明るさ(i / LUT_NUM) -> エッジからのずれ[0.1mm]
+
+/* 関数 */
+
+// 参照値から正規化の係数を求める
+static void Line_update(void)
+{
+    static const float weight[3] = { WEIGHT_R, WEIGHT_G, WEIGHT_B };
+    int i;
+
+    for(i = 0; i < 3; i++)
+    {
+        gain[i] = (white[i] > black[i]) ? weight[i] / (white[i] - black[i]) : 0.0;
+        if(white[i] != applied[LINE_REF_WHITE][i])
+            calibrated[LINE_REF_WHITE] = true;
+        if(black[i] != applied[LINE_REF_BLACK][i])
+            calibrated[LINE_REF_BLACK] = true;
+        applied[LINE_REF_WHITE][i] = white[i];
+        applied[LINE_REF_BLACK][i] = black[i];
+    }
+    version = Param_getVersion();
+}
+
+// 初期化
+// 直径Dの円の中心がエッジからdだけ白の側にあるとき、白にかかる割合は u = 2d / D として 0.5 + (asin(u) + u * sqrt(1 - u^2)) / π
+// これを二分法で逆に解き、明るさからずれを引く表を作る
+void Line_init(void)
+{
+    float target, lo, hi, u;
+    int i, k;
+
+    for(i = 0; i <= LUT_NUM; i++)
+    {
+        target = (float)i / LUT_NUM;
+        lo = -1.0;
+        hi = 1.0;
+        for(k = 0; k < 20; k++)
+        {
+            u = (lo + hi) / 2.0;
+            if(0.5 + (asinf(u) + u * sqrtf(1.0 - u * u)) / PI < target)
+                lo = u;
+            else
+                hi = u;
+        }
+        lut[i] = (int16_t)lroundf((lo + hi) / 2.0 * LINE_SPOT_MM / 2.0 * LINE_OFFSET_SCALE);
+    }
+    Line_update();
+}
+
+// Bluetoothから調整するパラメータを登録
+void Line_initParam(void)
+{
+    Param_add("white_r", PARAM_INT16, &white[0], 0, 1023);
+    Param_add("white_g", PARAM_INT16, &white[1], 0, 1023);
+    Param_add("white_b", PARAM_INT16, &white[2], 0, 1023);
+    Param_add("black_r", PARAM_INT16, &black[0], 0, 1023);
+    Param_add("black_g", PARAM_INT16, &black[1], 0, 1023);
+    Param_add("black_b", PARAM_INT16, &black[2], 0, 1023);
+}
+
+// 参照値を設定
+void Line_setReference(line_ref_t ref, const rgb_raw_t *rgb)
+{
+    int16_t *p = (ref == LINE_REF_WHITE) ? white : black;
+
+    p[0] = rgb->r;
+    p[1] = rgb->g;
+    p[2] = rgb->b;
+    calibrated[ref] = true;     // 既定値と同じ値でも測定済みとする
+    Line_update();
+}
+
+// 参照値を測定
+void Line_calibrate(line_ref_t ref)
+{
+    rgb_raw_t rgb;
+    uint32_t sum[3] = { 0, 0, 0 };
+    int i;
+
+    for(i = 0; i < LINE_CALIB_SAMPLES; i++)
+    {
+        ev3_color_sensor_get_rgb_raw(EV3_PORT_2, &rgb);
+        sum[0] += rgb.r;
+        sum[1] += rgb.g;
+        sum[2] += rgb.b;
+        tslp_tsk(10 * 1000U);   // センサーの更新を待つ
+    }
+    rgb.r = sum[0] / LINE_CALIB_SAMPLES;
+    rgb.g = sum[1] / LINE_CALIB_SAMPLES;
+    rgb.b = sum[2] / LINE_CALIB_SAMPLES;
+    Line_setReference(ref, &rgb);
+}
+
+// 参照値を測定・変更したかどうか
+bool_t Line_isCalibrated(void)
+{
+    if(Param_getVersion() != version)   // Bluetoothから参照値が変更された場合
+        Line_update();
+    return calibrated[LINE_REF_WHITE] && calibrated[LINE_REF_BLACK];
+}
+
+// 明るさ(表の位置 0 ~ LUT_NUM)からずれを求める(前後の値を線形補間する)
+static int16_t Line_lookup(float x)
+{
+    int i;
+
+    if(x <= 0.0)
+        return lut[0];
+    if(x >= LUT_NUM)
+        return lut[LUT_NUM];
+    i = (int)x;
+    return lut[i] + (int16_t)((lut[i + 1] - lut[i]) * (x - i));
+}
+
+// エッジからのずれを求める
+int16_t Line_getOffset(const rgb_raw_t *rgb)
+{
+    if(Param_getVersion() != version)   // Bluetoothから参照値が変更された場合
+        Line_update();
+
+    // 正規化した明るさ(0 ~ 1)を表の位置に換算する
+    return Line_lookup(((rgb->r - black[0]) * gain[0] + (rgb->g - black[1]) * gain[1] + (rgb->b - black[2]) * gain[2]) * LUT_NUM);
+}
+
+// R値の目標値をずれに換算
+int16_t Line_offsetFromR(int16_t r)
+{
+    if(Param_getVersion() != version)
+        Line_update();
+    if(white[0] <= black[0])
+        return 0;
+    return Line_lookup((float)(r - black[0]) / (white[0] - black[0]) * LUT_NUM);
+}
+
+// R値がrとなる位置でのずれ1あたりのR値の変化
+// 白にかかる割合 0.5 + (asin(u) + u * sqrt(1 - u^2)) / π の傾きは 2 * sqrt(1 - u^2) / π (u = 2d / D, Line_initを参照)
+// *換算表は0.1mm単位の整数のため、表の差分ではなく同じ式の微分で求める(エッジ付近では表の1区間が1 ~ 2にしかならない)
+float Line_rPerOffset(int16_t r)
+{
+    float u;
+
+    if(Param_getVersion() != version)
+        Line_update();
+    if(white[0] <= black[0])
+        return 0.0;
+
+    u = Line_offsetFromR(r) / (LINE_SPOT_MM / 2.0 * LINE_OFFSET_SCALE);
+    if(u <= -1.0 || 1.0 <= u)           // 検出範囲がエッジから外れる位置(傾き0)
+        return 0.0;
+    return (white[0] - black[0]) * 2.0 * sqrtf(1.0 - u * u) / PI / (LINE_SPOT_MM / 2.0 * LINE_OFFSET_SCALE);
+}
+
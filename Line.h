@@ -0,0 +1,61 @@
+#ifndef INCLUDED_Line_h_
+#define INCLUDED_Line_h_
+
+#include "ev3api.h"
+
+// ラインのエッジからの横方向のずれの推定
+// RGBの各チャンネルを白・黒の参照値で0(黒) ~ 1(白)に正規化して重み付きで平均し、
+// 円形の検出範囲(直径LINE_SPOT_MM)がエッジにかかっている割合とみなして、検出範囲の中心のエッジからのずれ[mm]に換算する
+// 区間ごとにR値で調整していた目標値・ゲインは、参照値で換算して使う(Line_offsetFromR, Line_rPerOffset)
+// そのため照明が変わっても参照値を測り直すだけで、各区間の目標値(エッジからのずれ)と目標値の付近での旋回の強さが変わらない
+// 参照値はスタート待ちの間にボタンで測定するか(Line_calibrate)、Bluetoothから変更する(white_r ~ black_b *Param.h)
+// *既定の参照値はホストの模擬コース(host/ev3api_host.cのhost_set_line)の値で、実機の値ではない
+//  実機では白・黒の両方を測定するまで走行を開始しない(app.c *Line_isCalibrated)
+// *ずれは白の側を正とする(R値と同じ向き。PID制御の符号は変わらない)
+
+/* マクロ定義 */
+// カラーセンサーの検出範囲の直径[mm]
+// ずれは検出範囲がエッジにかかっている間しか求まらず(外れると全て白または黒)、推定範囲は±LINE_SPOT_MM / 2になる
+// *10mmは実測値ではない。センサーをエッジと直角に動かし、R値が黒の値から白の値に変わるまでの距離を測って
+//  ビルド時に -DLINE_SPOT_MM=12.0 などで変更する(ゲインはLine_rPerOffsetで換算するため調整し直す必要はない)
+#ifndef LINE_SPOT_MM
+#define LINE_SPOT_MM        10.0
+#endif
+#define LINE_OFFSET_SCALE   10      // Line_getOffsetの値の単位(1mmあたりの値 *0.1mm単位)
+#define LINE_CALIB_SAMPLES  16      // 参照値を測定するときに平均する回数
+
+/* 参照値の種類 */
+typedef enum {
+    LINE_REF_WHITE,
+    LINE_REF_BLACK
+} line_ref_t;
+
+/* 関数プロトタイプ宣言 */
+
+// 換算表を作成し、参照値から正規化の係数を求める(参照値は初期化しない)
+void    Line_init(void);
+
+// 参照値をBluetoothから調整するパラメータとして登録
+void    Line_initParam(void);
+
+// 参照値を設定
+void    Line_setReference(line_ref_t ref, const rgb_raw_t *rgb);
+
+// カラーセンサーを直接読み、LINE_CALIB_SAMPLES回の平均を参照値とする(周期ハンドラの起動前に、白または黒の上に置いて呼ぶ)
+void    Line_calibrate(line_ref_t ref);
+
+// 白・黒の参照値の両方を測定した(またはBluetoothから変更した)かどうか
+bool_t  Line_isCalibrated(void);
+
+// RGB値からエッジからのずれ[0.1mm]を求める(白の側が正)
+int16_t Line_getOffset(const rgb_raw_t *rgb);
+
+// R値で調整していた目標値を、現在の参照値でのずれ[0.1mm]に換算する(G・BもRと同じ割合の明るさとみなす)
+int16_t Line_offsetFromR(int16_t r);
+
+// R値がrとなる位置での、ずれ1(0.1mm)あたりのR値の変化(換算表の傾き)
+// R値の偏差で調整したPIDゲインにこれを掛けると、目標値rの付近でR値の偏差と同じ旋回値になるずれの偏差に対するゲインになる
+// *エッジ上(白と黒の中間)の傾きは推定範囲全体の平均((白 - 黒) / 推定範囲)の4/π倍になるため、平均では換算しない
+float   Line_rPerOffset(int16_t r);
+
+#endif
@@ -0,0 +1,109 @@
+#include <string.h>
+#include "Log.h"
+
+/* マクロ定義 */
+#define LOG_MASK        (LOG_BUF_RECORDS - 1)
+#define STAMP_RECORDS   8   // 予約できるスタンプ数(2のべき乗にすること)
+#define STAMP_MASK      (STAMP_RECORDS - 1)
+
+/* グローバル宣言 */
+// 生産者(周期ハンドラ)1つ、消費者(書き込みタスク)1つのリングバッファ
+// headは生産者のみ、tailは消費者のみが更新するため、排他制御は不要
+static log_record_t buf[LOG_BUF_RECORDS];
+static volatile uint32_t head = 0;  // 次に書き込む位置(生産者)
+static volatile uint32_t tail = 0;  // 次に読み出す位置(消費者)
+static volatile uint32_t dropped = 0;
+
+// メインタスク -> 周期ハンドラへのスタンプ受け渡し用(同じく生産者1つ、消費者1つ)
+static const char *stamp_buf[STAMP_RECORDS];
+static volatile uint32_t stamp_head = 0;
+static volatile uint32_t stamp_tail = 0;
+
+/* 関数 */
+
+// 初期化
+void Log_init(void)
+{
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    stamp_head = 0;
+    stamp_tail = 0;
+}
+
+// レコードを1つ積む
+int Log_push(const log_record_t *record)
+{
+    uint32_t h = head;
+
+    if(h - tail >= LOG_BUF_RECORDS)     // 満杯の場合
+    {
+        dropped++;                          // 書き込みを待たずに破棄
+        return 0;
+    }
+    buf[h & LOG_MASK] = *record;        // レコードを書き込んでから
+    head = h + 1;                       // 位置を進める
+    return 1;
+}
+
+// 予約されたスタンプをレコードとして積む
+void Log_pushStamps(void)
+{
+    log_record_t record;
+    const char *text;
+    int i;
+
+    while(stamp_tail != stamp_head)
+    {
+        text = stamp_buf[stamp_tail & STAMP_MASK];
+        stamp_tail++;
+
+        memset(&record, 0, sizeof(record));
+        record.stamp.type = LOG_TYPE_STAMP;
+        for(i = 0; i < LOG_STAMP_LEN && text[i] != '\0'; i++)   // 終端文字は入りきる場合のみ残る
+            record.stamp.text[i] = text[i];
+
+        Log_push(&record);
+    }
+}
+
+// 文字列をスタンプとして予約する(文字列リテラルを渡すこと)
+void Log_stamp(const char *text)
+{
+    if(stamp_head - stamp_tail >= STAMP_RECORDS)    // 予約が溜まりすぎている場合
+    {
+        dropped++;
+        return;
+    }
+    stamp_buf[stamp_head & STAMP_MASK] = text;
+    stamp_head++;
+}
+
+// 溜まったレコードをブロック単位で書き込む
+uint32_t Log_flush(FILE *fp, int all)
+{
+    uint32_t written = 0;
+    uint32_t n;
+
+    while(1)
+    {
+        n = head - tail;                            // 書き込み可能なレコード数
+        if(!all)
+            n -= n % LOG_BLOCK_RECORDS;                 // ブロック単位に切り捨て
+        if(n > LOG_BUF_RECORDS - (tail & LOG_MASK))
+            n = LOG_BUF_RECORDS - (tail & LOG_MASK);    // バッファ末尾で折り返すため分割
+        if(n == 0)
+            break;
+
+        fwrite(&buf[tail & LOG_MASK], sizeof(log_record_t), n, fp);
+        tail += n;                                  // 書き込み後に位置を進める
+        written += n;
+    }
+    return written;
+}
+
+// 破棄されたレコード数を取得
+uint32_t Log_getDropped(void)
+{
+    return dropped;
+}
@@ -0,0 +1,89 @@
+#ifndef INCLUDED_Log_h_
+#define INCLUDED_Log_h_
+
+// 走行ログ用のリングバッファ
+// 周期ハンドラ(datalog_cyc)はバイナリのレコードを積むだけで、SDカードへの書き込みは優先度の低いタスクがまとめて行う
+// *ホスト側のデコーダ(tools/log_decode.c)からもインクルードするため、ev3api.hには依存させないこと
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* マクロ定義 */
+#define LOG_MAGIC           0x474C5048u // ファイル先頭の識別子("HPLG")
+#define LOG_VERSION         1           // レコード形式のバージョン
+
+#define LOG_BUF_RECORDS     256         // リングバッファのレコード数(2のべき乗にすること)
+#define LOG_BLOCK_SIZE      512         // SDカードのセクタ長[byte]
+#define LOG_BLOCK_RECORDS   16          // 一度に書き込むレコード数(32byte * 16 = LOG_BLOCK_SIZE)
+#define LOG_STAMP_LEN       31          // スタンプ文字列の最大長
+
+/* レコードの種類 */
+enum {
+    LOG_TYPE_DATA  = 0,     // 計測値
+    LOG_TYPE_STAMP = 1      // Trace_markで記録したマーカーの名前(区切り)
+};
+
+/* ファイルヘッダ(LOG_BLOCK_SIZE byte)
+ * 後に続くレコードのブロック(LOG_BLOCK_RECORDS個)の書き込みがセクタの境界をまたがないよう、ヘッダは1ブロック分に埋める */
+typedef struct {
+    uint32_t    magic;          // LOG_MAGIC
+    uint16_t    version;        // LOG_VERSION
+    uint16_t    record_size;    // sizeof(log_record_t)
+    uint32_t    tick_ms;        // Run_getTime()の1単位あたりの時間[ms]
+    uint32_t    reserved;
+    uint8_t     padding[LOG_BLOCK_SIZE - 16];   // 0で埋める
+} log_header_t;
+
+/* 計測値レコード(32byte) *型のサイズと並びを固定するため、run_data_tをそのまま書き出さずにこの形に詰め替える */
+typedef struct {
+    uint8_t     type;           // LOG_TYPE_DATA
+    int8_t      power_L;
+    int8_t      power_R;
+    uint8_t     reserved;
+    uint16_t    r;
+    uint16_t    g;
+    uint16_t    b;
+    int16_t     angle;
+    float       distance;
+    float       direction;
+    uint32_t    time;           // 走行時間(tick_ms単位)
+    int32_t     arm_angle;      // アームモーターの角度
+    uint32_t    reserved2;
+} log_data_t;
+
+/* スタンプレコード(32byte) */
+typedef struct {
+    uint8_t     type;           // LOG_TYPE_STAMP
+    char        text[LOG_STAMP_LEN];    // 終端文字を含まない場合がある
+} log_stamp_t;
+
+typedef union {
+    uint8_t     type;
+    log_data_t  data;
+    log_stamp_t stamp;
+} log_record_t;
+
+/* 関数プロトタイプ宣言 */
+#ifndef LOG_HOST
+
+// 初期化(ファイルを開いた直後に呼ぶ)
+void     Log_init(void);
+
+// 生産者側(周期ハンドラ)：レコードを1つ積む。満杯の場合は破棄して0を返す
+int      Log_push(const log_record_t *record);
+
+// 生産者側(周期ハンドラ)：Log_stampで予約された文字列をレコードとして積む
+void     Log_pushStamps(void);
+
+// メインタスク側：文字列をスタンプとして予約する(周期ハンドラの次回起動時に記録される)
+void     Log_stamp(const char *text);
+
+// 消費者側(書き込みタスク)：溜まったレコードをブロック単位で書き込む(allが真の場合は端数も書き込む)
+uint32_t Log_flush(FILE *fp, int all);
+
+// 書き込みに間に合わず破棄されたレコード数を取得
+uint32_t Log_getDropped(void);
+
+#endif
+
+#endif
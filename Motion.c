@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include "Motion.h"
+
+/* マクロ定義 */
+#define QUEUE_MASK  (MOTION_QUEUE_SIZE - 1)
+#define EDGE        1   // 1でLコース、-1でRコース(Controller.cと合わせること)
+#define TREAD       145.0   // 車体トレッド幅[mm](Run.cと同じ値)
+#define MIN_POWER   5       // 目標の手前で止まらないための最低出力
+#define GOTO_KP     2.0     // MOTION_GOTOの向きの誤差[deg]に対する旋回値の比例ゲイン
+#define GOTO_RADIUS 30.0    // MOTION_GOTOで目標座標に到達したとみなす距離[mm]
+
+/* グローバル宣言 */
+// メインタスクが積み、周期ハンドラが取り出すキュー(headはメインタスク、tailは周期ハンドラのみが更新する)
+static motion_cmd_t queue[MOTION_QUEUE_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+
+static volatile uint32_t issued = 0;        // 最後に割り当てた命令番号(メインタスク)
+static volatile uint32_t completed = 0;     // 最後に完了した命令番号(周期ハンドラ)
+static volatile bool_t cancel_req = false;  // 取り消し要求
+
+// 実行中の命令
+static motion_cmd_t active;
+static bool_t active_valid = false;
+static bool_t stopping = false;     // 目標に到達して減速中かどうか
+static float ref_distance;          // 命令開始時点での距離
+static float ref_direction;         // 命令開始時点での方位
+static run_pose_t ref_pose;         // 命令開始時点での位置
+static profile_t profile;           // 速度プロファイル
+static float traveled;              // 命令開始からの移動距離[mm](プロファイルの位置)
+
+/* 関数 */
+
+// 命令をキューに積む
+uint32_t Motion_push(const motion_cmd_t *cmd)
+{
+    uint32_t h = head;
+    uint32_t id = issued + 1;
+
+    if(h - tail >= MOTION_QUEUE_SIZE)   // キューが満杯の場合
+        return 0;
+
+    queue[h & QUEUE_MASK] = *cmd;
+    queue[h & QUEUE_MASK].id = id;
+    head = h + 1;                       // 書き込んでから位置を進める
+    issued = id;                        // 位置を進めてから番号を公開する(キューにない命令を実行中とみなさない)
+    return id;
+}
+
+// 指定距離を加減速なしで走行する命令
+uint32_t Motion_pushRun(int8_t power, int16_t turn, float distance)
+{
+    motion_cmd_t cmd = { MOTION_RUN, power, turn, 0, distance, NULL, 0, 0 };
+
+    if(!((power > 0 && distance > 0) || (power < 0 && distance < 0)))   // 前進・後退と距離の符号が合わない場合
+        return 0;
+    return Motion_push(&cmd);
+}
+
+// 指定距離を加減速して走行する命令
+uint32_t Motion_pushDistance(int8_t power, int16_t turn, float distance)
+{
+    motion_cmd_t cmd = { MOTION_DISTANCE, power, turn, 0, distance, NULL, 0, 0 };
+
+    if(!((power > 0 && distance > 0) || (power < 0 && distance < 0)))
+        return 0;
+    return Motion_push(&cmd);
+}
+
+// 指定方位まで旋回する命令
+uint32_t Motion_pushDirection(int8_t power, int16_t turn, float direction)
+{
+    motion_cmd_t cmd = { MOTION_DIRECTION, power, turn, 0, direction * EDGE, NULL, 0, 0 };  // R/Lコースの変換処理
+
+    if(!(power != 0 && ((turn > 0 && cmd.value > 0) || (turn < 0 && cmd.value < 0))))  // 旋回方向と方位の符号が合わない場合
+        return 0;
+    return Motion_push(&cmd);
+}
+
+// 障害物を検知するまで走行する命令(distanceが0の場合は距離の条件なし)
+uint32_t Motion_pushDetection(int8_t power, int16_t turn, int16_t detection, float distance)
+{
+    motion_cmd_t cmd = { MOTION_DETECTION, power, turn, detection, distance, NULL, 0, 0 };
+
+    if(!(power > 0 && distance >= 0))
+        return 0;
+    return Motion_push(&cmd);
+}
+
+// 速度プロファイルに従って指定距離を走行し、目標の距離で止まる命令
+uint32_t Motion_pushDistancePlanned(int8_t power, int16_t turn, float distance)
+{
+    motion_cmd_t cmd = { MOTION_DISTANCE, power, turn, 0, distance, NULL, 0, 0, 0.0, 0.0, true };
+
+    if(!((power > 0 && distance > 0) || (power < 0 && distance < 0)))
+        return 0;
+    return Motion_push(&cmd);
+}
+
+// 速度プロファイルに従って旋回し、目標の方位で止まる命令
+uint32_t Motion_pushDirectionPlanned(int8_t power, int16_t turn, float direction)
+{
+    motion_cmd_t cmd = { MOTION_DIRECTION, power, turn, 0, direction * EDGE, NULL, 0, 0, 0.0, 0.0, true };
+
+    if(!(power != 0 && ((turn > 0 && cmd.value > 0) || (turn < 0 && cmd.value < 0))))
+        return 0;
+    return Motion_push(&cmd);
+}
+
+// 指定座標に向かって走行する命令(座標はLコースの値で指定する)
+uint32_t Motion_pushGoto(int8_t power, int16_t turn_max, float x, float y)
+{
+    motion_cmd_t cmd = { MOTION_GOTO, power, turn_max, 0, 0.0, NULL, 0, 0, x, y * EDGE };   // R/Lコースの変換処理
+
+    if(!(power > 0 && turn_max > 0))
+        return 0;
+    return Motion_push(&cmd);
+}
+
+// キューの空き数
+uint32_t Motion_getFree(void)
+{
+    return MOTION_QUEUE_SIZE - (head - tail);
+}
+
+// 指定した命令が完了したかどうか
+bool_t Motion_isDone(uint32_t id)
+{
+    return (int32_t)(completed - id) >= 0;
+}
+
+// 実行中または未実行の命令があるかどうか
+bool_t Motion_isBusy(void)
+{
+    return !Motion_isDone(issued);
+}
+
+// 指定した命令が完了するまで待機
+void Motion_wait(uint32_t id)
+{
+    while(!Motion_isDone(id))
+        Clock_wait();           /* 周期ハンドラの次の更新まで待機 */
+}
+
+// 命令をすべて取り消す
+void Motion_cancel(void)
+{
+    cancel_req = true;
+}
+
+// 速度プロファイルの移動距離(左右の車輪の移動量の平均)を求める
+static float Motion_getPlannedTravel(void)
+{
+    float t;
+
+    switch(active.type)
+    {
+        case MOTION_DISTANCE:
+            return fabsf(active.value);
+
+        case MOTION_DIRECTION:
+            // 左右の車輪の移動量の差 = 方位 * π * トレッド幅 / 180 を、turn値による左右の出力比で平均の移動量に換算
+            t = abs(active.turn) / 100.0f;
+            return fabsf(active.value) * 3.14159265358 * TREAD / 180.0 * (1.0 + fabsf(1.0f - t)) / (2.0 * t);
+
+        default:                // 障害物検知などは到達の条件が満たされてから減速する
+            return PROFILE_UNLIMITED;
+    }
+}
+
+// 命令を開始する
+static void Motion_start(void)
+{
+    active = queue[tail & QUEUE_MASK];
+    tail = tail + 1;
+    active_valid = true;
+    stopping = false;
+    ref_distance = Run_getDistance();
+    ref_direction = Run_getDirection();
+    Run_getPose(&ref_pose);
+    if(!active.planned)
+        return;
+
+    // 速度プロファイルは現在の出力から始める(前進・後退が入れ替わる場合は0から)
+    Profile_init(&profile, Motion_getPlannedTravel(), Profile_fromPower(abs(active.power)), 0.0, PROFILE_ACCEL, PROFILE_JERK);
+    if((Run_getPower() > 0) == (active.power > 0))
+        Profile_start(&profile, Profile_fromPower(abs(Run_getPower())));
+    traveled = 0.0;
+}
+
+// 実行中の命令の目標に到達したかどうか
+static bool_t Motion_isReached(void)
+{
+    switch(active.type)
+    {
+        case MOTION_RUN:
+        case MOTION_DISTANCE:
+            if(active.value > 0)
+                return Run_getDistance() >= ref_distance + active.value;
+            else
+                return Run_getDistance() <= ref_distance + active.value;
+
+        case MOTION_DIRECTION:
+            if(active.value > 0)
+                return Run_getDirection() >= ref_direction + active.value;
+            else
+                return Run_getDirection() <= ref_direction + active.value;
+
+        case MOTION_DETECTION:
+            if(Run_getSonarRaw() <= active.detection)      // 停止の判定は平滑化の遅れがない最新の測定値で行う
+                return true;
+            return active.value > 0 && Run_getDistance() >= ref_distance + active.value;
+
+        case MOTION_GOTO:   // Motion_stepGotoで判定する
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+// 指定座標に向かって1周期分走行する。到達した(または通り過ぎた)場合はtrueを返す
+static bool_t Motion_stepGoto(void)
+{
+    run_pose_t pose;
+    float dx, dy, err;
+    int16_t turn;
+
+    Run_getPose(&pose);
+    dx = active.x - pose.x;
+    dy = active.y - pose.y;
+
+    // 目標までの距離が十分近いか、命令開始位置から見て目標を通り過ぎた場合は到達とする(次の命令に出力を引き継ぐ)
+    if(dx * dx + dy * dy < GOTO_RADIUS * GOTO_RADIUS
+       || dx * (active.x - ref_pose.x) + dy * (active.y - ref_pose.y) <= 0)
+        return true;
+
+    // 目標の方位と現在の向きの差(右回転が正)に比例した旋回値で走行
+    err = remainderf(atan2f(dy, dx) * (180.0 / 3.14159265358) - pose.heading, 360.0);
+    turn = (int16_t)Ctrl_math_limit(GOTO_KP * err, -active.turn, active.turn);
+    Ctrl_motion_steer_alt(active.power, turn * EDGE, 0.1);  // 実際の座標で計算した旋回値のため、Ctrl_motor_steerでのR/Lコースの変換を打ち消す
+    return false;
+}
+
+// 実行中の命令を1周期分進める。完了した場合はtrueを返す
+static bool_t Motion_step(void)
+{
+    int8_t power;
+
+    if(active.type == MOTION_GOTO)          // 座標指定(停止せずに次の命令へ)
+        return Motion_stepGoto();
+
+    if(active.type == MOTION_RUN)           // 加減速なし(到達した周期の出力のまま次の命令へ)
+    {
+        Ctrl_motion_steer(active.power, active.turn);
+        return Motion_isReached();
+    }
+
+    if(!active.planned)                     // 目標に到達してから減速する(調整済みの区間の動作)
+    {
+        if(!stopping && Motion_isReached())
+            stopping = true;
+
+        if(stopping)
+        {
+            Ctrl_motion_steer_alt(0, active.turn, 0.1);     // モーターが停止するまで減速
+            return Run_getPower() == 0;
+        }
+
+        Ctrl_motion_steer_alt(active.power, active.turn, 0.1);  // 指定出力になるまで加速して走行
+        return false;
+    }
+
+    // プロファイルの位置 : 距離指定の命令は走行距離、それ以外は左右の車輪の移動量の平均(その場旋回でも進むように)
+    if(active.type == MOTION_DISTANCE)
+        traveled = fabsf(Run_getDistance() - ref_distance);
+    else
+        traveled += (fabsf(Run_getDistance4msLeft()) + fabsf(Run_getDistance4msRight())) / 2.0;
+
+    if(!stopping && Motion_isReached())     // 目標に到達した場合は減速に移る
+    {
+        stopping = true;
+        if(active.type == MOTION_DETECTION)     // 距離・方位指定の場合は目標の手前で減速済み
+            Profile_stop(&profile, traveled);
+    }
+
+    power = Profile_toPower(Profile_update(&profile, traveled, CLOCK_DT));
+    if(stopping && (power == 0 || Profile_isDone(&profile, traveled)))
+    {
+        Ctrl_motion_steer(0, 0);                // 停止して次の命令へ
+        return true;
+    }
+    if(!stopping && power < MIN_POWER)
+        power = MIN_POWER;
+
+    Ctrl_motion_steer((active.power > 0) ? power : -power, active.turn);
+    return false;
+}
+
+// 実行中の命令を1周期分進める
+void Motion_update(void)
+{
+    if(cancel_req)                          // 取り消し要求がある場合
+    {
+        uint32_t h = head;
+
+        tail = h;                               // 未実行の命令を捨てて
+        if(active_valid)
+            Ctrl_motion_steer(0, 0);                // 停止する
+        active_valid = false;
+        completed = queue[(h - 1) & QUEUE_MASK].id; // キューに積まれた最後の命令までを完了とする(まだ積んでいない場合は0)
+                                                //  *issuedは積んでいる途中の命令を含む場合があるため使わない
+        cancel_req = false;
+        return;
+    }
+
+    while(1)
+    {
+        if(!active_valid)                   // 実行中の命令がない場合
+        {
+            if(tail == head)                    // キューが空の場合は何もしない
+                return;
+            Motion_start();                     // 次の命令を開始
+        }
+
+        if(!Motion_step())                  // 完了していない場合は次の周期へ
+            return;
+
+        active_valid = false;               // 完了した場合は通知して、同じ周期のうちに次の命令を開始する
+        completed = active.id;
+        if(active.done != NULL)
+            active.done(active.arg);
+    }
+}
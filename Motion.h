@@ -0,0 +1,65 @@
+#ifndef INCLUDED_Motion_h_
+#define INCLUDED_Motion_h_
+
+#include "Controller.h"
+#include "Profile.h"
+
+// 走行命令のキュー
+// 各区間(メインタスク)は命令をキューに積むだけで処理を続けることができ、命令は周期ハンドラ(datalog_cyc)が1周期ずつ実行する
+// 1つの命令が完了すると、同じ周期のうちに次の命令を開始するため、連続した動作の間に待ち時間が生じない
+// MOTION_DISTANCE, MOTION_DIRECTION, MOTION_DETECTIONは、目標に到達してから減速して停止する(各区間で調整した従来の動作)
+// Motion_push*Plannedで積んだ命令は速度プロファイル(Profile.h)に従って加減速し、目標で止まるよう手前から減速する
+// *命令の実行中は、メインタスクからCtrl_motor_steer等でモーターを操作しないこと(モーターと加減速の状態は周期ハンドラが
+//  Ctrl_motion_steer*で操作する。キューが空でないときにメインタスクから呼ぶとassertで止まる *Controller.h)
+
+/* マクロ定義 */
+#define MOTION_QUEUE_SIZE   16  // キューに積める命令の数(2のべき乗にすること)
+
+/* 命令の種類 */
+typedef enum {
+    MOTION_RUN,         // 指定距離を加減速なしで走行(Slalom_run)
+    MOTION_DISTANCE,    // 指定距離を加減速して走行し停止(Ctrl_runDistance)
+    MOTION_DIRECTION,   // 指定方位まで加減速して旋回し停止(Ctrl_runDirection)
+    MOTION_DETECTION,   // 障害物を検知するまで加減速して走行し停止(Ctrl_runDetection)
+    MOTION_GOTO         // 指定座標に向かって走行(停止しない。Grid_pushRouteで経路の通過点を順に積む)
+} motion_type_t;
+
+/* 命令 */
+typedef struct {
+    motion_type_t   type;
+    int8_t          power;      // Ctrl_motor_steer関数のpower値(-100 ~ +100)
+    int16_t         turn;       // Ctrl_motor_steer関数のturn値(-200 ~ +200) *MOTION_GOTOでは旋回値の上限
+    int16_t         detection;  // 障害物を検知する距離(MOTION_DETECTION)
+    float           value;      // 移動する距離(MOTION_RUN, MOTION_DISTANCE, MOTION_DETECTION) または 旋回する方位(MOTION_DIRECTION)
+    void            (*done)(intptr_t arg);  // 完了時に周期ハンドラから呼ばれる関数(NULLで無効)
+    intptr_t        arg;        // doneに渡す値
+    uint32_t        id;         // 命令番号(Motion_push*が割り当てる)
+    float           x, y;       // 目標座標[mm](MOTION_GOTO *座標系はRun_setPoseを参照)
+    bool_t          planned;    // 速度プロファイルに従って目標で止まる(true)か、目標に到達してから減速する(false)か
+} motion_cmd_t;
+
+/* 関数プロトタイプ宣言 */
+
+// メインタスク側 ******************************************************************
+// 命令をキューに積む。戻り値は命令番号(引数が正しくない場合、キューが満杯の場合は0)
+uint32_t Motion_push(const motion_cmd_t *cmd);
+uint32_t Motion_pushRun(int8_t power, int16_t turn, float distance);
+uint32_t Motion_pushDistance(int8_t power, int16_t turn, float distance);
+uint32_t Motion_pushDirection(int8_t power, int16_t turn, float direction);
+uint32_t Motion_pushDetection(int8_t power, int16_t turn, int16_t detection, float distance);
+uint32_t Motion_pushGoto(int8_t power, int16_t turn_max, float x, float y);
+uint32_t Motion_pushDistancePlanned(int8_t power, int16_t turn, float distance);     // 目標の距離で止まる
+uint32_t Motion_pushDirectionPlanned(int8_t power, int16_t turn, float direction);   // 目標の方位で止まる
+
+uint32_t Motion_getFree(void);          // キューの空き数(まとめて積む前の確認用 *周期ハンドラは空きを増やすだけなので、確認後に減ることはない)
+
+bool_t   Motion_isDone(uint32_t id);    // 指定した命令(とそれ以前の命令)が完了したかどうか
+bool_t   Motion_isBusy(void);           // 実行中または未実行の命令があるかどうか
+void     Motion_wait(uint32_t id);      // 指定した命令が完了するまで待機
+void     Motion_cancel(void);           // 実行中と未実行の命令をすべて取り消して停止(次の周期で反映)
+
+// 周期ハンドラ側 ******************************************************************
+// 実行中の命令を1周期分進める(Run_updateの後に呼ぶ)
+void     Motion_update(void);
+
+#endif
@@ -0,0 +1,103 @@
+#include "Motor.h"
+
+/* マクロ定義 */
+#define STATE_UNKNOWN   0       // 未設定(次の書き込みは必ずドライバを呼ぶ)
+#define STATE_POWER     1       // 出力を設定中
+#define STATE_COAST     2       // 停止中(ブレーキなし)
+#define STATE_BRAKE     3       // 停止中(ブレーキあり)
+
+/* グローバル宣言 */
+typedef struct {
+    uint8_t     state;
+    int8_t      power;          // 設定した出力(停止中は0)
+} motor_cache_t;
+
+static motor_cache_t cache[TNUM_MOTOR_PORT];
+static motor_stats_t stats;
+static uint32_t start_tick;     // 統計を初期化したときの周期ハンドラの起動回数
+
+/* 関数 */
+
+// 初期化
+void Motor_init(void)
+{
+    int i;
+
+    for(i = 0; i < TNUM_MOTOR_PORT; i++)
+    {
+        cache[i].state = STATE_UNKNOWN;
+        cache[i].power = 0;
+    }
+    stats.writes = 0;
+    stats.skipped = 0;
+    stats.reads = 0;
+    start_tick = Clock_getTicks();
+}
+
+// 出力を設定
+void Motor_setPower(motor_port_t port, int power)
+{
+    motor_cache_t *c = &cache[port];
+
+    if(power > 100)
+        power = 100;
+    else if(power < -100)
+        power = -100;
+
+    if(c->state == STATE_POWER && c->power == power)    // 前回と同じ出力の場合は書き込まない
+    {
+        stats.skipped++;
+        return;
+    }
+    c->state = STATE_POWER;
+    c->power = power;
+    ev3_motor_set_power(port, power);
+    stats.writes++;
+}
+
+// 停止
+void Motor_stop(motor_port_t port, bool_t brake)
+{
+    motor_cache_t *c = &cache[port];
+    uint8_t state = brake ? STATE_BRAKE : STATE_COAST;
+
+    if(c->state == state)                               // 既に同じ方法で停止している場合は書き込まない
+    {
+        stats.skipped++;
+        return;
+    }
+    c->state = state;
+    c->power = 0;
+    ev3_motor_stop(port, brake);
+    stats.writes++;
+}
+
+// 出力を取得
+int8_t Motor_getPower(motor_port_t port)
+{
+    stats.reads++;
+    return cache[port].power;
+}
+
+// 統計を取得
+void Motor_getStats(motor_stats_t *s)
+{
+    *s = stats;
+    s->ticks = Clock_getTicks() - start_tick;
+}
+
+// 統計を出力
+void Motor_dump(FILE *fp)
+{
+    motor_stats_t s;
+    float sec;
+
+    Motor_getStats(&s);
+    sec = s.ticks * CLOCK_DT;
+    fprintf(fp, "motor       writes %lu, skipped %lu, cached reads %lu",
+            (unsigned long)s.writes, (unsigned long)s.skipped, (unsigned long)s.reads);
+    if(sec > 0)
+        fprintf(fp, " -> %.0f driver calls/s saved (%.2f per tick)",
+                (s.skipped + s.reads) / sec, (float)(s.skipped + s.reads) / s.ticks);
+    fprintf(fp, "\n");
+}
@@ -0,0 +1,30 @@
+#ifndef INCLUDED_Motor_h_
+#define INCLUDED_Motor_h_
+
+#include <stdio.h>
+#include "ev3api.h"
+#include "Clock.h"
+
+// モーター出力の書き込みキャッシュ
+// ポートごとに最後に設定した出力(または停止)を保持し、値が変わった場合のみev3_motor_set_power/ev3_motor_stopを呼ぶ
+// 出力の読み出し(Run_updateMotorなど)はドライバを呼ばずにキャッシュから返す
+// *キャッシュが実際の出力とずれないよう、モーターの出力・停止はすべてこのモジュールを通して行うこと
+//  (同じポートへの書き込みを複数のタスクから同時に行うことは想定していない。Ctrl_motor_steerの入力値の記録と同様)
+
+/* 呼び出し回数の統計 */
+typedef struct {
+    uint32_t    writes;         // ドライバを呼んだ書き込みの回数
+    uint32_t    skipped;        // 値が変わらないため省略した書き込みの回数
+    uint32_t    reads;          // キャッシュから返した読み出しの回数(ドライバの呼び出しを省略した回数)
+    uint32_t    ticks;          // 統計を初期化してからの周期ハンドラの起動回数
+} motor_stats_t;
+
+/* 関数プロトタイプ宣言 */
+void    Motor_init(void);                               // キャッシュと統計を初期化(ev3_motor_configの後に呼ぶ)
+void    Motor_setPower(motor_port_t port, int power);   // 出力を設定(-100 ~ +100)
+void    Motor_stop(motor_port_t port, bool_t brake);    // 停止(brakeが真の場合はブレーキをかける)
+int8_t  Motor_getPower(motor_port_t port);              // 最後に設定した出力を取得(停止中は0)
+void    Motor_getStats(motor_stats_t *stats);           // 呼び出し回数の統計を取得
+void    Motor_dump(FILE *fp);                           // 統計と1秒あたりの省略した呼び出し回数を出力
+
+#endif
@@ -0,0 +1,180 @@
+#include <string.h>
+#include <math.h>
+#include "Param.h"
+#include "Clock.h"
+
+/* マクロ定義 */
+#define QUEUE_MASK      (PARAM_QUEUE - 1)
+#define ACK_MASK        (PARAM_ACK_QUEUE - 1)
+
+/* 構造体 */
+typedef struct {
+    char            name[TELE_PARAM_NAME_LEN];
+    param_type_t    type;
+    void            *ptr;
+    float           min;
+    float           max;
+} param_entry_t;
+
+typedef struct {
+    uint8_t         op;
+    tele_param_t    param;
+} param_req_t;
+
+/* グローバル宣言 */
+static param_entry_t table[PARAM_MAX];
+static uint8_t count = 0;
+static volatile uint32_t version = 0;
+
+// 受信タスク -> メインタスクへの要求(生産者1つ、消費者1つのためLog.cと同様に排他制御は不要)
+static param_req_t queue[PARAM_QUEUE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+
+// メインタスク -> 送信タスクへの応答(同じく生産者1つ、消費者1つ)
+static tele_param_t acks[PARAM_ACK_QUEUE];
+static volatile uint32_t ack_head = 0;
+static volatile uint32_t ack_tail = 0;
+
+/* 関数 */
+
+// 名前からパラメータを探す(見つからない場合は-1)
+static int Param_find(const char *name)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+        if(strncmp(table[i].name, name, TELE_PARAM_NAME_LEN) == 0)
+            return i;
+    return -1;
+}
+
+static float Param_read(const param_entry_t *e)
+{
+    switch(e->type)
+    {
+        case PARAM_INT8:    return *(int8_t *)e->ptr;
+        case PARAM_INT16:   return *(int16_t *)e->ptr;
+        default:            return *(float *)e->ptr;
+    }
+}
+
+static void Param_write(const param_entry_t *e, float value)
+{
+    switch(e->type)
+    {
+        case PARAM_INT8:    *(int8_t *)e->ptr  = (int8_t)lroundf(value);   break;
+        case PARAM_INT16:   *(int16_t *)e->ptr = (int16_t)lroundf(value);  break;
+        default:            *(float *)e->ptr   = value;                    break;
+    }
+}
+
+// 応答をキューに積む(満杯の場合は破棄。ホスト側は応答が無ければ再送する)
+static void Param_pushAck(int index, uint8_t op, uint8_t status, const char *name)
+{
+    tele_param_t *ack;
+    uint32_t h = ack_head;
+
+    if(h - ack_tail >= PARAM_ACK_QUEUE)
+        return;
+
+    ack = &acks[h & ACK_MASK];
+    memset(ack, 0, sizeof(*ack));
+    strncpy(ack->name, (index >= 0) ? table[index].name : name, TELE_PARAM_NAME_LEN);
+    ack->value  = (index >= 0) ? Param_read(&table[index]) : 0.0;
+    ack->time   = Clock_getTicks();
+    ack->op     = op;
+    ack->status = status;
+    ack->index  = (index >= 0) ? index : 0;
+    ack->count  = count;
+    ack_head = h + 1;
+}
+
+// 変数を登録
+int Param_add(const char *name, param_type_t type, void *ptr, float min, float max)
+{
+    int i = Param_find(name);
+
+    if(i < 0)
+    {
+        if(count >= PARAM_MAX)
+            return 0;
+        i = count++;
+    }
+    strncpy(table[i].name, name, TELE_PARAM_NAME_LEN);
+    table[i].type = type;
+    table[i].ptr  = ptr;
+    table[i].min  = min;
+    table[i].max  = max;
+    return 1;
+}
+
+// 要求をキューに積む
+int Param_request(uint8_t op, const tele_param_t *req)
+{
+    uint32_t h = head;
+
+    if(h - tail >= PARAM_QUEUE)
+        return 0;
+
+    queue[h & QUEUE_MASK].op = op;
+    if(req != NULL)
+        queue[h & QUEUE_MASK].param = *req;
+    head = h + 1;
+    return 1;
+}
+
+// 溜まった要求を処理する
+void Param_apply(void)
+{
+    param_req_t *req;
+    int i, changed = 0;
+
+    while(tail != head)
+    {
+        req = &queue[tail & QUEUE_MASK];
+
+        if(req->op == TELE_TYPE_PARAM_LIST)
+        {
+            for(i = 0; i < count; i++)
+                Param_pushAck(i, req->op, TELE_PARAM_OK, NULL);
+        }
+        else if((i = Param_find(req->param.name)) < 0)
+            Param_pushAck(-1, req->op, TELE_PARAM_UNKNOWN, req->param.name);
+        else if(req->op == TELE_TYPE_PARAM_SET)
+        {
+            if(req->param.value < table[i].min || req->param.value > table[i].max || isnan(req->param.value))
+                Param_pushAck(i, req->op, TELE_PARAM_RANGE, NULL);
+            else
+            {
+                Param_write(&table[i], req->param.value);
+                changed = 1;
+                Param_pushAck(i, req->op, TELE_PARAM_OK, NULL);
+            }
+        }
+        else
+            Param_pushAck(i, req->op, TELE_PARAM_OK, NULL);
+
+        tail++;
+    }
+
+    if(changed)
+        version++;
+}
+
+uint32_t Param_getVersion(void)
+{
+    return version;
+}
+
+// 応答を1つ取り出す
+int Param_popAck(tele_param_t *ack)
+{
+    uint32_t t = ack_tail;
+
+    if(t == ack_head)
+        return 0;
+    *ack = acks[t & ACK_MASK];
+    ack_tail = t + 1;
+    return 1;
+}
@@ -0,0 +1,42 @@
+#ifndef INCLUDED_Param_h_
+#define INCLUDED_Param_h_
+
+#include "ev3api.h"
+#include "Tele.h"
+
+// 実行中に調整するパラメータの表
+// 各区間は調整したい変数を名前を付けて登録し、Bluetooth(Tele.h)からの取得・変更要求は名前で指定する
+// 受信タスク(bt_task)は要求をキューに積むだけで、変数の書き換えは制御周期の境目(Clock_wait)にメインタスク上でまとめて行う
+// (区間のループの処理中に値が変わることはなく、1周期の間に届いた複数の変更は同じ周期からまとめて反映される)
+// 応答は送信タスク(tele_task)が送る
+
+/* マクロ定義 */
+#define PARAM_MAX       16      // 登録できるパラメータ数
+#define PARAM_QUEUE     8       // 未処理の要求を溜められる数(2のべき乗にすること)
+#define PARAM_ACK_QUEUE 32      // 未送信の応答を溜められる数(2のべき乗、PARAM_MAX以上にすること)
+
+/* 変数の型 */
+typedef enum {
+    PARAM_FLOAT,
+    PARAM_INT8,
+    PARAM_INT16
+} param_type_t;
+
+/* 関数プロトタイプ宣言 */
+
+// 変数を登録(同じ名前を再度登録した場合は置き換える。表が満杯の場合は0を返す)
+int      Param_add(const char *name, param_type_t type, void *ptr, float min, float max);
+
+// 受信タスク：要求(TELE_TYPE_PARAM_*)をキューに積む(満杯の場合は破棄して0を返す。ホスト側で再送する)
+int      Param_request(uint8_t op, const tele_param_t *req);
+
+// メインタスク：溜まった要求を処理し、応答をキューに積む(制御周期の境目に呼ぶ)
+void     Param_apply(void);
+
+// 値を変更した回数(区間のループはこれが変わったときにPIDゲインなどを設定し直す)
+uint32_t Param_getVersion(void);
+
+// 送信タスク：応答を1つ取り出す(無い場合は0を返す)
+int      Param_popAck(tele_param_t *ack);
+
+#endif
@@ -0,0 +1,125 @@
+#include "Pid.h"
+
+/* マクロ定義 */
+#define INTEGRAL_MAX    (30000L << PID_Q)   // 積分値の上限(int32_tの範囲に収めるため)
+#define TERM_MAX        (4000LL << PID_Q)   // P, I, D各項の上限(3項の和がint32_tの範囲に収まるようにする)
+
+/* 関数 */
+
+// 値を範囲内に制限
+static int32_t Pid_limit(int32_t n, int32_t min, int32_t max)
+{
+    if(n > max)
+        n = max;
+    else if(n < min)
+        n = min;
+    return n;
+}
+
+// 64bitの演算結果を各項の上限に制限
+static int32_t Pid_term(int64_t n)
+{
+    if(n > TERM_MAX)
+        n = TERM_MAX;
+    else if(n < -TERM_MAX)
+        n = -TERM_MAX;
+    return (int32_t)n;
+}
+
+// 初期化
+void Pid_init(pid_ctrl_t *pid, float kp, float ki, float kd)
+{
+    Pid_setGains(pid, kp, ki, kd);
+    Pid_setDt(pid, PID_DT);
+    Pid_setFilter(pid, PID_DT / (PID_D_TAU + PID_DT));
+    Pid_setIntegralLimit(pid, PID_OUT_LIMIT);
+    pid->out_limit = PID_OUT_LIMIT;
+    Pid_reset(pid);
+}
+
+// 状態のみを初期化
+void Pid_reset(pid_ctrl_t *pid)
+{
+    pid->pre_diff = 0;
+    pid->integral = 0;
+    pid->deriv = 0;
+    pid->first = true;
+}
+
+// ゲインを設定
+void Pid_setGains(pid_ctrl_t *pid, float kp, float ki, float kd)
+{
+    pid->kp = PID_FIX(kp);
+    pid->ki = PID_FIX(ki);
+    pid->kd = PID_FIX(kd);
+}
+
+// 処理周期を設定
+void Pid_setDt(pid_ctrl_t *pid, float dt)
+{
+    pid->dt = PID_FIX(dt);
+    pid->inv_dt = PID_FIX(1.0 / dt);
+}
+
+// 微分フィルタ係数を設定(1次のローパスフィルタ : deriv += alpha * (今回の微分 - deriv))
+void Pid_setFilter(pid_ctrl_t *pid, float alpha)
+{
+    pid->d_alpha = Pid_limit(PID_FIX(alpha), 1, PID_ONE);
+}
+
+// 積分項の上限を設定
+void Pid_setIntegralLimit(pid_ctrl_t *pid, int16_t limit)
+{
+    pid->i_limit = (int32_t)limit << PID_Q;
+}
+
+// PID制御
+// 参考：https://monoist.atmarkit.co.jp/mn/articles/1007/26/news083.html
+int16_t Pid_update(pid_ctrl_t *pid, int32_t sensor_val, int32_t target_val)
+{
+    int32_t diff = sensor_val - target_val;     // 偏差を取得
+    int32_t pre_integral = pid->integral;
+    int32_t deriv;
+    int32_t p, i, d, out;
+    uint32_t now = Clock_getTicks();
+    uint32_t ticks = now - pid->pre_tick;       // 前回の呼び出しからの経過周期数
+    int32_t dt = pid->dt;
+    int32_t inv_dt = pid->inv_dt;
+
+    pid->pre_tick = now;
+    if(pid->first)                              // 初回は前回の偏差がないため、微分が跳ねないように今回の偏差を使う
+    {
+        pid->pre_diff = diff;
+        pid->first = false;
+    }
+    else if(ticks > 1)                          // ループが周期に間に合わなかった場合は経過した周期数に合わせる
+    {                                           // (0の場合は同じ周期に2回呼ばれたか周期ハンドラが停止しているため、1周期とみなす)
+        if(ticks > PID_TICKS_MAX)
+            ticks = PID_TICKS_MAX;
+        dt = dt * ticks;
+        inv_dt = inv_dt / ticks;
+    }
+
+    // 積分(台形近似) : (今回の偏差 + 前回の偏差) / 2 * dt
+    pid->integral = Pid_limit(pid->integral + (((diff + pid->pre_diff) * dt) >> 1), -INTEGRAL_MAX, INTEGRAL_MAX);
+
+    // 微分 : (今回の偏差 - 前回の偏差) / dt をローパスフィルタに通す(Q8)
+    deriv = (int32_t)(((int64_t)(diff - pid->pre_diff) * inv_dt) >> (PID_Q - 8));
+    pid->deriv += (int32_t)(((int64_t)(deriv - pid->deriv) * pid->d_alpha) >> PID_Q);
+
+    pid->pre_diff = diff;
+
+    p = Pid_term((int64_t)pid->kp * diff);                          // Q16.16
+    i = Pid_term(((int64_t)pid->ki * pid->integral) >> PID_Q);      // Q16.16
+    d = Pid_term(((int64_t)pid->kd * pid->deriv) >> 8);             // Q16.16
+
+    if(i > pid->i_limit || i < -pid->i_limit)   // 積分項が上限を超えた場合(アンチワインドアップ)
+    {
+        pid->integral = pre_integral;               // 今回の積分を取り消して
+        i = Pid_limit(i, -pid->i_limit, pid->i_limit);  // 上限に制限する
+    }
+
+    out = (p + i + d + (PID_ONE >> 1)) >> PID_Q;    // 四捨五入して整数に戻す
+
+    return Pid_limit(out, -pid->out_limit, pid->out_limit);     // 最大・最小値を制限した値を返す
+}
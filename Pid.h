@@ -0,0 +1,58 @@
+#ifndef INCLUDED_Pid_h_
+#define INCLUDED_Pid_h_
+
+#include "ev3api.h"
+#include "Clock.h"
+
+// 固定小数点(Q16.16)のPID制御器
+// 各区間がpid_ctrl_tを1つずつ持ち、区間ごとにゲインや状態を独立して扱えるようにする
+// 実機(EV3)はFPUを持たずfloatの演算がソフトウェア処理となるため、制御周期中の演算は整数のみで行う
+// 前回の呼び出しからの経過時間は周期ハンドラの起動回数(Clock_getTicks)で測り、ループが周期に間に合わなかった場合も微分・積分の時間を合わせる
+
+/* マクロ定義 */
+#define PID_Q           16                  // 小数部のビット数
+#define PID_ONE         (1L << PID_Q)       // 1.0 (Q16.16)
+#define PID_FIX(x)      ((int32_t)((x) * PID_ONE + ((x) >= 0 ? 0.5 : -0.5)))  // 実数をQ16.16に変換(定数・設定時のみ使用)
+
+#define PID_DT          CLOCK_DT    // 処理周期の初期値[s](制御周期)
+#define PID_TICKS_MAX   CLOCK_TICKS(100)    // 経過時間として扱う周期数の上限(これより長く空いた場合は100msとみなす)
+#define PID_D_TAU       0.005   // 微分のローパスフィルタの時定数の初期値[s](毎周期の微分で出力が振動しないようにする)
+#define PID_OUT_LIMIT   200     // 出力の最大値(Ctrl_motor_steer関数のturn値の範囲)
+
+/* PID制御器 */
+typedef struct {
+    int32_t kp;             // 比例ゲイン(Q16.16)
+    int32_t ki;             // 積分ゲイン(Q16.16)
+    int32_t kd;             // 微分ゲイン(Q16.16)
+    int32_t dt;             // 処理周期(1周期分)[s](Q16.16)
+    int32_t inv_dt;         // 処理周期の逆数[1/s](Q16.16)
+    int32_t d_alpha;        // 微分のローパスフィルタ係数(Q16.16, PID_ONEでフィルタなし)
+    int32_t i_limit;        // 積分項の上限(出力の単位, Q16.16)
+    int32_t out_limit;      // 出力の上限
+
+    int32_t pre_diff;       // 前回の偏差
+    int32_t integral;       // 偏差の積分[偏差*s](Q16.16)
+    int32_t deriv;          // フィルタ後の偏差の微分[偏差/s](Q8)
+    bool_t  first;          // 初回の呼び出しかどうか(初回は微分を0とする)
+    uint32_t pre_tick;      // 前回の呼び出し時の周期ハンドラの起動回数
+} pid_ctrl_t;
+
+/* 関数プロトタイプ宣言 */
+
+// 初期化(ゲインを設定し、処理周期・フィルタ・上限を初期値にする *フィルタの係数は時定数PID_D_TAUから求める)
+void    Pid_init(pid_ctrl_t *pid, float kp, float ki, float kd);
+
+// 状態(偏差・積分・微分)のみを初期化
+void    Pid_reset(pid_ctrl_t *pid);
+
+// 実行中に設定を変更する関数
+void    Pid_setGains(pid_ctrl_t *pid, float kp, float ki, float kd);
+void    Pid_setDt(pid_ctrl_t *pid, float dt);               // 処理周期(1周期分)[s]
+void    Pid_setFilter(pid_ctrl_t *pid, float alpha);        // 微分フィルタ係数(0 < alpha <= 1.0, 小さいほど強くかかる)
+void    Pid_setIntegralLimit(pid_ctrl_t *pid, int16_t limit);   // 積分項の上限(アンチワインドアップ)
+
+// PID制御(定数) * (センサー入力値 - 目標値)
+// 戻り値 : Ctrl_motor_steer関数のturn値(-200 ~ +200)
+int16_t Pid_update(pid_ctrl_t *pid, int32_t sensor_val, int32_t target_val);
+
+#endif
@@ -0,0 +1,131 @@
+#include <string.h>
+#include "Prof.h"
+
+/* マクロ定義 */
+#define BIN_US      50      // ヒストグラムの1区間の幅[us]
+#define BIN_NUM     200     // ヒストグラムの区間数(BIN_US * BIN_NUM = 10ms以上は最後の区間に入る)
+
+/* グローバル宣言 */
+typedef struct {            // 1種類の計測値の統計
+    uint32_t    count;
+    uint32_t    min;
+    uint32_t    max;
+    uint64_t    sum;
+    uint32_t    bin[BIN_NUM];
+} prof_hist_t;
+
+typedef struct {            // 計測箇所ごとのデータ
+    HRTCNT      enter;          // 今回の入口の時刻
+    HRTCNT      pre_enter;      // 前回の入口の時刻
+    bool_t      entered;        // 入口を通過したかどうか
+    prof_hist_t exec;           // 処理時間
+    prof_hist_t period;         // 起動周期
+} prof_site_t;
+
+static prof_site_t site[TNUM_PROF];
+
+static const char *site_name[TNUM_PROF] = {
+    "datalog_cyc",
+    "Run_update",
+    "Linetrace",
+    "Slalom",
+    "Block"
+};
+
+/* 関数 */
+
+// ヒストグラムに1つ値を追加
+static void Prof_add(prof_hist_t *hist, uint32_t us)
+{
+    uint32_t i = us / BIN_US;
+
+    if(i >= BIN_NUM)
+        i = BIN_NUM - 1;
+    hist->bin[i]++;
+
+    if(hist->count == 0 || us < hist->min)
+        hist->min = us;
+    if(us > hist->max)
+        hist->max = us;
+    hist->sum += us;
+    hist->count++;
+}
+
+// ヒストグラムからパーセンタイル値を求める(区間の上端を返す)
+static uint32_t Prof_percentile(const prof_hist_t *hist, uint32_t percent)
+{
+    uint32_t target = (hist->count * percent + 99) / 100;
+    uint32_t total = 0;
+    uint32_t i;
+
+    for(i = 0; i < BIN_NUM; i++)
+    {
+        total += hist->bin[i];
+        if(total >= target)
+            break;
+    }
+    if(i >= BIN_NUM - 1 || (i + 1) * BIN_US > hist->max)   // 区間の上端が最大値を超える場合は最大値を返す
+        return hist->max;
+    if((i + 1) * BIN_US < hist->min)
+        return hist->min;
+    return (i + 1) * BIN_US;
+}
+
+// 1種類の計測値を出力
+static void Prof_print(FILE *fp, const char *name, const char *kind, const prof_hist_t *hist)
+{
+    if(hist->count == 0)
+        return;
+
+    fprintf(fp, "%-12s%-8s%8lu%8lu%8lu%8lu%8lu%8lu%8lu\n",
+        name, kind,
+        (unsigned long)hist->count,
+        (unsigned long)hist->min,
+        (unsigned long)(hist->sum / hist->count),
+        (unsigned long)Prof_percentile(hist, 50),
+        (unsigned long)Prof_percentile(hist, 90),
+        (unsigned long)Prof_percentile(hist, 99),
+        (unsigned long)hist->max);
+}
+
+// 計測値をすべて初期化
+void Prof_init(void)
+{
+    memset(site, 0, sizeof(site));
+}
+
+// 計測箇所の入口
+void Prof_enter(prof_id_t id)
+{
+    prof_site_t *s = &site[id];
+    HRTCNT now = fch_hrt();
+
+    if(s->entered)
+        Prof_add(&s->period, now - s->pre_enter);   // 前回の入口からの経過時間を起動周期として記録
+
+    s->pre_enter = now;
+    s->enter = now;
+    s->entered = true;
+}
+
+// 計測箇所の出口
+void Prof_exit(prof_id_t id)
+{
+    prof_site_t *s = &site[id];
+
+    if(s->entered)
+        Prof_add(&s->exec, fch_hrt() - s->enter);
+}
+
+// 計測結果を出力(単位はus。パーセンタイル値はBIN_US単位)
+void Prof_dump(FILE *fp)
+{
+    int i;
+
+    fprintf(fp, "%-12s%-8s%8s%8s%8s%8s%8s%8s%8s\n", "site", "kind", "count", "min", "avg", "p50", "p90", "p99", "max");
+    for(i = 0; i < TNUM_PROF; i++)
+    {
+        Prof_print(fp, site_name[i], "exec", &site[i].exec);
+        Prof_print(fp, site_name[i], "period", &site[i].period);
+    }
+}
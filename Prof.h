@@ -0,0 +1,26 @@
+#ifndef INCLUDED_Prof_h_
+#define INCLUDED_Prof_h_
+
+#include "ev3api.h"
+
+// 処理時間の計測用モジュール
+// 計測箇所ごとに、処理時間(入口～出口)と起動周期(前回の入口～今回の入口)をヒストグラムに記録し、
+// 最小・最大・パーセンタイル値を出力する。時刻は高分解能タイマ(fch_hrt, 1us単位)を使用
+
+/* 計測箇所 */
+typedef enum {
+    PROF_DATALOG,       // datalog_cyc全体
+    PROF_RUN_UPDATE,    // Run_update
+    PROF_LINETRACE,     // section_Linetraceの1周期
+    PROF_SLALOM,        // section_Slalomの1周期
+    PROF_BLOCK,         // section_Blockの1周期
+    TNUM_PROF
+} prof_id_t;
+
+/* 関数プロトタイプ宣言 */
+void Prof_init(void);               // 計測値をすべて初期化
+void Prof_enter(prof_id_t id);      // 計測箇所の入口で呼ぶ
+void Prof_exit(prof_id_t id);       // 計測箇所の出口で呼ぶ
+void Prof_dump(FILE *fp);           // 計測結果を出力
+
+#endif
@@ -0,0 +1,117 @@
+#include <math.h>
+#include "Profile.h"
+
+/* 関数 */
+
+// 値を範囲内に収める
+static float Profile_limit(float n, float min, float max)
+{
+    if(n < min) return min;
+    if(n > max) return max;
+    return n;
+}
+
+// 残りの距離remainingで終端速度まで減速できる最高速度(減速の包絡線)
+// 躍度の上限がある場合の停止距離 d = (v^2 - v_end^2) / 2A + v * A / 2J をvについて解く
+static float Profile_envelope(const profile_t *p, float remaining)
+{
+    float c, b;
+
+    if(remaining <= 0)
+        return p->v_end;
+
+    c = 2.0 * p->accel * remaining + p->v_end * p->v_end;
+    if(p->jerk <= 0)                            // 台形
+        return sqrtf(c);
+
+    b = p->accel * p->accel / p->jerk;          // S字 : v^2 + b * v - c = 0
+    return (sqrtf(b * b + 4.0 * c) - b) / 2.0;
+}
+
+// 初期化
+void Profile_init(profile_t *p, float distance, float v_max, float v_end, float accel, float jerk)
+{
+    p->distance = distance;
+    p->v_max    = v_max;
+    p->v_end    = (v_end < v_max) ? v_end : v_max;
+    p->accel    = accel;
+    p->jerk     = jerk;
+    p->v        = 0.0;
+    p->a        = 0.0;
+}
+
+// 初速を設定
+void Profile_start(profile_t *p, float v0)
+{
+    p->v = (v0 > 0) ? v0 : 0.0;
+    p->a = 0.0;
+}
+
+// 現在位置から最短距離で停止するように移動距離を変更
+void Profile_stop(profile_t *p, float traveled)
+{
+    float brake = p->v * p->v / (2.0 * p->accel);   // 減速度の上限で停止するまでの距離
+
+    if(p->jerk > 0)
+        brake += p->v * p->accel / (2.0 * p->jerk);     // 減速度の立ち上がりの分
+    p->distance = traveled + brake;
+    p->v_end = 0.0;
+}
+
+// 1周期分進めて速度指令を返す
+float Profile_update(profile_t *p, float traveled, float dt)
+{
+    float target, err, limit, a_want, da;
+
+    if(dt <= 0)
+        return p->v;
+
+    // 目標速度 = 最高速度と減速の包絡線の小さい方
+    target = Profile_envelope(p, p->distance - traveled);
+    if(target > p->v_max)
+        target = p->v_max;
+
+    err = target - p->v;
+    if(p->jerk <= 0)                            // 台形 : 加速度の上限まで使って目標速度に合わせる
+    {
+        p->a = Profile_limit(err / dt, -p->accel, p->accel);
+    }
+    else                                        // S字 : 目標速度で加速度が0になるよう、残りの速度差に応じて加速度を絞る
+    {
+        limit = sqrtf(2.0 * p->jerk * fabsf(err));
+        if(limit > p->accel)
+            limit = p->accel;
+        a_want = Profile_limit(err / dt, -limit, limit);
+        da = p->jerk * dt;
+        p->a += Profile_limit(a_want - p->a, -da, da);
+    }
+
+    p->v += p->a * dt;
+    if(p->v > p->v_max)
+        p->v = p->v_max;
+    if(p->v < 0)
+        p->v = 0.0;
+    return p->v;
+}
+
+// 移動距離に到達したかどうか
+bool_t Profile_isDone(const profile_t *p, float traveled)
+{
+    return traveled >= p->distance;
+}
+
+// 速度をモーター出力に換算
+int8_t Profile_toPower(float v)
+{
+    float power = v / PROFILE_MM_PER_POWER;
+
+    if(power > 100)
+        power = 100;
+    return (int8_t)(power + 0.5);
+}
+
+// モーター出力を速度に換算
+float Profile_fromPower(int8_t power)
+{
+    return power * PROFILE_MM_PER_POWER;
+}
@@ -0,0 +1,50 @@
+#ifndef INCLUDED_Profile_h_
+#define INCLUDED_Profile_h_
+
+#include "ev3api.h"
+
+// 速度プロファイル(台形・S字)の生成器
+// 移動距離・最高速度・加速度・躍度の上限から、1周期ごとの速度指令を作る
+// 減速は残りの距離から求める(実際に進んだ距離で判断するため、呼び出し周期がずれても目標で止まる)
+// 加減速の時間は呼び出し側が渡す経過時間dtで決まり、呼び出し回数には依存しない
+// *速度[mm/s]とモーター出力の換算はPROFILE_MM_PER_POWERで行う(無負荷時の値のため、実機に合わせて調整すること)
+
+/* マクロ定義 */
+#define PROFILE_MM_PER_POWER    7.85        // モーター出力1あたりの走行速度[mm/s](出力100で約900deg/s、タイヤ直径100mm)
+#define PROFILE_ACCEL           1000.0      // 加速度の上限の初期値[mm/s^2](出力100まで約0.8秒)
+#define PROFILE_JERK            10000.0     // 躍度の上限の初期値[mm/s^3](加速度の立ち上がり0.1秒)
+#define PROFILE_UNLIMITED       1.0e9       // 距離の制限なし(Profile_stopで止めるまで走行)
+
+/* 速度プロファイル */
+typedef struct {
+    float   distance;   // 移動距離[mm]
+    float   v_max;      // 最高速度[mm/s]
+    float   v_end;      // 終端速度[mm/s]
+    float   accel;      // 加速度の上限[mm/s^2]
+    float   jerk;       // 躍度の上限[mm/s^3](0で台形)
+    float   v;          // 現在の速度指令[mm/s]
+    float   a;          // 現在の加速度指令[mm/s^2]
+} profile_t;
+
+/* 関数プロトタイプ宣言 */
+
+// 初期化(速度・加速度の指令は0から始まる。途中から始める場合はProfile_startで初速を与える)
+void    Profile_init(profile_t *p, float distance, float v_max, float v_end, float accel, float jerk);
+
+// 初速[mm/s]を設定
+void    Profile_start(profile_t *p, float v0);
+
+// 現在位置から最短距離で停止するように移動距離を変更(障害物検知時など)
+void    Profile_stop(profile_t *p, float traveled);
+
+// 1周期分進めて速度指令[mm/s]を返す(traveled : 開始からの移動距離[mm], dt : 前回の呼び出しからの経過時間[s])
+float   Profile_update(profile_t *p, float traveled, float dt);
+
+// 移動距離に到達したかどうか
+bool_t  Profile_isDone(const profile_t *p, float traveled);
+
+// 速度[mm/s]とモーター出力の換算
+int8_t  Profile_toPower(float v);
+float   Profile_fromPower(int8_t power);
+
+#endif
@@ -1,73 +1,252 @@
 #include "Run.h"
+#include "Prof.h"
+#include "Color.h"
+#include "Line.h"
+#include "Sonar.h"
+#include "Motor.h"
 
 /* マクロ定義 */
 #define PI 3.14159265358    // 円周率
 #define TREAD 145.0         //車体トレッド幅(約140.0mm *ETロボコンシミュレータの取扱説明書参照) -> (150.0mm *2020年ADVクラスのDENSOチームのモデル図に記載)
 #define TIRE_DIAMETER 100.0 //タイヤ直径(約90mm *ETロボコンシミュレータの取扱説明書参照) -> (90.0mm *2020年ADVクラスのDENSOチームのモデル図に記載)
+#define TIME_MAX    CLOCK_TICKS(240 * 1000)         // 走行時間の上限(240秒)
+#define SPEED_TICKS CLOCK_TICKS(100)                // 走行速度を求める間隔(100ms)
+#define MM_PER_COUNT  ((PI * TIRE_DIAMETER) / 360.0)    // モーター角度1度あたりの走行距離[mm]
+#define DEG_PER_COUNT (TIRE_DIAMETER / (2.0 * TREAD))   // 左右のモーター角度の差1度あたりの方位の変化[deg]
+#define RAD_PER_COUNT (DEG_PER_COUNT * PI / 180.0)      // 同上[rad]
+#define CURV_WINDOW      50.0   // 曲率を平滑化する走行距離[mm]
+#define CURV_MAX         (2.0 / TREAD)  // 曲率の上限(片輪を軸にした旋回)[1/mm]
+#define CURV_GYRO_WEIGHT 0.0    // 曲率の旋回量にジャイロセンサーの角度変化を使う割合(0～1 *実機で符号を確認してから設定する)
+#define GYRO_JUMP        45     // ジャイロセンサーの前回読み出してからの角度変化がこれを超えた場合はリセットとみなして使わない[deg]
+#define DIR_GYRO_FUSION  0      // 方位にジャイロセンサーを組み合わせるかどうか(0 : モーター角度のみで求める)
+                                // *この走行体のジャイロセンサーは傾き(ピッチ)を測る向きに取り付けており、Run_getAngleはスラローム区間の傾きの判定に使う
+                                //  旋回(鉛直軸まわり)を測る向きに付け替えて傾きの判定を別の手段に移すまでは0にしておくこと
+#define DIR_GYRO_SIGN    1      // ジャイロセンサーの角度の向き(EV3のジャイロセンサーは上から見て右回転で増える)
+#define DIR_FUSE_TAU     0.05   // 方位をジャイロセンサーから求めた方位に寄せる時定数[s](短いほど滑りの誤差が早く消える)
+#define DIR_BIAS_TAU     10.0   // 走行中にジャイロセンサーのバイアス(零点のずれ)を推定する時定数[s](緩やかな滑りをバイアスとみなさないよう長くする)
+#define DIR_BIAS_TAU_STOP 1.0   // 停止中(車輪が回っていない間)にバイアスを推定する時定数[s]
+#define DIR_BIAS_WINDOW  0.5    // バイアスを求める区間の長さ[s](ジャイロセンサーの1度単位の誤差を均す)
+#define DIR_BIAS_RATE    5.0    // モーター角度から求めた旋回速度がこれ未満の間(直進・停止中)のみバイアスを推定する[deg/s]
+#define DIR_BIAS_MAX     5.0    // バイアスとみなす差の上限[deg/s](これを超える区間は滑りとみなして使わない)
+
+// 計測元ごとの読み出し周期[ms]と位相[周期]
+// センサーの値が更新される間隔より短く読んでも同じ値が返るだけのため、計測元ごとに更新間隔に合わせて読む
+// 周期の長い計測元は位相をずらし、同じ周期に読み出しが重ならないようにする(1周期の処理時間を平らにする)
+#define COLOR_PERIOD_MS     5                   // カラーセンサー(RGB値)
+#define GYRO_PERIOD_MS      10                  // ジャイロセンサー(方位の補正・傾きの検知)
+                                                // 超音波センサーはSONAR_PERIOD_MS(Sonar.h)
+#define MOTOR_PERIOD_MS     CLOCK_PERIOD_MS     // モーター出力(Motor.cのキャッシュを読むだけ)
+#define ENCODER_PERIOD_MS   CLOCK_PERIOD_MS     // モーター角度(走行距離・方位・位置・曲率 *毎周期)
+#define COLOR_PHASE         0
+#define GYRO_PHASE          1
+#define SONAR_PHASE         2
+#define MOTOR_PHASE         0
+#define ENCODER_PHASE       0
+
+#define BARRIER() __asm__ volatile("" ::: "memory")  // コンパイラによる読み書きの順序の入れ替えを防ぐ
+#define PUB (pub[pub_seq & 1])                      // 最新の公開データ
 
 /* グローバル宣言 */
-typedef struct running_data{    // 走行データ用の構造体
-    rgb_raw_t   rgb;
-    int8_t      power_L;
-    int8_t      power_R;
-    int8_t      power;
-    int16_t     turn;
-    int16_t     angle;
-    float       speed; 
-    float       distance;
-    float       direction;
-    SYSTIM      cycle_time;
-    uint32_t    time;
-}run_data_t;
-
-static run_data_t run;
+// 周期ハンドラはrunを更新し終えてから、公開用の2面のバッファのうち読まれていない方へ書き込んで番号を進める
+// 読み出し側(メインタスク)は番号が示す面を読むため、読み出しの途中で周期ハンドラが割り込んでも値が混ざらない
+static run_data_t run;                  // 周期ハンドラが更新する作業用の走行データ
+static run_data_t pub[2];               // 公開用の走行データ(pub[pub_seq & 1]が最新)
+static volatile uint32_t pub_seq = 0;   // 公開した回数
+static volatile bool_t init_req = false;    // 初期化要求(周期ハンドラで処理する)
+static volatile bool_t pose_req = false;    // 位置の設定要求(周期ハンドラで処理する)
+static run_pose_t pose_next;                // 設定する位置
+static volatile uint8_t gyro_reset_req = 0; // ジャイロセンサーのリセット要求(リセットの前後2回の読み出しを対応させ直す)
+static bool_t gyro_rebase = false;          // この周期に読み出したジャイロセンサーの角度を、前回の値と比べずに基準とし直すかどうか
+
+static void Run_initCounts(void);
+static void Run_initPose(const run_pose_t *pose);
+static void Run_updateOdometry(void);
+
+// 計測元の一覧(周期[ms], 位相[周期], 読み出して作業用の走行データを更新する関数)
+// Run.hのrun_src_tと同じ順に並べる *この順に読み出すため、他の計測元の値を使う計測元は後に置く
+#define RUN_SOURCES(X) \
+    X(COLOR_PERIOD_MS,   COLOR_PHASE,   Run_updateColor) \
+    X(GYRO_PERIOD_MS,    GYRO_PHASE,    Run_updateGyro) \
+    X(SONAR_PERIOD_MS,   SONAR_PHASE,   Run_updateSonar) \
+    X(MOTOR_PERIOD_MS,   MOTOR_PHASE,   Run_updateMotor) \
+    X(ENCODER_PERIOD_MS, ENCODER_PHASE, Run_updateOdometry)
+
+#define SOURCE_PERIOD(ms, phase, update)    CLOCK_TICKS(ms),
+#define SOURCE_PHASE(ms, phase, update)     (phase) % CLOCK_TICKS(ms),
+#define SOURCE_UPDATE(ms, phase, update)    update,
+
+static const uint16_t src_period[TNUM_RUN_SRC] = { RUN_SOURCES(SOURCE_PERIOD) };   // 読み出し周期[周期]
+static void (*const src_update[TNUM_RUN_SRC])(void) = { RUN_SOURCES(SOURCE_UPDATE) };
+static uint16_t src_countdown[TNUM_RUN_SRC] = { RUN_SOURCES(SOURCE_PHASE) };     // 次に読み出すまでの周期数(0の周期に読み出す)
 
 /* 関数 */
 
-// 走行データの初期化(累積する値のみ)
-void Run_init(void)
+// 作業用の走行データを公開する(周期ハンドラのみが呼ぶ)
+static void Run_publish(void)
+{
+    pub[(pub_seq + 1) & 1] = run;   // 読まれていない方の面に書き込んでから
+    BARRIER();
+    pub_seq = pub_seq + 1;          // 番号を進めて公開する
+}
+
+// 周期ハンドラに処理を依頼して完了を待つ(周期ハンドラ2回分まで待機し、処理されなかった場合は偽を返す)
+static bool_t Run_request(volatile bool_t *req)
+{
+    int i;
+
+    *req = true;
+    for(i = 0; i < 10 && *req; i++)
+        tslp_tsk(1 * 1000U);
+    return !*req;
+}
+
+// 累積する値の初期化
+static void Run_reset(void)
 {
     run.time = 0;
     Run_initDistance();
     Run_initDirection();
 }
 
+// 走行データの初期化(累積する値のみ)
+// 周期ハンドラの更新と競合しないよう、初期化は周期ハンドラに依頼して完了を待つ(周期ハンドラが停止している場合は直接行う)
+// *位置(Run_getPose)は初期化しない。周期ハンドラの起動前(走行開始前)に呼んだ場合のみ原点に戻す
+void Run_init(void)
+{
+    static const run_pose_t origin = { 0.0, 0.0, 0.0 };
+
+    if(!Run_request(&init_req))             // 周期ハンドラが動いていない場合
+    {
+        Run_initCounts();
+        Run_reset();
+        Run_initPose(&origin);
+        Run_publish();
+        init_req = false;
+    }
+}
+
 // データ更新
+// 計測元ごとに、周期・位相で決まる読み出しの周期だけセンサーを読み、読み出した周期の番号を記録する
+// 読み出さない周期は前回の値をそのまま公開する
 void Run_update(void)
 {
-    if(run.time < 480000) run.time++;                       // 走行時間を加算(5ms周期の場合、最大240秒まで) *ログに記録するときに周期を掛ける
-    ev3_color_sensor_get_rgb_raw(EV3_PORT_2, &run.rgb);   // RGB値を更新
-    run.angle = ev3_gyro_sensor_get_angle(EV3_PORT_4);     // 位置角(傾き)を更新
-    Run_updateMotor();          // モーター出力値を更新
-    Run_updateDistance();       // 走行距離を更新
-    Run_updateDirection();      // 走行方位を更新
-    Run_updateSpeed();          // 走行速度を更新
-    // Run_updateCycleTime();   // 更新周期を更新    
+    int i;
+
+    Prof_enter(PROF_RUN_UPDATE);
+
+    run.tick++;                                             // 更新の通し番号(初期化しない)
+    if(run.time < TIME_MAX) run.time++;                     // 走行時間を加算(制御周期の単位、最大240秒まで) *ログに記録するときに周期を掛ける
+    for(i = 0; i < TNUM_RUN_SRC; i++)
+    {
+        if(src_countdown[i] > 0)
+        {
+            src_countdown[i]--;
+            continue;
+        }
+        src_countdown[i] = src_period[i] - 1;
+        src_update[i]();
+        run.stamp[i] = run.tick;                            // 読み出した周期を記録
+    }
+    Run_updateSpeed();          // 走行速度を更新(走行時間に対する間隔で求める)
+
+    // 初期化要求はこの周期の移動量を積算してから処理する(モーター角度を読み直すと、前回からの移動量が失われるため)
+    if(init_req)                            // 初期化要求がある場合
+    {
+        Run_reset();
+        init_req = false;
+    }
+    if(pose_req)                            // 位置の設定要求がある場合
+    {
+        Run_initPose(&pose_next);
+        pose_req = false;
+    }
+
+    Run_publish();              // 更新した値を公開
+
+    Prof_exit(PROF_RUN_UPDATE);
+}
+
+// 同じ周期に計測した走行データの一式を取得(複数の値を組み合わせて判断する場合に使用)
+void Run_getSnapshot(run_data_t *data)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = pub_seq;
+        BARRIER();
+        *data = pub[seq & 1];
+        BARRIER();
+    }
+    while(pub_seq - seq >= 2);      // 読み出し中に同じ面が書き換えられた場合は読み直す
+}
+
+// 計測元の値を読み出してからの経過周期数を取得(0 : 最新の公開データの周期に読み出した値)
+uint32_t Run_getAge(run_src_t src)
+{
+    run_data_t data;
+
+    Run_getSnapshot(&data);
+    return data.tick - data.stamp[src];
 }
 
 // 走行データ取得用関数群
 //---------------------------------------------------------------------------------------------------------------------------------
-uint16_t    Run_getRGB_R(void)      { return run.rgb.r; }       // カラーセンサーのR値を取得
-uint16_t    Run_getRGB_G(void)      { return run.rgb.g; }       // カラーセンサーのG値を取得
-uint16_t    Run_getRGB_B(void)      { return run.rgb.b; }       // カラーセンサーのB値を取得
-uint32_t    Run_getTime(void)       { return run.time; }        // 走行時間を取得(5ms単位) <- 周期ハンドラによって5msごとに更新されるため
-int8_t      Run_getPower(void)      { return run.power; }       // モーター出力を取得
-int8_t      Run_getPower_L(void)    { return run.power_L; }     // Lモーター出力を取得
-int8_t      Run_getPower_R(void)    { return run.power_R; }     // Rモーター出力を取得
-int16_t     Run_getTurn(void)       { return run.turn; }        // 旋回値を取得
-int16_t     Run_getAngle(void)      { return run.angle; }       // 位置角(傾き)を取得
-float       Run_getDistance(void)   { return run.distance; }    // 走行距離を取得
-float       Run_getDirection(void)  { return run.direction; }   // 走行方位を取得(右回転が正転)
-float       Run_getSpeed(void)      { return run.speed; }       // 走行速度を取得(100ms毎の速度)
-// SYSTIM      Run_getCycleTime(void)  { return run.cycle_time }   // 指定された値の更新周期を取得
+uint16_t    Run_getRGB_R(void)      { return PUB.rgb.r; }       // カラーセンサーのR値を取得
+uint16_t    Run_getRGB_G(void)      { return PUB.rgb.g; }       // カラーセンサーのG値を取得
+uint16_t    Run_getRGB_B(void)      { return PUB.rgb.b; }       // カラーセンサーのB値を取得
+colorid_t   Run_getColor(color_set_t set) { return PUB.color[set]; }  // 組の判定条件で判定した色を取得(判定条件はColor.cを参照)
+int16_t     Run_getLineOffset(void) { return PUB.offset; }      // ラインのエッジからのずれ[0.1mm]を取得(白の側が正 *Line.hを参照)
+uint32_t    Run_getTime(void)       { return PUB.time; }        // 走行時間を取得(制御周期CLOCK_PERIOD_MSの単位) <- 周期ハンドラによって制御周期ごとに更新されるため
+int8_t      Run_getPower(void)      { return PUB.power; }       // モーター出力を取得
+int8_t      Run_getPower_L(void)    { return PUB.power_L; }     // Lモーター出力を取得
+int8_t      Run_getPower_R(void)    { return PUB.power_R; }     // Rモーター出力を取得
+int16_t     Run_getTurn(void)       { return PUB.turn; }        // 旋回値を取得
+int16_t     Run_getAngle(void)      { return PUB.angle; }       // 位置角(傾き)を取得
+int16_t     Run_getSonar(void)      { return PUB.sonar; }       // 平滑化した超音波センサーの距離[cm]を取得
+uint8_t     Run_getSonarConfidence(void) { return PUB.sonar_conf; } // 超音波センサーの値の信頼度[%]を取得
+int16_t     Run_getSonarRaw(void)   { return PUB.sonar_raw; }   // 超音波センサーの最新の測定値[cm]を取得(壁などで停止する閾値の判定用)
+float       Run_getDistance(void)   { return PUB.distance; }    // 走行距離を取得
+float       Run_getDirection(void)  { return PUB.direction; }   // 走行方位を取得(右回転が正転 *DIR_GYRO_FUSIONが1の場合はジャイロセンサーと組み合わせた値)
+float       Run_getDirectionOdometry(void) { return PUB.direction_odo; }    // モーター角度のみから求めた走行方位を取得(比較用)
+float       Run_getSpeed(void)      { return PUB.speed; }       // 走行速度を取得(100ms毎の速度)
+float       Run_getCurvature(void)  { return PUB.curvature; }   // 走行経路の曲率[1/mm]を取得(右旋回が正)
 
 // 計測値更新用の関数群
 //---------------------------------------------------------------------------------------------------------------------------------
+/* カラーセンサー計測関数(RGB値を読み、色とラインのエッジからのずれを求める) */
+void Run_updateColor(void)
+{
+    int i;
+
+    ev3_color_sensor_get_rgb_raw(EV3_PORT_2, &run.rgb);
+    for(i = 0; i < TNUM_COLOR_SET; i++)
+        run.color[i] = Color_classify((color_set_t)i, &run.rgb);
+    run.offset = Line_getOffset(&run.rgb);
+}
+
+/* ジャイロセンサー計測関数(位置角(傾き)) */
+void Run_updateGyro(void)
+{
+    run.angle = ev3_gyro_sensor_get_angle(EV3_PORT_4);
+    gyro_rebase = (gyro_reset_req > 0);
+    if(gyro_rebase)
+        gyro_reset_req--;
+}
+
+/* ジャイロセンサーをリセット(リセットが読み出しの途中に重なっても良いよう、前後2回の読み出しを基準とし直す) */
+void Run_resetGyro(void)
+{
+    gyro_reset_req = 2;
+    ev3_gyro_sensor_reset(EV3_PORT_4);
+    gyro_reset_req = 2;
+}
+
 /* モーター出力計測関数 */
 void Run_updateMotor(void)
 {
-    run.power_L = ev3_motor_get_power(EV3_PORT_C);      // 右モーターの出力値を更新
-    run.power_R = ev3_motor_get_power(EV3_PORT_B);     // 左モーターの出力値を更新
+    run.power_L = Motor_getPower(EV3_PORT_C);           // 右モーターの出力値を更新
+    run.power_R = Motor_getPower(EV3_PORT_B);          // 左モーターの出力値を更新
     if(run.power_L == run.power_R)                      // 直進時のモーター出力と旋回量を更新
     {
         run.power = run.power_L;
@@ -85,44 +264,58 @@ void Run_updateMotor(void)
     }
 }
 
+/* 超音波センサー計測関数(センサーの測定周期ごとに1回だけ読み、フィルタに通す) */
+void Run_updateSonar(void)
+{
+    Sonar_sample(ev3_ultrasonic_sensor_get_distance(EV3_PORT_3));
+    run.sonar = Sonar_getDistance();
+    run.sonar_raw = Sonar_getLatest();
+    run.sonar_conf = Sonar_getConfidence();
+}
+
+/* モーター角度から求める値の計測関数(走行距離を先に更新し、その移動量から方位・位置・曲率を求める) */
+static void Run_updateOdometry(void)
+{
+    Run_updateDistance();       // 走行距離を更新
+    Run_updateDirection();      // 走行方位を更新
+    Run_updatePose();           // 位置を更新
+    Run_updateCurvature();      // 走行経路の曲率を更新
+}
+
 /* 速度計測関数(100ms毎の速度) */
 void Run_updateSpeed(void)
 {
     static uint32_t pre_time = 0;
     static float pre_distance = 0.0;
     
-    if((Run_getTime() - pre_time) >= 20)
-    {
-        run.speed = (Run_getDistance() - (float)pre_distance);
-        pre_time = Run_getTime();
-        pre_distance = Run_getDistance();
-    }
-}
-
-/* 指定された値の更新周期計測関数 */
-void Run_updateCycleTime(uint16_t cur_value)
-{
-    static SYSTIM pre_time = 0, cur_time = 0;
-    static uint32_t pre_value = 0;
-
-    if(pre_value != cur_value)
+    if((run.time - pre_time) >= SPEED_TICKS)
     {
-        pre_value = cur_value;
-        get_tim(&cur_time);
-        run.cycle_time = cur_time - pre_time;
-        get_tim(&pre_time);
+        run.speed = (run.distance - (float)pre_distance);
+        pre_time = run.time;
+        pre_distance = run.distance;
     }
 }
 
 // 距離計測用の関数群(引用：https://qiita.com/TetsuroAkagawa/items/ba6190f08d26df7cc8ad)
+// *モーターの回転角度は整数のまま積算し、距離・方位は積算値から毎回計算する(小数の足し込みによる誤差を溜めないため)
 //---------------------------------------------------------------------------------------------------------------------------------
 /* 距離計測用グローバル変数 */
 static float distance4msL = 0.0; //左タイヤの4ms間の距離
 static float distance4msR = 0.0; //右タイヤの4ms間の距離
-static float pre_angleL, pre_angleR; // 左右モータ回転角度の過去値
+static int32_t pre_countL, pre_countR;  // 左右モータ回転角度の過去値
+static int32_t angle4msL = 0;   //左タイヤの4ms間の角度
+static int32_t angle4msR = 0;   //右タイヤの4ms間の角度
+static int32_t sum_counts = 0;  // 距離の初期化以降の左右モータ回転角度の和
+static int32_t diff_counts = 0; // 方位の初期化以降の左右モータ回転角度の差(左 - 右)
 
-static float angle4msL = 0.0; //左タイヤの4ms間の角度
-static float angle4msR = 0.0; //右タイヤの4ms間の角度
+/* モータ角度の過去値に現在値を代入(周期ハンドラが動いていないときのみ呼ぶ *動作中に呼ぶとその周期の移動量が失われる) */
+static void Run_initCounts(void)
+{
+    pre_countL = ev3_motor_get_counts(EV3_PORT_C);
+    pre_countR = ev3_motor_get_counts(EV3_PORT_B);
+    angle4msL = 0;
+    angle4msR = 0;
+}
 
 /* 初期化関数 */
 void Run_initDistance() {
@@ -130,29 +323,30 @@ void Run_initDistance() {
     run.distance = 0.0;
     distance4msR = 0.0;
     distance4msL = 0.0;
-    //モータ角度の過去値に現在値を代入
-    pre_angleL = ev3_motor_get_counts(EV3_PORT_C);
-    pre_angleR = ev3_motor_get_counts(EV3_PORT_B);
+    sum_counts = 0;
 }
 
-/* 距離更新（4ms間の移動距離を毎回加算している） */
+/* 距離更新（4ms間の回転角度を整数で積算し、積算値から距離を求める） */
 void Run_updateDistance(){
-    float cur_angleL = ev3_motor_get_counts(EV3_PORT_C);    //左モータ回転角度の現在値
-    float cur_angleR = ev3_motor_get_counts(EV3_PORT_B);   //右モータ回転角度の現在値
-    float distance4ms = 0.0;        //4msの距離
+    int32_t cur_countL = ev3_motor_get_counts(EV3_PORT_C);  //左モータ回転角度の現在値
+    int32_t cur_countR = ev3_motor_get_counts(EV3_PORT_B);  //右モータ回転角度の現在値
+
+    run.counts_L = cur_countL;
+    run.counts_R = cur_countR;
+    angle4msL = cur_countL - pre_countL;
+    angle4msR = cur_countR - pre_countR;
 
-    // 4ms間の走行距離 = ((円周率 * タイヤの直径) / 360) * (モータ角度過去値　- モータ角度現在値)
-    distance4msL = ((PI * TIRE_DIAMETER) / 360.0) * (cur_angleL - pre_angleL);  // 4ms間の左モータ距離
-    distance4msR = ((PI * TIRE_DIAMETER) / 360.0) * (cur_angleR - pre_angleR);  // 4ms間の右モータ距離
-    distance4ms = (distance4msL + distance4msR) / 2.0; //左右タイヤの走行距離を足して割る
-    run.distance += distance4ms;
+    // 4ms間の走行距離 = ((円周率 * タイヤの直径) / 360) * (モータ角度現在値 - モータ角度過去値)
+    distance4msL = MM_PER_COUNT * angle4msL;    // 4ms間の左モータ距離
+    distance4msR = MM_PER_COUNT * angle4msR;    // 4ms間の右モータ距離
 
-    angle4msL = cur_angleL - pre_angleL;
-    angle4msR = cur_angleR - pre_angleR;
+    // 走行距離 = 左右タイヤの走行距離の平均
+    sum_counts += angle4msL + angle4msR;
+    run.distance = MM_PER_COUNT / 2.0 * sum_counts;
 
     //モータの回転角度の過去値を更新
-    pre_angleL = cur_angleL;
-    pre_angleR = cur_angleR;
+    pre_countL = cur_countL;
+    pre_countR = cur_countR;
 }
 
 /* 右タイヤの4ms間の距離を取得 */
@@ -167,23 +361,219 @@ float Run_getDistance4msLeft(){
 
 /* 右タイヤの4ms間の角度を取得 */
 int Run_getAngle4msLeft(){
-    return roundf(angle4msL);
+    return angle4msL;
 }
 
 /* 左タイヤの4ms間の角度を取得 */
 int Run_getAngle4msRight(){ 
-    return roundf(angle4msR);
+    return angle4msR;
 }
 
 // 方位計測用の関数群(引用：https://qiita.com/TetsuroAkagawa/items/4e7de30523d9c7ec6241)
+// モーター角度の差から求めた方位は車輪が滑ると(スラロームの板・段差など)誤差がそのまま残るため、ジャイロセンサーと相補フィルタで組み合わせる
+//  - 毎周期、モーター角度の差から求めた方位の変化で予測する(ジャイロセンサーは毎周期読まないため、読まない周期もこれで進める)
+//  - ジャイロセンサーを読み出した周期に、ジャイロセンサーの角度(バイアス補正後)から求めた方位へ時定数DIR_FUSE_TAUで寄せる
+//    ジャイロセンサーの角度は1度単位のため、変化量ではなく角度そのものに寄せる(端数の誤差が積み重ならない)
+//  - 直進・停止中が続いた区間(DIR_BIAS_WINDOW)ごとに、両者の変化の差からジャイロセンサーのバイアスを推定し続ける
+//    一定の滑りとバイアスは区別できないため、走行中は時定数を長くし、停止中(スタート待ちなど)に速く推定する
+// *ジャイロセンサーは車体の旋回(鉛直軸まわり)を測る向きに取り付けること。現在は傾きを測る向きのため、DIR_GYRO_FUSIONは0(無効)
 //---------------------------------------------------------------------------------------------------------------------------------
+static int16_t dir_pre_angle = 0;   // 前回読み出したジャイロセンサーの角度
+static uint32_t dir_pre_stamp = 0;  // 同上を読み出した周期
+static bool_t dir_gyro_ref = false; // ジャイロセンサーの角度と方位の対応が求まっているかどうか
+static float dir_gyro_offset = 0.0; // ジャイロセンサーの角度から求めた方位 = 角度 - バイアスの積算 + dir_gyro_offset [deg]
+static float dir_gyro_bias = 0.0;   // 推定したバイアス[deg/s]
+static float dir_bias_sum = 0.0;    // バイアスの積算[deg]
+static float dir_odo = 0.0;         // ジャイロセンサーを前回読み出してからのモーター角度による方位の変化[deg]
+static float dir_win_diff = 0.0;    // バイアスを求める区間での、ジャイロセンサーとモーター角度の方位の変化の差[deg]
+static float dir_win_time = 0.0;    // 同区間の長さ[s]
+static bool_t dir_win_moved = false;    // 同区間で車輪が回ったかどうか
+
  /* 初期化 */
 void Run_initDirection(){
     run.direction = 0.0;
+    run.direction_odo = 0.0;
+    diff_counts = 0;
+    dir_gyro_ref = false;           // 次にジャイロセンサーを読み出したときに現在の方位と対応させる(バイアスは初期化しない)
 }
 
-/* 方位を更新 */
+/* 方位を更新(Run_updateDistanceの後に呼ぶこと) */
 void Run_updateDirection(){
-    //(360 / (2 * 円周率 * 車体トレッド幅)) * (右進行距離 - 左進行距離)
-    run.direction += (360.0 / (2.0 * PI * TREAD)) * (Run_getDistance4msLeft() - Run_getDistance4msRight());
+    //(360 / (2 * 円周率 * 車体トレッド幅)) * (左進行距離 - 右進行距離) = (タイヤの直径 / (2 * 車体トレッド幅)) * (左回転角度 - 右回転角度)
+    float d_odo = DEG_PER_COUNT * (angle4msL - angle4msR);
+    float dt, gyro_dir;
+    int16_t dangle;
+
+    diff_counts += angle4msL - angle4msR;
+    run.direction_odo = DEG_PER_COUNT * diff_counts;
+
+    if(!DIR_GYRO_FUSION)            // モーター角度のみの場合は変化を積算せず、回転角度の差の累計から求める(丸め誤差が積み重ならない)
+    {
+        run.direction = run.direction_odo;
+        return;
+    }
+
+    run.direction += d_odo;         // モーター角度の変化で予測
+    dir_odo += d_odo;
+    if(angle4msL != 0 || angle4msR != 0)
+        dir_win_moved = true;
+
+    if(run.stamp[RUN_SRC_GYRO] == dir_pre_stamp)    // ジャイロセンサーを読み出していない周期
+        return;
+
+    dt = (run.stamp[RUN_SRC_GYRO] - dir_pre_stamp) * CLOCK_DT;
+    dangle = run.angle - dir_pre_angle;
+    dir_pre_angle = run.angle;
+    dir_pre_stamp = run.stamp[RUN_SRC_GYRO];
+
+    if(!dir_gyro_ref || gyro_rebase || dangle < -GYRO_JUMP || GYRO_JUMP < dangle)  // 初回・リセットされた場合は現在の方位に対応させ直す
+    {
+        dir_gyro_offset = run.direction - (DIR_GYRO_SIGN * run.angle - dir_bias_sum);
+        dir_gyro_ref = true;
+        dir_odo = 0.0;
+        return;
+    }
+
+    // 直進・停止中が続いた区間ごとに、モーター角度の変化を正としてバイアスを推定する(旋回した時点で区間をやり直す)
+    if(fabsf(dir_odo) < DIR_BIAS_RATE * dt)
+    {
+        dir_win_diff += DIR_GYRO_SIGN * dangle - dir_odo;
+        dir_win_time += dt;
+        if(dir_win_time >= DIR_BIAS_WINDOW)
+        {
+            if(fabsf(dir_win_diff) <= DIR_BIAS_MAX * dir_win_time)     // 差が大きい区間は滑りとみなして使わない
+                dir_gyro_bias += (dir_win_diff / dir_win_time - dir_gyro_bias)
+                               * (dir_win_time / (dir_win_moved ? DIR_BIAS_TAU : DIR_BIAS_TAU_STOP));
+            dir_win_diff = 0.0;
+            dir_win_time = 0.0;
+            dir_win_moved = false;
+        }
+    }
+    else
+    {
+        dir_win_diff = 0.0;
+        dir_win_time = 0.0;
+        dir_win_moved = false;
+    }
+    dir_bias_sum += dir_gyro_bias * dt;
+    dir_odo = 0.0;
+
+    gyro_dir = DIR_GYRO_SIGN * run.angle - dir_bias_sum + dir_gyro_offset;
+    run.direction += (gyro_dir - run.direction) * (dt / (DIR_FUSE_TAU + dt));
+}
+
+// 位置計測用の関数群
+// 座標系はRun_setPoseで指定した原点・向きを基準に、x軸が前方、y軸が右方向、向きは右回転を正とする(Run_getDirectionと同じ向き)
+// 1周期の移動を円弧とみなして積分する(直進・その場旋回を含め、左右の移動量が一定であれば誤差が出ない)
+//---------------------------------------------------------------------------------------------------------------------------------
+static int32_t pose_counts = 0;     // 原点を設定してからの左右モータ回転角度の差(左 - 右)
+static float pose_heading0 = 0.0;   // 原点を設定したときの向き[rad]
+static float pose_theta = 0.0;      // 現在の向き[rad](正規化しない)
+
+/* 位置を設定(周期ハンドラのみが呼ぶ) */
+static void Run_initPose(const run_pose_t *pose)
+{
+    run.pose.x = pose->x;
+    run.pose.y = pose->y;
+    pose_heading0 = pose->heading * (PI / 180.0);
+    pose_counts = 0;
+    pose_theta = pose_heading0;
+    run.pose.heading = pose->heading;
+}
+
+/* 位置を更新(Run_updateDistanceの後に呼ぶこと) */
+void Run_updatePose(void)
+{
+    float ds = (distance4msL + distance4msR) / 2.0;  // 車体中心の移動距離
+    float theta0 = pose_theta;
+    float dtheta, r;
+
+    pose_counts += angle4msL - angle4msR;
+    pose_theta = pose_heading0 + RAD_PER_COUNT * pose_counts;   // 向きは積算した整数値から求める
+    dtheta = pose_theta - theta0;
+
+    if(fabsf(dtheta) < 1.0e-4)      // ほぼ直進の場合は中間の向きで直線近似(円弧の半径が大きすぎて桁落ちするため)
+    {
+        run.pose.x += ds * cosf(theta0 + dtheta / 2.0);
+        run.pose.y += ds * sinf(theta0 + dtheta / 2.0);
+    }
+    else                            // 旋回中は半径r = ds / dthetaの円弧として積分
+    {
+        r = ds / dtheta;
+        run.pose.x += r * (sinf(pose_theta) - sinf(theta0));
+        run.pose.y -= r * (cosf(pose_theta) - cosf(theta0));
+    }
+
+    // 公開する向きは-180～180度に正規化する
+    run.pose.heading = remainderf(pose_theta * (180.0 / PI), 360.0);
+}
+
+/* 位置を設定(Run_initと同様に周期ハンドラに依頼して完了を待つ) */
+void Run_setPose(float x, float y, float heading)
+{
+    pose_next.x = x;
+    pose_next.y = y;
+    pose_next.heading = heading;
+    BARRIER();
+    if(!Run_request(&pose_req))             // 周期ハンドラが動いていない場合
+    {
+        Run_initPose(&pose_next);
+        Run_publish();
+        pose_req = false;
+    }
+}
+
+/* 現在位置を取得 */
+void Run_getPose(run_pose_t *pose)
+{
+    run_data_t data;
+
+    Run_getSnapshot(&data);
+    *pose = data.pose;
+}
+
+// 曲率計測用の関数群
+// 1周期の旋回量と移動量をそれぞれ走行距離に対する指数移動平均で平滑化し、その比を曲率とする
+// 移動量の小さい周期の比をそのまま取ると値が暴れるため、比を取る前に平滑化する(停止中は前回の値を保つ)
+//---------------------------------------------------------------------------------------------------------------------------------
+static float curv_dtheta = 0.0;     // 平滑化した旋回量[rad]
+static float curv_ds = 0.0;         // 平滑化した移動量[mm]
+static int16_t curv_pre_angle = 0;  // ジャイロセンサーの角度の過去値
+static uint32_t curv_pre_stamp = 0; // 同上を読み出した周期
+static float curv_gyro = 0.0;       // 1周期あたりの角度変化[deg](ジャイロセンサーを読み出すごとに求め直す)
+static bool_t curv_gyro_ok = false; // 角度変化が使えるかどうか(リセットとみなした場合は偽)
+
+/* 曲率を更新(Run_updateDistanceの後に呼ぶこと) */
+void Run_updateCurvature(void)
+{
+    float ds = (distance4msL + distance4msR) / 2.0;
+    float dtheta = RAD_PER_COUNT * (angle4msL - angle4msR);
+    float alpha = (fabsf(distance4msL) + fabsf(distance4msR)) / 2.0 / CURV_WINDOW;  // 車輪の移動量に応じた平滑化の係数
+    int16_t dangle;
+
+    // ジャイロセンサーはモーター角度より長い周期で読むため、読み出した間隔で割った1周期あたりの角度変化を次に読むまで使う
+    if(run.stamp[RUN_SRC_GYRO] != curv_pre_stamp)
+    {
+        dangle = run.angle - curv_pre_angle;
+        curv_gyro_ok = (!gyro_rebase && -GYRO_JUMP <= dangle && dangle <= GYRO_JUMP);
+        curv_gyro = (float)(DIR_GYRO_SIGN * dangle) / (run.stamp[RUN_SRC_GYRO] - curv_pre_stamp);
+        curv_pre_angle = run.angle;
+        curv_pre_stamp = run.stamp[RUN_SRC_GYRO];
+    }
+    if(CURV_GYRO_WEIGHT > 0.0 && curv_gyro_ok)
+        dtheta = (1.0 - CURV_GYRO_WEIGHT) * dtheta + CURV_GYRO_WEIGHT * curv_gyro * (PI / 180.0);
+    if(ds < 0)                      // 後退中も進行方向に対する曲率とする
+    {
+        ds = -ds;
+        dtheta = -dtheta;
+    }
+    if(alpha > 1.0)
+        alpha = 1.0;
+
+    curv_dtheta = curv_dtheta * (1.0 - alpha) + dtheta;
+    curv_ds     = curv_ds     * (1.0 - alpha) + ds;
+    if(curv_ds * CURV_MAX > fabsf(curv_dtheta))
+        run.curvature = curv_dtheta / curv_ds;
+    else                            // その場旋回に近い場合は上限とする
+        run.curvature = (curv_dtheta > 0) ? CURV_MAX : ((curv_dtheta < 0) ? -CURV_MAX : 0.0);
 }
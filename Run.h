@@ -2,35 +2,101 @@
 #define INCLUDED_Run_h_
 
 #include "ev3api.h"
+#include "Clock.h"
+#include "Color.h"
 
-/* 関数プロトタイプ宣言 */
+/* 計測元 *Run_updateが計測元ごとの周期・位相で読み出す(周期・位相はRun.cを参照) */
+typedef enum {
+    RUN_SRC_COLOR,      // カラーセンサー(rgb, color, offset)
+    RUN_SRC_GYRO,       // ジャイロセンサー(angle)
+    RUN_SRC_SONAR,      // 超音波センサー(sonar, sonar_raw, sonar_conf)
+    RUN_SRC_MOTOR,      // モーター出力(power_L, power_R, power, turn)
+    RUN_SRC_ENCODER,    // モーター角度(distance, direction, pose, curvature)
+    TNUM_RUN_SRC
+} run_src_t;
+
+/* 構造体 */
+typedef struct running_pose{    // 位置用の構造体(座標系はRun_setPoseを参照)
+    float       x;              // [mm]
+    float       y;              // [mm]
+    float       heading;        // 向き[deg](-180～180、右回転が正)
+}run_pose_t;
 
-// 走行ログ用の関数
-extern void log_stamp(char *stamp); // app.cで定義した(staticでない)関数は宣言の必要は無いようですが、一応各区間のソースファイルで利用するのでここで宣言
+typedef struct running_data{    // 走行データ用の構造体
+    rgb_raw_t   rgb;
+    colorid_t   color[TNUM_COLOR_SET];  // 判定条件の組(Color.h)ごとに判定した色
+    int16_t     offset;             // ラインのエッジからのずれ[0.1mm](白の側が正 *Line.h)
+    int8_t      power_L;
+    int8_t      power_R;
+    int8_t      power;
+    int16_t     turn;
+    int16_t     angle;
+    int16_t     sonar;              // 平滑化した超音波センサーの距離[cm](Sonar.h)
+    int16_t     sonar_raw;          // 同センサーの最新の測定値[cm](停止の閾値の判定用)
+    uint8_t     sonar_conf;
+    float       speed;
+    float       curvature;
+    float       distance;
+    float       direction;          // 走行方位[deg](Run.cのDIR_GYRO_FUSIONが1の場合はモーター角度とジャイロセンサーを組み合わせた値)
+    float       direction_odo;      // モーター角度のみから求めた走行方位[deg]
+    int32_t     counts_L;           // 左モーターの回転角度[deg](初期化しない通算の値)
+    int32_t     counts_R;           // 右モーターの回転角度[deg](同上)
+    run_pose_t  pose;
+    uint32_t    time;
+    uint32_t    tick;                   // 更新の通し番号(Run_initで初期化しない)
+    uint32_t    stamp[TNUM_RUN_SRC];    // 計測元ごとに値を読み出した周期(tickの値)
+}run_data_t;
+
+/* 関数プロトタイプ宣言 */
 
 // 初期化・値更新関数
 void Run_init();    // 走行データを初期化
 void Run_update();  // 走行データを更新
 
 // 値取得関数
+void     Run_getSnapshot(run_data_t *data); // 同じ周期に計測した値の一式を取得
+uint32_t Run_getAge(run_src_t src);         // 計測元の値を読み出してからの経過周期数(0 : 最新の周期に読み出した値)
+                                            //  *一式を取得した場合は data.tick - data.stamp[src] で求める
 uint16_t Run_getRGB_R();
 uint16_t Run_getRGB_G();
 uint16_t Run_getRGB_B();
+colorid_t Run_getColor(color_set_t set);
+int16_t  Run_getLineOffset();
 uint32_t Run_getTime();
 int8_t   Run_getPower();
 int8_t   Run_getPower_L();
 int8_t   Run_getPower_R();
 int16_t  Run_getTurn();
 int16_t  Run_getAngle();
+int16_t  Run_getSonar();
+int16_t  Run_getSonarRaw();
+uint8_t  Run_getSonarConfidence();
 float    Run_getDistance();
 float    Run_getDirection();
+float    Run_getDirectionOdometry();
 float    Run_getSpeed();
+float    Run_getCurvature();
+
+// ジャイロセンサーをリセットする(走行中にリセットした角度の変化を、方位・曲率の計算で旋回とみなさない)
+// *走行中はev3_gyro_sensor_resetを直接呼ばず、これを使うこと
+void Run_resetGyro(void);
+
+// 位置計測用の関数群
+// x軸は原点を設定したときの前方、y軸は右方向、向きはx軸から右回転を正とする(Run_getDirectionと同じ向き)
+//---------------------------------------------------------------------------------------------------------------------------------
+void Run_setPose(float x, float y, float heading);  // 現在位置を設定(走行開始前のRun_initで原点(0, 0, 0)に設定される)
+void Run_getPose(run_pose_t *pose);                 // 現在位置を取得
+void Run_updatePose();                              // 位置を更新
 
 // 計測値更新用の関数群
 //---------------------------------------------------------------------------------------------------------------------------------
+void Run_updateColor();
+void Run_updateGyro();
 void Run_updateMotor();
 void Run_updateSpeed();
-void Run_updateSamplingTime(uint16_t cur_value);
+void Run_updateCurvature();
+void Run_updateSonar();
+// *更新周期・処理時間の計測はProf.hを参照
 
 // 距離計測用関数群(引用：https://qiita.com/TetsuroAkagawa/items/ba6190f08d26df7cc8ad)
 //---------------------------------------------------------------------------------------------------------------------------------
@@ -57,7 +123,7 @@ int Run_getAngle4msRight();
 /* 初期化 */
 void Run_initDirection();
 
- // 方位を更新
+ // 方位を更新(モーター角度の差とジャイロセンサーの角度を相補フィルタで組み合わせる)
 void Run_updateDirection();
 
 #endif
\ No newline at end of file
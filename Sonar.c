@@ -0,0 +1,67 @@
+#include "Sonar.h"
+
+/* グローバル宣言 */
+static int16_t window[SONAR_WINDOW];    // 直近の測定値(リングバッファ)
+static uint8_t pos = 0;                 // 次に書き込む位置
+static uint8_t count = 0;               // 蓄積した値の数(SONAR_WINDOWまで)
+static int32_t ema = SONAR_NO_ECHO << 4;    // 指数移動平均(Q4)
+static int16_t distance = SONAR_NO_ECHO;
+static int16_t latest = SONAR_NO_ECHO;  // 最新の測定値
+static uint8_t confidence = 0;
+
+/* 関数 */
+
+// フィルタを初期化
+void Sonar_init(void)
+{
+    pos = 0;
+    count = 0;
+    ema = SONAR_NO_ECHO << 4;
+    distance = SONAR_NO_ECHO;
+    latest = SONAR_NO_ECHO;
+    confidence = 0;
+}
+
+// 測定値を1つ追加
+void Sonar_sample(int16_t raw)
+{
+    int16_t sorted[SONAR_WINDOW];
+    int16_t median, v;
+    uint8_t near = 0;
+    int i, j;
+
+    if(raw < 0 || raw > SONAR_NO_ECHO)      // 範囲外の値は反射なしとして扱う
+        raw = SONAR_NO_ECHO;
+    latest = raw;
+
+    window[pos] = raw;
+    pos = (pos + 1) % SONAR_WINDOW;
+    if(count < SONAR_WINDOW)
+        count++;
+
+    for(i = 0; i < count; i++)              // 挿入ソートで中央値を求める(最大5要素)
+    {
+        v = window[i];
+        for(j = i; j > 0 && sorted[j - 1] > v; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    median = sorted[count / 2];
+
+    if(count == 1 || median > distance + SONAR_JUMP || median < distance - SONAR_JUMP)
+        ema = median << 4;                      // 最初の値と、大きく変化した場合はそのまま採用(平滑化による遅れを防ぐ)
+    else
+        ema += ((median << 4) - ema) / 2;       // 指数移動平均(係数1/2)
+    distance = (ema + 8) >> 4;
+
+    for(i = 0; i < count; i++)
+    {
+        if(window[i] >= median - SONAR_TOLERANCE && window[i] <= median + SONAR_TOLERANCE)
+            near++;
+    }
+    confidence = near * 100 / SONAR_WINDOW;     // 値が揃うまでは信頼度を低くする
+}
+
+int16_t Sonar_getDistance(void)   { return distance; }
+int16_t Sonar_getLatest(void)     { return latest; }
+uint8_t Sonar_getConfidence(void) { return confidence; }
@@ -0,0 +1,26 @@
+#ifndef INCLUDED_Sonar_h_
+#define INCLUDED_Sonar_h_
+
+#include "ev3api.h"
+
+// 超音波センサーの値を平滑化するフィルタ
+// 周期ハンドラ(Run_update)からセンサーの更新周期ごとに1回だけ値を渡し、直近の値の中央値をさらに指数移動平均で平滑化する
+// 併せて、直近の値のばらつきから信頼度(0 ~ 100)を求める
+// *平滑化した値は中央値とEMAの分だけ遅れる(近づいている間は約3回分 = 120ms)ため、壁などで停止する閾値の判定には
+//  最新の測定値(Sonar_getLatest)を使い、平滑化した値は配置パターンの判断など止まった状態での判定に使う
+
+/* マクロ定義 */
+#define SONAR_PERIOD_MS 40      // 超音波センサーの測定周期[ms](sonar_alertの注記を参照)
+#define SONAR_WINDOW    5       // 中央値を求める値の数(奇数)
+#define SONAR_NO_ECHO   255     // 反射が得られなかった場合の値[cm]
+#define SONAR_TOLERANCE 3       // 信頼度の計算で中央値と同じとみなす範囲[cm]
+#define SONAR_JUMP      10      // 平滑化せずに追従する変化量[cm]
+
+/* 関数プロトタイプ宣言 */
+void    Sonar_init(void);               // フィルタを初期化
+void    Sonar_sample(int16_t raw);      // 測定値を1つ追加
+int16_t Sonar_getDistance(void);        // 平滑化した距離[cm]
+int16_t Sonar_getLatest(void);          // 最新の測定値[cm](平滑化しない。範囲外の値はSONAR_NO_ECHO)
+uint8_t Sonar_getConfidence(void);      // 信頼度(直近の値のうち中央値に近い値の割合[%])
+
+#endif
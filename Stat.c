@@ -0,0 +1,108 @@
+#include "Stat.h"
+
+/* 関数 */
+
+// 初期化
+void Stat_init(stat_window_t *w, uint16_t size)
+{
+    if(size < 1)
+        size = 1;
+    if(size > STAT_WINDOW_MAX)
+        size = STAT_WINDOW_MAX;
+
+    w->size = size;
+    w->seq = 0;
+    w->sum = 0;
+    w->sum_sq = 0;
+    w->max_head = w->max_len = 0;
+    w->min_head = w->min_len = 0;
+}
+
+// 値を1つ追加
+void Stat_push(stat_window_t *w, int16_t value)
+{
+    uint16_t slot = w->seq % w->size;
+    int16_t old;
+
+    if(w->seq >= w->size)                   // 窓が埋まっている場合は最も古い値を外す
+    {
+        old = w->buf[slot];
+        w->sum -= old;
+        w->sum_sq -= (int32_t)old * old;
+    }
+    w->buf[slot] = value;
+    w->sum += value;
+    w->sum_sq += (int32_t)value * value;
+
+    // 最大値 : 窓から外れた先頭の候補を捨て、新しい値以下の候補は今後最大になることがないため末尾から捨てる
+    if(w->max_len > 0 && w->max_q[w->max_head] + w->size <= w->seq)
+    {
+        w->max_head = (w->max_head + 1) % w->size;
+        w->max_len--;
+    }
+    while(w->max_len > 0 && w->buf[w->max_q[(w->max_head + w->max_len - 1) % w->size] % w->size] <= value)
+        w->max_len--;
+    w->max_q[(w->max_head + w->max_len) % w->size] = w->seq;
+    w->max_len++;
+
+    // 最小値 : 最大値と同様
+    if(w->min_len > 0 && w->min_q[w->min_head] + w->size <= w->seq)
+    {
+        w->min_head = (w->min_head + 1) % w->size;
+        w->min_len--;
+    }
+    while(w->min_len > 0 && w->buf[w->min_q[(w->min_head + w->min_len - 1) % w->size] % w->size] >= value)
+        w->min_len--;
+    w->min_q[(w->min_head + w->min_len) % w->size] = w->seq;
+    w->min_len++;
+
+    w->seq++;
+}
+
+// 窓が値で埋まったかどうか
+bool_t Stat_isFull(const stat_window_t *w)
+{
+    return w->seq >= w->size;
+}
+
+// 窓内の値の数
+int16_t Stat_getCount(const stat_window_t *w)
+{
+    return (w->seq < w->size) ? w->seq : w->size;
+}
+
+// 平均
+int16_t Stat_getMean(const stat_window_t *w)
+{
+    int16_t n = Stat_getCount(w);
+
+    if(n == 0)
+        return 0;
+    return w->sum / n;
+}
+
+// 分散 : (二乗和 - 合計^2 / n) / n
+int32_t Stat_getVariance(const stat_window_t *w)
+{
+    int16_t n = Stat_getCount(w);
+
+    if(n == 0)
+        return 0;
+    return (int32_t)((w->sum_sq - (int64_t)w->sum * w->sum / n) / n);
+}
+
+// 最小値
+int16_t Stat_getMin(const stat_window_t *w)
+{
+    if(w->min_len == 0)
+        return 0;
+    return w->buf[w->min_q[w->min_head] % w->size];
+}
+
+// 最大値
+int16_t Stat_getMax(const stat_window_t *w)
+{
+    if(w->max_len == 0)
+        return 0;
+    return w->buf[w->max_q[w->max_head] % w->size];
+}
@@ -0,0 +1,37 @@
+#ifndef INCLUDED_Stat_h_
+#define INCLUDED_Stat_h_
+
+#include "ev3api.h"
+
+// 直近N個の値の統計(平均・分散・最小・最大)を求めるスライディングウィンドウ
+// 値を1つ追加するたびに合計と二乗和を差分で更新し、最小・最大は単調キューで保持するため、1回の更新は窓の大きさによらず定数時間で済む
+// 旋回量、RGB値、ジャイロなど、用途ごとにstat_window_tを1つずつ用意して使う
+
+/* マクロ定義 */
+#define STAT_WINDOW_MAX 128     // 窓の大きさの上限
+
+/* スライディングウィンドウ */
+typedef struct {
+    int16_t     buf[STAT_WINDOW_MAX];       // 直近の値(リングバッファ)
+    uint32_t    max_q[STAT_WINDOW_MAX];     // 最大値の候補の番号(値が大きい順)
+    uint32_t    min_q[STAT_WINDOW_MAX];     // 最小値の候補の番号(値が小さい順)
+    uint16_t    max_head, max_len;
+    uint16_t    min_head, min_len;
+    uint16_t    size;                       // 窓の大きさ
+    uint32_t    seq;                        // 追加した値の総数(次の値の番号)
+    int32_t     sum;                        // 窓内の値の合計
+    int64_t     sum_sq;                     // 窓内の値の二乗和
+} stat_window_t;
+
+/* 関数プロトタイプ宣言 */
+void    Stat_init(stat_window_t *w, uint16_t size);     // 初期化(sizeは1 ~ STAT_WINDOW_MAX)
+void    Stat_push(stat_window_t *w, int16_t value);     // 値を1つ追加(最も古い値は窓から外れる)
+
+bool_t  Stat_isFull(const stat_window_t *w);            // 窓が値で埋まったかどうか
+int16_t Stat_getCount(const stat_window_t *w);          // 窓内の値の数
+int16_t Stat_getMean(const stat_window_t *w);           // 平均(小数点以下切り捨て)
+int32_t Stat_getVariance(const stat_window_t *w);       // 分散(母分散、小数点以下切り捨て)
+int16_t Stat_getMin(const stat_window_t *w);            // 最小値
+int16_t Stat_getMax(const stat_window_t *w);            // 最大値
+
+#endif
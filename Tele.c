@@ -0,0 +1,270 @@
+#include <string.h>
+#include "Tele.h"
+
+#ifndef TELE_HOST
+#include "Run.h"
+#include "Param.h"
+#endif
+
+/* マクロ定義 */
+#define CRC_INIT        0xFFFF  // CRC-16/CCITT(多項式0x1021)の初期値
+
+/* グローバル宣言 */
+static uint8_t seq = 0;                 // 送信するフレームの通し番号(受信側で抜けを検出する)
+
+/* 関数 */
+
+// フレームの組み立て・切り出し(ホスト側のツールと共有)
+//---------------------------------------------------------------------------------------------------------------------------------
+
+// CRC-16/CCITT
+static uint16_t Tele_crc(const uint8_t *data, uint32_t len)
+{
+    uint16_t crc = CRC_INIT;
+    int i;
+
+    while(len--)
+    {
+        crc ^= (uint16_t)*data++ << 8;
+        for(i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+// フレームを組み立てる
+uint32_t Tele_encode(uint8_t *frame, uint8_t type, const void *payload, uint8_t len)
+{
+    uint16_t crc;
+
+    if(len > TELE_PAYLOAD_MAX)
+        return 0;
+
+    frame[0] = TELE_SYNC0;
+    frame[1] = TELE_SYNC1;
+    frame[2] = type;
+    frame[3] = seq++;
+    frame[4] = len;
+    if(len > 0)
+        memcpy(&frame[TELE_HEADER_SIZE], payload, len);
+
+    crc = Tele_crc(&frame[2], TELE_HEADER_SIZE - 2 + len);     // 同期バイトは含めない
+    frame[TELE_HEADER_SIZE + len]     = crc & 0xFF;
+    frame[TELE_HEADER_SIZE + len + 1] = crc >> 8;
+
+    return TELE_HEADER_SIZE + len + TELE_CRC_SIZE;
+}
+
+// 切り出しの状態を初期化
+void Tele_initParser(tele_parser_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->pre_seq = -1;
+}
+
+// 1バイト受け取り、フレームが揃って正しい場合は1を返す
+// 起動時のメッセージやエコーバックなどの文字が混ざっても、次の同期バイトから読み直す
+int Tele_parse(tele_parser_t *p, uint8_t c)
+{
+    uint32_t len, size;
+    uint16_t crc;
+
+    switch(p->state)
+    {
+        case 0:
+            if(c == TELE_SYNC0)
+                p->frame[p->state++] = c;
+            else
+                p->skipped++;
+            return 0;
+        case 1:
+            if(c == TELE_SYNC1)
+                p->frame[p->state++] = c;
+            else if(c != TELE_SYNC0)        // 0xA5が続いた場合は2つ目を先頭とみなす
+            {
+                p->skipped += 2;
+                p->state = 0;
+            }
+            else
+                p->skipped++;
+            return 0;
+        case 4:
+            if(c > TELE_PAYLOAD_MAX)        // 長さが不正な場合は同期を取り直す
+            {
+                p->skipped += 5;
+                p->state = 0;
+                return 0;
+            }
+            break;
+        default:
+            break;
+    }
+
+    p->frame[p->state++] = c;
+    if(p->state < TELE_HEADER_SIZE)
+        return 0;
+
+    len = p->frame[4];
+    size = TELE_HEADER_SIZE + len + TELE_CRC_SIZE;
+    if((uint32_t)p->state < size)
+        return 0;
+
+    p->state = 0;
+    crc = p->frame[size - 2] | (p->frame[size - 1] << 8);
+    if(crc != Tele_crc(&p->frame[2], TELE_HEADER_SIZE - 2 + len))
+    {
+        p->crc_errors++;
+        return 0;
+    }
+
+    if(p->pre_seq >= 0)
+        p->lost += (uint8_t)(p->frame[3] - p->pre_seq - 1);
+    p->pre_seq = p->frame[3];
+    p->frames++;
+
+    p->type = p->frame[2];
+    p->len = len;
+    p->payload = &p->frame[TELE_HEADER_SIZE];
+    return 1;
+}
+
+#ifndef TELE_HOST
+
+// 送受信(EV3側)
+//---------------------------------------------------------------------------------------------------------------------------------
+static FILE *out = NULL;                // 送信先(Bluetoothのファイル)
+static volatile bool_t enabled = false; // 送信の有効・無効(bt_taskが書き、tele_taskが読む)
+static volatile uint16_t period = CLOCK_TICKS(TELE_PERIOD_MS) * CLOCK_PERIOD_MS;   // 送信周期[ms]
+static uint32_t pre_ticks = 0;          // 前回走行データを送ったときの周期ハンドラの起動回数
+static uint32_t sent = 0;
+static tele_parser_t rx;                // 受信したフレームの切り出し(bt_taskのみが使う)
+
+// int16_tの範囲に飽和させる
+static int16_t Tele_sat16(float v)
+{
+    if(v > 32767.0)  return 32767;
+    if(v < -32768.0) return -32768;
+    return (int16_t)v;
+}
+
+// 走行データをペイロードに詰め替える
+static void Tele_pack(tele_run_t *t, const run_data_t *run)
+{
+    t->time       = run->time;
+    t->distance   = run->distance;
+    t->direction  = run->direction;
+    t->x          = Tele_sat16(run->pose.x);
+    t->y          = Tele_sat16(run->pose.y);
+    t->heading    = Tele_sat16(run->pose.heading * 100.0);
+    t->speed      = Tele_sat16(run->speed * 10.0);      // 100ms毎の移動量[mm] -> [mm/s]
+    t->curvature  = Tele_sat16(run->curvature * 1.0e6);
+    t->turn       = run->turn;
+    t->angle      = run->angle;
+    t->sonar      = run->sonar;
+    t->r          = run->rgb.r;
+    t->g          = run->rgb.g;
+    t->b          = run->rgb.b;
+    t->power_L    = run->power_L;
+    t->power_R    = run->power_R;
+    t->color      = (uint8_t)run->color[COLOR_SET_LINE];
+    t->sonar_conf = run->sonar_conf;
+    t->period_ms  = CLOCK_PERIOD_MS;
+    t->reserved   = 0;
+}
+
+// フレームを1つ書き込む
+static int Tele_write(uint8_t type, const void *payload, uint8_t len)
+{
+    uint8_t frame[TELE_FRAME_MAX];
+    uint32_t size = Tele_encode(frame, type, payload, len);
+
+    if(out == NULL || fwrite(frame, 1, size, out) != size)
+        return 0;
+    fflush(out);
+    sent++;
+    return 1;
+}
+
+// 初期化
+void Tele_init(FILE *fp)
+{
+    out = fp;
+    enabled = false;
+    seq = 0;
+    sent = 0;
+    pre_ticks = Clock_getTicks();
+    Tele_initParser(&rx);
+}
+
+void Tele_enable(bool_t enable)     { enabled = (out != NULL) && enable; }
+bool_t Tele_isEnabled(void)         { return enabled; }
+uint16_t Tele_getPeriod(void)       { return period; }
+uint32_t Tele_getSent(void)         { return sent; }
+
+// 送信周期を設定(制御周期より細かくしても同じ値が重複するだけなので、制御周期の整数倍に切り上げる)
+void Tele_setPeriod(uint16_t ms)
+{
+    uint16_t ticks = CLOCK_TICKS(ms);
+
+    period = (ticks < 1 ? 1 : ticks) * CLOCK_PERIOD_MS;
+}
+
+// 最新の走行データを1フレーム送信する
+// 周期ハンドラが公開したスナップショットを読むだけなので、制御側のタスクとの排他制御は不要
+int Tele_send(void)
+{
+    run_data_t run;
+    tele_run_t payload;
+
+    Run_getSnapshot(&run);
+    Tele_pack(&payload, &run);
+    return Tele_write(TELE_TYPE_RUN, &payload, sizeof(payload));
+}
+
+// 応答と走行データを送信する
+// 走行データは周期ハンドラの起動回数で送信周期を測るため、周期ハンドラが止まっている間(スタート前など)は送らない
+void Tele_poll(void)
+{
+    tele_param_t ack;
+    uint32_t now = Clock_getTicks();
+
+    while(Param_popAck(&ack))
+        Tele_write(TELE_TYPE_PARAM_ACK, &ack, sizeof(ack));
+
+    if(enabled && now - pre_ticks >= (uint32_t)(period / CLOCK_PERIOD_MS))
+    {
+        pre_ticks = now;
+        Tele_send();
+    }
+}
+
+// 受信した1バイトを処理する
+int Tele_input(uint8_t c)
+{
+    tele_param_t req;
+
+    if(rx.state == 0 && c != TELE_SYNC0)    // フレームの外の文字はコマンドとして呼び出し元で処理する
+        return 0;
+
+    if(Tele_parse(&rx, c))
+    {
+        switch(rx.type)
+        {
+            case TELE_TYPE_PARAM_GET:
+            case TELE_TYPE_PARAM_SET:
+                if(rx.len != sizeof(req))
+                    break;
+                memcpy(&req, rx.payload, sizeof(req));
+                Param_request(rx.type, &req);
+                break;
+            case TELE_TYPE_PARAM_LIST:
+                Param_request(rx.type, NULL);
+                break;
+            default:
+                break;
+        }
+    }
+    return 1;
+}
+
+#endif
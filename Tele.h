@@ -0,0 +1,132 @@
+#ifndef INCLUDED_Tele_h_
+#define INCLUDED_Tele_h_
+
+// Bluetoothテレメトリ(走行データのバイナリ送信)
+// 優先度が最低のタスク(tele_task)が、走行データのスナップショットを数周期に1回フレームに詰めてBluetoothに書き込む
+// 書き込みが詰まっても待たされるのはこのタスクだけで、周期ハンドラ・各区間のループには影響しない(送れなかった周期は間引かれる)
+// 同じ形式のフレームで、ホストからパラメータの取得・変更要求を受け付け(Param.h)、応答を返す
+// *フレームの組み立て・切り出しはホスト側のツール(tools/tele_recv.cなど)と共有する
+//  ツールはTELE_HOSTを定義してTele.cをビルドするため、TELE_HOSTを定義した場合はev3api.hに依存させないこと
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* マクロ定義 */
+#ifndef TELE_PERIOD_MS
+#define TELE_PERIOD_MS      50          // 送信周期[ms]の初期値(制御周期の整数倍に切り上げる。Tele_setPeriodで変更できる)
+#endif
+#define TELE_POLL_MS        10          // 送信タスクの起動周期[ms](パラメータ要求への応答の遅れはこれ以下)
+
+#define TELE_SYNC0          0xA5        // フレーム先頭の同期バイト
+#define TELE_SYNC1          0x5A
+#define TELE_HEADER_SIZE    5           // 同期バイト2 + 種類 + 通し番号 + ペイロード長
+#define TELE_CRC_SIZE       2           // CRC-16/CCITT(種類からペイロードの最後まで、リトルエンディアン)
+#define TELE_PAYLOAD_MAX    64          // ペイロードの最大長
+#define TELE_FRAME_MAX      (TELE_HEADER_SIZE + TELE_PAYLOAD_MAX + TELE_CRC_SIZE)
+
+/* フレームの種類 */
+enum {
+    TELE_TYPE_RUN       = 1,    // 走行データ(tele_run_t)                 EV3 -> ホスト
+    TELE_TYPE_PARAM_GET = 2,    // パラメータの取得要求(tele_param_t)       ホスト -> EV3
+    TELE_TYPE_PARAM_SET = 3,    // パラメータの変更要求(tele_param_t)       ホスト -> EV3
+    TELE_TYPE_PARAM_LIST= 4,    // 全パラメータの取得要求(ペイロードなし)   ホスト -> EV3
+    TELE_TYPE_PARAM_ACK = 5     // 要求への応答(tele_param_t)               EV3 -> ホスト
+};
+
+/* パラメータ要求への応答の結果 */
+enum {
+    TELE_PARAM_OK       = 0,    // 成功(変更要求の場合は反映済み)
+    TELE_PARAM_UNKNOWN  = 1,    // 名前が見つからない
+    TELE_PARAM_RANGE    = 2     // 値が範囲外のため変更しなかった
+};
+
+#define TELE_PARAM_NAME_LEN 12  // パラメータ名の最大長(終端文字を含まない場合がある)
+
+/* 走行データのペイロード(40byte) *Log.hと同様に、型のサイズと並びを固定するためrun_data_tを詰め替える */
+typedef struct {
+    uint32_t    time;           // 走行時間(period_ms単位)
+    float       distance;       // [mm]
+    float       direction;      // [deg]
+    int16_t     x;              // 位置[mm]
+    int16_t     y;
+    int16_t     heading;        // 向き[0.01deg]
+    int16_t     speed;          // 速度[mm/s]
+    int16_t     curvature;      // 曲率[1/km](= 1e-6/mm)
+    int16_t     turn;
+    int16_t     angle;
+    int16_t     sonar;
+    uint16_t    r;
+    uint16_t    g;
+    uint16_t    b;
+    int8_t      power_L;
+    int8_t      power_R;
+    uint8_t     color;          // 判定した色(COLOR_SET_LINEの判定条件)
+    uint8_t     sonar_conf;
+    uint8_t     period_ms;      // 制御周期[ms](CLOCK_PERIOD_MS)
+    uint8_t     reserved;
+} tele_run_t;
+
+/* パラメータの要求・応答のペイロード(24byte) */
+typedef struct {
+    char        name[TELE_PARAM_NAME_LEN];
+    float       value;          // 変更要求：設定する値 / 応答：現在の値
+    uint32_t    time;           // 応答：反映した時点の周期ハンドラの起動回数(Clock_getTicks)
+    uint8_t     op;             // 応答：要求の種類(TELE_TYPE_PARAM_*)
+    uint8_t     status;         // 応答：結果(TELE_PARAM_*)
+    uint8_t     index;          // 応答：パラメータの番号(全パラメータの取得要求では0 ~ count-1の順に返す)
+    uint8_t     count;          // 応答：パラメータの数
+} tele_param_t;
+
+/* フレームの切り出し(受信側) */
+typedef struct {
+    int         state;                      // 受信済みのバイト数(同期バイトを含む)
+    uint8_t     frame[TELE_FRAME_MAX];
+    uint8_t     type;                       // 切り出したフレームの種類
+    uint8_t     len;                        // 切り出したフレームのペイロード長
+    const uint8_t *payload;                 // 切り出したフレームのペイロード
+    uint32_t    frames;                     // 正しく受信したフレーム数
+    uint32_t    crc_errors;                 // CRCが一致しなかったフレーム数
+    uint32_t    skipped;                    // 同期を探すために読み飛ばしたバイト数
+    uint32_t    lost;                       // 通し番号の抜けから数えた、届かなかったフレーム数
+    int         pre_seq;                    // 前回の通し番号(-1は未受信)
+} tele_parser_t;
+
+/* 関数プロトタイプ宣言 */
+
+// ペイロードをフレームに詰め、フレーム長を返す(frameはTELE_FRAME_MAX以上の大きさにすること)
+uint32_t Tele_encode(uint8_t *frame, uint8_t type, const void *payload, uint8_t len);
+
+// 受信したバイト列からフレームを切り出す(1バイトずつ渡し、CRCの一致したフレームが揃った場合は1を返す)
+void     Tele_initParser(tele_parser_t *p);
+int      Tele_parse(tele_parser_t *p, uint8_t c);
+
+#ifndef TELE_HOST
+
+#include "ev3api.h"
+
+// 初期化(Bluetoothのファイルを開いた後に呼ぶ。送信は無効の状態で始まる)
+void     Tele_init(FILE *fp);
+
+// 送信の有効・無効を切り替える(bt_taskのコマンドから呼ぶ)
+void     Tele_enable(bool_t enable);
+bool_t   Tele_isEnabled(void);
+
+// 送信周期[ms]を設定・取得(制御周期の整数倍に切り上げる)
+void     Tele_setPeriod(uint16_t ms);
+uint16_t Tele_getPeriod(void);
+
+// 送信タスク：最新の走行データを1フレーム送信する(書き込みに失敗した場合は0を返す)
+int      Tele_send(void);
+
+// 送信タスク：パラメータ要求への応答を送り、送信周期が経過していれば走行データを送る(TELE_POLL_MSごとに呼ぶ)
+void     Tele_poll(void);
+
+// 受信タスク(bt_task)：受信した1バイトを渡す。フレームの一部だった場合は1、通常の文字(コマンド)の場合は0を返す
+int      Tele_input(uint8_t c);
+
+// 送信したフレーム数を取得
+uint32_t Tele_getSent(void);
+
+#endif
+
+#endif
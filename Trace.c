@@ -0,0 +1,103 @@
+#include "Trace.h"
+#include "Log.h"
+
+/* マクロ定義 */
+#define TRACE_MASK      (TRACE_BUF_EVENTS - 1)
+
+/* グローバル宣言 */
+// 生産者(メインタスク)1つ、消費者(書き込みタスク)1つのリングバッファ(Log.cと同じ構成)
+static trace_event_t buf[TRACE_BUF_EVENTS];
+static volatile uint32_t head = 0;  // 次に書き込む位置(生産者)
+static volatile uint32_t tail = 0;  // 次に読み出す位置(消費者)
+static volatile uint32_t dropped = 0;
+
+static const char *const names[TNUM_TRACE] = { TRACE_EVENTS(TRACE_NAME) };
+
+/* 関数 */
+
+// レコードを1つ積む(満杯の場合は書き込みを待たずに破棄)
+static void Trace_push(uint32_t time, trace_id_t id, uint8_t phase, int32_t arg0, int32_t arg1)
+{
+    trace_event_t *e;
+    uint32_t h = head;
+
+    if(h - tail >= TRACE_BUF_EVENTS)
+    {
+        dropped++;
+        return;
+    }
+    e = &buf[h & TRACE_MASK];
+    e->time     = time;
+    e->id       = id;
+    e->phase    = phase;
+    e->reserved = 0;
+    e->arg0     = arg0;
+    e->arg1     = arg1;
+    head = h + 1;                       // レコードを書き込んでから位置を進める
+}
+
+// 初期化
+void Trace_init(void)
+{
+    head = 0;
+    tail = 0;
+    dropped = 0;
+}
+
+uint32_t Trace_now(void)
+{
+    return (uint32_t)fch_hrt();
+}
+
+void Trace_event(trace_id_t id, uint8_t phase, int32_t arg0, int32_t arg1)
+{
+    Trace_push(Trace_now(), id, phase, arg0, arg1);
+}
+
+// 開始時刻から現在までの区間(待機など)
+void Trace_span(trace_id_t id, uint32_t start, int32_t arg)
+{
+    Trace_push(start, id, TRACE_PH_COMPLETE, arg, (int32_t)(Trace_now() - start));
+}
+
+// 区間内の状態遷移(変換時に区間ごとの値の推移として表示される)
+void Trace_state(trace_id_t section, int32_t state)
+{
+    Trace_push(Trace_now(), TRACE_STATE, TRACE_PH_COUNTER, section, state);
+}
+
+// マーカー(走行ログの区切りにもなるため、tools/log_analyzeで区切りごとに集計できる)
+void Trace_mark(trace_id_t id, int32_t arg)
+{
+    Trace_push(Trace_now(), id, TRACE_PH_INSTANT, arg, 0);
+    Log_stamp(names[id]);
+}
+
+// 溜まったレコードをブロック単位で書き込む
+uint32_t Trace_flush(FILE *fp, int all)
+{
+    uint32_t written = 0;
+    uint32_t n;
+
+    while(1)
+    {
+        n = head - tail;                            // 書き込み可能なレコード数
+        if(!all)
+            n -= n % TRACE_BLOCK_EVENTS;                // ブロック単位に切り捨て
+        if(n > TRACE_BUF_EVENTS - (tail & TRACE_MASK))
+            n = TRACE_BUF_EVENTS - (tail & TRACE_MASK); // バッファ末尾で折り返すため分割
+        if(n == 0)
+            break;
+
+        fwrite(&buf[tail & TRACE_MASK], sizeof(trace_event_t), n, fp);
+        tail += n;                                  // 書き込み後に位置を進める
+        written += n;
+    }
+    return written;
+}
+
+// 破棄されたレコード数を取得
+uint32_t Trace_getDropped(void)
+{
+    return dropped;
+}
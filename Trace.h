@@ -0,0 +1,97 @@
+#ifndef INCLUDED_Trace_h_
+#define INCLUDED_Trace_h_
+
+// イベントトレース
+// 区間の開始・終了、状態遷移、マーカー(色)の検知、制御周期の待機などを、番号と高分解能タイマの時刻[us]・小さな引数だけで記録する
+// 記録は固定長のレコードをリングバッファに積むだけで(文字列の整形・ファイル操作はしない)、SDカードへの書き込みは書き込みタスクが行う
+// 書き出したファイル(Trace.bin)はtools/trace_exportでChrome trace / Perfetto用のJSONに変換できる
+// *記録(Trace_*)はメインタスクのみから呼ぶこと(生産者1つ、消費者1つのリングバッファ)
+//  ただしメインタスクを終了させた後の停止処理(app.cのstop_save)からは呼んでよい。周期ハンドラからは呼ばないこと
+// *ホスト側の変換ツール(tools/trace_export.c)からもインクルードするため、TRACE_HOSTを定義した場合はev3api.hに依存させないこと
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* マクロ定義 */
+#define TRACE_MAGIC         0x52545048u // ファイル先頭の識別子("HPTR")
+#define TRACE_VERSION       1           // レコード形式のバージョン
+
+#define TRACE_BUF_EVENTS    1024        // リングバッファのレコード数(2のべき乗にすること)
+#define TRACE_BLOCK_EVENTS  32          // 一度に書き込むレコード数(16byte * 32 = 512byte *SDカードのセクタ長)
+
+/* イベントの一覧(番号, 表示名) *番号はファイルに記録されるため、追加は末尾に行うこと */
+#define TRACE_EVENTS(X) \
+    X(TRACE_WAIT,       "Clock_wait")       /* 制御周期の待機(X : 引数は経過周期数) */ \
+    X(TRACE_LINETRACE,  "Linetrace")        /* 区間(B/E) */ \
+    X(TRACE_SLALOM,     "Slalom") \
+    X(TRACE_BLOCK,      "Block") \
+    X(TRACE_STATE,      "state")            /* 区間内の状態遷移(C : 引数は区間のイベント番号, 状態) */ \
+    X(TRACE_BLUE,       "Blue detected")    /* マーカー(i : 引数は走行距離[mm]) */ \
+    X(TRACE_YELLOW,     "Yellow detected") \
+    X(TRACE_RED,        "Red detected") \
+    X(TRACE_DISTANCE,   "Reached distance") \
+    X(TRACE_LINE,       "Back to line") \
+    X(TRACE_SHUTDOWN,   "Shutdown") \
+    X(TRACE_TRACTION,   "Traction")         /* 車輪の空転・停止の検知(C : Trace_stateの区間として使う) */ \
+    X(TRACE_CLIMB_TIMEOUT, "Climb timeout") /* 段差を上りきれずに打ち切った(i) */
+
+#define TRACE_ENUM(id, name)    id,
+#define TRACE_NAME(id, name)    name,
+
+typedef enum {
+    TRACE_EVENTS(TRACE_ENUM)
+    TNUM_TRACE
+} trace_id_t;
+
+/* レコードの種類(Chrome traceのphと同じ文字) */
+enum {
+    TRACE_PH_BEGIN      = 'B',  // 区間の開始
+    TRACE_PH_END        = 'E',  // 区間の終了
+    TRACE_PH_COMPLETE   = 'X',  // 長さを持つ区間(timeは開始時刻、arg1は長さ[us])
+    TRACE_PH_INSTANT    = 'i',  // 瞬間のイベント
+    TRACE_PH_COUNTER    = 'C'   // 値の変化(状態遷移)
+};
+
+/* ファイルヘッダ(16byte) */
+typedef struct {
+    uint32_t    magic;          // TRACE_MAGIC
+    uint16_t    version;        // TRACE_VERSION
+    uint16_t    event_size;     // sizeof(trace_event_t)
+    uint32_t    time_us;        // timeの1単位あたりの時間[us]
+    uint32_t    reserved;
+} trace_header_t;
+
+/* レコード(16byte) */
+typedef struct {
+    uint32_t    time;           // 高分解能タイマの時刻[us](fch_hrt)
+    uint16_t    id;             // trace_id_t
+    uint8_t     phase;          // TRACE_PH_*
+    uint8_t     reserved;
+    int32_t     arg0;
+    int32_t     arg1;
+} trace_event_t;
+
+/* 関数プロトタイプ宣言 */
+#ifndef TRACE_HOST
+
+#include "ev3api.h"
+
+// 初期化(ファイルを開いた直後に呼ぶ)
+void     Trace_init(void);
+
+// 記録側(メインタスク)
+void     Trace_event(trace_id_t id, uint8_t phase, int32_t arg0, int32_t arg1);  // 現在時刻でレコードを1つ積む
+void     Trace_span(trace_id_t id, uint32_t start, int32_t arg);     // 開始時刻start[us]から現在までの区間を積む
+void     Trace_state(trace_id_t section, int32_t state);             // 区間内の状態遷移を積む
+void     Trace_mark(trace_id_t id, int32_t arg);                     // マーカーを積み、走行ログ(Log.h)にも区切りとして名前を記録する
+uint32_t Trace_now(void);                                            // 現在時刻[us](Trace_spanの開始時刻用)
+
+// 書き込み側(書き込みタスク)：溜まったレコードをブロック単位で書き込む(allが真の場合は端数も書き込む)
+uint32_t Trace_flush(FILE *fp, int all);
+
+// 書き込みに間に合わず破棄されたレコード数を取得
+uint32_t Trace_getDropped(void);
+
+#endif
+
+#endif
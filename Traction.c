@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include "Traction.h"
+
+/* マクロ定義 */
+#define HOLD_TICKS      CLOCK_TICKS(TRACTION_HOLD_MS)
+#define SETTLE_TICKS    CLOCK_TICKS(TRACTION_SETTLE_MS)
+
+/* 関数 */
+
+// 出力から見込んだ回転速度に対する実際の回転速度の割合(出力が小さい場合は判定しないため1.0)
+static float Traction_ratio(const traction_t *t, int32_t counts, float dt, int8_t power)
+{
+    if(power > -TRACTION_MIN_POWER && power < TRACTION_MIN_POWER)
+        return 1.0;
+    return counts / dt / (power * t->dps_per_power);
+}
+
+// 初期化
+void Traction_init(traction_t *t)
+{
+    t->pos = 0;
+    t->num = 0;
+    t->dps_per_power = TRACTION_DPS_PER_POWER;
+    t->learn = false;
+    t->settle_L = 0;
+    t->settle_R = 0;
+    t->settle = 0;
+    t->ratio_L = 1.0;
+    t->ratio_R = 1.0;
+    t->tilt_rate = 0.0;
+    t->hold = 0;
+    t->candidate = TRACTION_OK;
+    t->state = TRACTION_OK;
+}
+
+// 回転速度のモデルの補正を有効・無効にする
+void Traction_learn(traction_t *t, bool_t on)
+{
+    t->learn = on;
+}
+
+// 段差で傾いている途中かどうか
+bool_t Traction_isTilting(const traction_t *t)
+{
+    return (t->tilt_rate > TRACTION_TILT_RATE || t->tilt_rate < -TRACTION_TILT_RATE);
+}
+
+// 状態を更新
+traction_state_t Traction_update(traction_t *t, const run_data_t *run)
+{
+    uint8_t last = (t->pos + TRACTION_WINDOW - 1) % TRACTION_WINDOW;   // 前回記録した位置
+    uint8_t old;
+    traction_state_t cur = TRACTION_OK;
+    float dt, ratio;
+
+    if(t->num > 0 && t->tick[last] == run->tick)    // 同じ周期の走行データ
+        return t->state;
+
+    t->counts_L[t->pos]    = run->counts_L;
+    t->counts_R[t->pos]    = run->counts_R;
+    t->angle[t->pos]       = run->angle;
+    t->angle_stamp[t->pos] = run->stamp[RUN_SRC_GYRO];
+    t->tick[t->pos]        = run->tick;
+    if(abs(run->power_L - t->settle_L) > TRACTION_SETTLE_POWER || abs(run->power_R - t->settle_R) > TRACTION_SETTLE_POWER)
+    {
+        t->settle_L = run->power_L;                 // 出力が変わった場合は基準とし直す
+        t->settle_R = run->power_R;
+        t->settle = 0;
+    }
+    else if(t->settle < SETTLE_TICKS)
+        t->settle++;
+    t->pos = (t->pos + 1) % TRACTION_WINDOW;
+    if(t->num < TRACTION_WINDOW)
+    {
+        t->num++;
+        return t->state;                            // 履歴が埋まるまでは判定しない
+    }
+
+    // 最も古い記録(old)から今回の記録(last)までの回転速度と傾きの速度を求める
+    old  = t->pos;
+    last = (t->pos + TRACTION_WINDOW - 1) % TRACTION_WINDOW;
+    dt = (t->tick[last] - t->tick[old]) * CLOCK_DT;
+    t->ratio_L = Traction_ratio(t, t->counts_L[last] - t->counts_L[old], dt, run->power_L);
+    t->ratio_R = Traction_ratio(t, t->counts_R[last] - t->counts_R[old], dt, run->power_R);
+    if(t->angle_stamp[last] != t->angle_stamp[old])  // 傾きはジャイロセンサーを読み出した周期の差で求める(計測元ごとの周期 *Run.h)
+        t->tilt_rate = (t->angle[last] - t->angle[old]) / ((t->angle_stamp[last] - t->angle_stamp[old]) * CLOCK_DT);
+
+    if(t->ratio_L > TRACTION_SPIN_RATIO || t->ratio_R > TRACTION_SPIN_RATIO)
+        cur = TRACTION_SLIP;
+    else if(t->ratio_L < TRACTION_STALL_RATIO && t->ratio_R < TRACTION_STALL_RATIO)
+        cur = TRACTION_STALL;
+
+    // 平らな場所で左右とも判定した場合は、回転速度の割合が1になるようモデルを補正する(電池の電圧などによる差)
+    if(t->learn && cur == TRACTION_OK && t->settle >= SETTLE_TICKS && !Traction_isTilting(t)
+       && (run->power_L <= -TRACTION_MIN_POWER || TRACTION_MIN_POWER <= run->power_L)
+       && (run->power_R <= -TRACTION_MIN_POWER || TRACTION_MIN_POWER <= run->power_R))
+    {
+        ratio = (t->ratio_L + t->ratio_R) / 2.0;
+        t->dps_per_power += t->dps_per_power * (ratio - 1.0) * (CLOCK_DT / (TRACTION_LEARN_MS / 1000.0 + CLOCK_DT));
+        if(t->dps_per_power < TRACTION_DPS_MIN) t->dps_per_power = TRACTION_DPS_MIN;
+        if(t->dps_per_power > TRACTION_DPS_MAX) t->dps_per_power = TRACTION_DPS_MAX;
+    }
+
+    // 同じ判定がHOLD_TICKS続いた場合に状態を確定する
+    if(cur != t->candidate)
+    {
+        t->candidate = cur;
+        t->hold = 0;
+    }
+    if(t->hold < HOLD_TICKS)
+        t->hold++;
+    if(t->hold >= HOLD_TICKS)
+        t->state = cur;
+
+    return t->state;
+}
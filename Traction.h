@@ -0,0 +1,79 @@
+#ifndef INCLUDED_Traction_h_
+#define INCLUDED_Traction_h_
+
+#include "ev3api.h"
+#include "Run.h"
+
+// 車輪の空転・停止(グリップの喪失)と段差による傾きの検知
+// 直近TRACTION_WINDOW_MSの車輪の回転速度を、モーター出力から見込んだ回転速度と比べる
+//  停止(STALL) : 出力を与えているのに左右の車輪がほとんど回らない(段差の角に車輪が当たっている、出力が足りないなど)
+//  空転(SLIP)  : 車輪が見込みより速く回る(接地していない・滑っている)
+// 同じ時間のジャイロセンサーの角度(傾き *Run.cのとおりピッチ軸)の変化から傾きの速度を求め、段差に乗り上げたことを検知する
+// *ジャイロセンサーは旋回を計測しないため、方位の差による旋回方向の滑りは判定しない
+// 各区間がtraction_tを1つずつ持ち、毎周期Run_getSnapshotで取得した走行データを渡す
+
+/* マクロ定義 */
+#define TRACTION_WINDOW_MS      50      // 回転速度・傾きの速度を求める時間[ms]
+#define TRACTION_WINDOW         (CLOCK_TICKS(TRACTION_WINDOW_MS) + 1)   // 保持する周期数
+#define TRACTION_HOLD_MS        60      // 状態を確定するまで条件が続く時間[ms](加減速直後の速度の遅れで誤検知しないため)
+#define TRACTION_DPS_PER_POWER  9.0     // モーター出力1あたりの車輪の回転速度の初期値[deg/s](走行中はTraction_learnで補正する)
+                                        //  *Lモーターの無負荷回転数160~170rpm(出力100で960~1020deg/s)から平地走行の負荷による低下(約1割)を見込んだ値
+                                        //   Profile.hのPROFILE_MM_PER_POWER(7.85mm/s、タイヤ直径100mmで9.0deg/s)と同じ前提。実機のログとはtools/log_analyze -mで照合する
+#define TRACTION_DPS_MIN        5.0     // 同補正の範囲[deg/s]
+#define TRACTION_DPS_MAX        12.0
+#define TRACTION_LEARN_MS       200     // 同補正の時定数[ms]
+#define TRACTION_SETTLE_MS      200     // 出力が変わってから補正を始めるまでの時間[ms](加減速中の速度の遅れを除く)
+#define TRACTION_SETTLE_POWER   2       // 出力の変化がこれ以下の場合は変わっていないとみなす(方位を保つ旋回量による増減)
+#define TRACTION_MIN_POWER      8       // これ未満の出力の車輪は判定しない
+#define TRACTION_STALL_RATIO    0.4     // 回転速度が見込みのこの割合未満の場合は停止とみなす
+#define TRACTION_SPIN_RATIO     1.4     // 回転速度が見込みのこの割合を超えた場合は空転とみなす
+#define TRACTION_TILT_RATE      30.0    // 傾きの速度がこれを超えた場合は段差で傾いているとみなす[deg/s]
+                                        //  *角度は1deg単位のため、TRACTION_WINDOW_MSで1degの変化(20deg/s)は誤差とみなす
+
+/* 状態 */
+typedef enum {
+    TRACTION_OK,        // 車輪の回転どおりに走行している(または判定できない)
+    TRACTION_STALL,     // 停止
+    TRACTION_SLIP,      // 空転
+    TNUM_TRACTION
+} traction_state_t;
+
+/* 検知器 */
+typedef struct {
+    int32_t  counts_L[TRACTION_WINDOW];     // 左右のモーターの回転角度の履歴[deg]
+    int32_t  counts_R[TRACTION_WINDOW];
+    int16_t  angle[TRACTION_WINDOW];        // ジャイロセンサーの角度の履歴[deg]
+    uint32_t angle_stamp[TRACTION_WINDOW];  // 同角度を読み出した周期(run_data_t.stamp[RUN_SRC_GYRO])
+    uint32_t tick[TRACTION_WINDOW];         // 履歴を記録した周期(run_data_t.tick)
+    uint8_t  pos;                           // 次に記録する位置
+    uint8_t  num;                           // 記録した数
+
+    float    dps_per_power;                 // モーター出力1あたりの車輪の回転速度[deg/s]
+    bool_t   learn;                         // dps_per_powerを補正するかどうか(Traction_learn)
+    int8_t   settle_L;                      // 出力が落ち着いているかを判定する基準の出力
+    int8_t   settle_R;
+    uint16_t settle;                        // 同基準から出力が変わらずに続いている周期数
+    float    ratio_L;                       // 回転速度 / 出力から見込んだ回転速度(判定しない場合は1.0)
+    float    ratio_R;
+    float    tilt_rate;                     // 傾きの速度[deg/s]
+    uint16_t hold;                          // 判定した状態が続いている周期数
+    traction_state_t candidate;             // 判定した状態(確定前)
+    traction_state_t state;                 // 確定した状態
+} traction_t;
+
+/* 関数プロトタイプ宣言 */
+
+// 初期化(履歴を消去して状態をTRACTION_OKにする。回転速度のモデルはTRACTION_DPS_PER_POWERに戻す)
+void             Traction_init(traction_t *t);
+
+// 走行データを1周期分渡して状態を更新し、確定した状態を返す(同じ周期の走行データを複数回渡した場合は更新しない)
+traction_state_t Traction_update(traction_t *t, const run_data_t *run);
+
+// 回転速度のモデルの補正を有効・無効にする
+// *平らな場所を一定の出力で走行している間のみ有効にすること(傾いている間・停止や空転と判定した間は有効でも補正しない)
+void             Traction_learn(traction_t *t, bool_t on);
+
+// 段差で傾いている途中かどうか(傾きの速度がTRACTION_TILT_RATEを超えている)
+bool_t           Traction_isTilting(const traction_t *t);
+
+#endif
@@ -20,6 +20,18 @@
 #include "app_Linetrace.h"
 #include "app_Slalom.h"
 #include "app_Block.h"
+#include "Log.h"
+#include "Prof.h"
+#include "Color.h"
+#include "Sonar.h"
+#include "Motor.h"
+#include "Motion.h"
+#include "Grid.h"
+#include "Course.h"
+#include "Tele.h"
+#include "Param.h"
+#include "Trace.h"
+#include "Line.h"
 // 追記終了-------------------------------------------------------------
 
 /* APIについて */
@@ -94,8 +106,13 @@ static FILE     *bt = NULL;     /* Bluetoothファイルハンドル */
 static FILE *outputfile;    // 出力ストリーム
 
 static int8_t logflag = 0;
+static volatile int8_t log_close_req = 0;  // ファイルを閉じる要求(書き込みタスク用)
 
-uint8_t cnt_cyc = 0;    // 周期ハンドラのタッチセンサ終了処理用
+static FILE *tracefile;     // イベントトレースの出力ストリーム(Trace.bin、走行開始から終了まで1つ)
+static volatile int8_t trace_close_req = 0;    // ファイルを閉じる要求(書き込みタスク用)
+static volatile int8_t stop_req = 0;    // 停止後の後処理の要求(周期ハンドラで停止した場合、書き込みタスクが後処理を行う)
+
+uint16_t cnt_cyc = 0;   // 周期ハンドラのタッチセンサ終了処理用(押されている周期数)
 // 追記終了-------------------------------------------------------------
 
 /* 下記のマクロは個体/環境に合わせて変更する必要があります */
@@ -108,6 +125,10 @@ uint8_t cnt_cyc = 0;    // 周期ハンドラのタッチセンサ終了処理
 //#define DEVICE_NAME     "ET0"  /* Bluetooth名 sdcard:\ev3rt\etc\rc.conf.ini LocalNameで設定 */
 //#define PASS_KEY        "1234" /* パスキー    sdcard:\ev3rt\etc\rc.conf.ini PinCodeで設定 */
 #define CMD_START         '1'    /* リモートスタートコマンド */
+#define CMD_TELEMETRY     't'    /* テレメトリ送信の開始/停止コマンド */
+
+/* ログ書き込みタスクの起動周期 */
+#define LOG_FLUSH_PERIOD  (50 * 1000U) /* 50msec(5ms周期で10レコード分) */
 
 /* LCDフォントサイズ */
 #define CALIB_FONT (EV3_FONT_SMALL)
@@ -123,9 +144,13 @@ static void _log(char* text);
 
 // 追記箇所-------------------------------------------------------------
 static void log_open(char* filename);
+static void log_close(void);
+static void trace_open(void);
+static void trace_close(void);
+static void prof_save(void);
+static void stop_save(void);
+static bool_t start_ready(void);
 
-// void log_stamp(char *stamp);     // Run.hでextern宣言
-// extern宣言の記述について：https://www.khstasaba.com/?p=849
 // 追記終了-------------------------------------------------------------
 
 /* メインタスク */
@@ -169,26 +194,38 @@ void main_task(intptr_t unused)
     ev3_motor_config(tale_motor, MEDIUM_MOTOR);     // 後部の尻尾
     // 追記終了-------------------------------------------------------------
 
+    Line_init();            // ラインのずれの換算表を作成
+    Linetrace_initParam();  // Bluetoothから調整するパラメータを登録
+    Line_initParam();
+
     if (_bt_enabled)
     {
         /* Open Bluetooth file */
         bt = ev3_serial_open_file(EV3_SERIAL_BT);
         assert(bt != NULL);
 
+        Tele_init(bt);      // テレメトリ(送信は't'コマンドで開始)
+
         /* Bluetooth通信タスクの起動 */
         act_tsk(BT_TASK);
+        act_tsk(TELE_TASK);
     }
 
+    act_tsk(LOG_TASK);  // ログ書き込みタスクの起動
+
     ev3_led_set_color(LED_ORANGE); /* 初期化完了通知 */
 
     _log("Go to the start, ready?");
     if (_SIM)   _log("Hit SPACE bar to start");
     else        _log("Tap Touch Sensor to start");
+    if (!_SIM)  _log("LEFT: calibrate black / RIGHT: calibrate white");
+    if (_SIM)   _log("Line: default white/black"); /* シミュレータでは測定しない(Bluetoothのwhite_r ~ black_bで変更できる) */
 
     if (_bt_enabled)
     {
         fprintf(bt, "Bluetooth Remote Start: Ready.\n", EV3_SERIAL_BT);
         fprintf(bt, "send '1' to start\n", EV3_SERIAL_BT);
+        fprintf(bt, "send 't' to start/stop telemetry\n");
     }
 
     /* スタート待機 */
@@ -198,14 +235,31 @@ void main_task(intptr_t unused)
 
         if (bt_cmd == 1)
         {
-            break; /* リモートスタート */
+            if (start_ready()) break; /* リモートスタート */
+            bt_cmd = 0;
         }
 
         if (ev3_touch_sensor_is_pressed(touch_sensor) == 1)
         {
-            break; /* タッチセンサが押された */
+            if (start_ready()) break; /* タッチセンサが押された */
+            while (ev3_touch_sensor_is_pressed(touch_sensor) == 1) tslp_tsk(10 * 1000U);
+        }
+
+        /* ラインの参照値の測定(センサーを黒または白の上に置いてボタンを押す) */
+        if (ev3_button_is_pressed(LEFT_BUTTON))
+        {
+            Line_calibrate(LINE_REF_BLACK);
+            _log("calibrated black");
+            while (ev3_button_is_pressed(LEFT_BUTTON)) tslp_tsk(10 * 1000U);
+        }
+        if (ev3_button_is_pressed(RIGHT_BUTTON))
+        {
+            Line_calibrate(LINE_REF_WHITE);
+            _log("calibrated white");
+            while (ev3_button_is_pressed(RIGHT_BUTTON)) tslp_tsk(10 * 1000U);
         }
 
+        Param_apply();  /* スタート前のパラメータ調整(周期ハンドラの起動前のためClock_waitは使えない) */
         tslp_tsk(10 * 1000U); /* 10msecウェイト */
     }
 
@@ -218,11 +272,17 @@ void main_task(intptr_t unused)
     // 追記箇所-------------------------------------------------------------
     // 初期化処理
     ev3_gyro_sensor_reset(gyro_sensor);     // ジャイロセンサーの初期化
+    Motor_init();                           // モーター出力のキャッシュを初期化
     Run_init();                             // 走行時間を初期化
-    Ctrl_initPID();                          // PID用変数の初期化
+    Prof_init();                            // 処理時間の計測値を初期化
+    Color_init();                           // 色判定の参照テーブルを作成
+    Sonar_init();                           // 超音波センサーのフィルタを初期化
+    Grid_init();                            // ブロック搬入区間の経路を探索
+    Course_init();                          // ライントレース区間の区間表を読み込む
 
     // タスク,ハンドラ起動処理
     // act_tsk(SHUTDOWN_TASK);     // タスク
+    trace_open();               // イベントトレース
     sta_cyc(CYC_DATALOG_TSK);   // 周期ハンドラ
     // 追記終了-------------------------------------------------------------
 
@@ -239,43 +299,49 @@ void main_task(intptr_t unused)
         switch(t_state)
         {
             case LINETRACE:
-                log_open("Log_Linetrace.txt");   // txtファイル出力処理
+                log_open("Log_Linetrace.bin");   // ログファイル出力処理
 
                 Ctrl_arm_up(100, true);     // 実機用
+                Trace_event(TRACE_LINETRACE, TRACE_PH_BEGIN, 0, 0);
                 section_Linetrace();        // スタート直後からタスク開始 -> スラローム手前の青ラインを検知してタスク終了
+                Trace_event(TRACE_LINETRACE, TRACE_PH_END, 0, 0);
 
                 t_state = SLALOM;           // スラローム区間へ移行
                 break;
 
             case SLALOM:
-                log_open("Log_Slalom.txt"); // txtファイル出力処理
+                log_open("Log_Slalom.bin"); // ログファイル出力処理
 
+                Trace_event(TRACE_SLALOM, TRACE_PH_BEGIN, 0, 0);
                 section_Slalom();           // ライントレース区間終了直後からタスク開始 -> スラローム板を降りた後、ラインに復帰してタスク終了
+                Trace_event(TRACE_SLALOM, TRACE_PH_END, 0, 0);
 
                 t_state = BLOCK;            // ブロック搬入区間へ移行
                 break;
 
             case BLOCK:
-                log_open("Log_Block.txt");  // txtファイル出力処理
+                log_open("Log_Block.bin");  // ログファイル出力処理
 
+                Trace_event(TRACE_BLOCK, TRACE_PH_BEGIN, 0, 0);
                 section_Block();            // スラローム区間終了直後からタスク開始 -> ブロックを運搬しつつ、ガレージに停車してタスク終了
+                Trace_event(TRACE_BLOCK, TRACE_PH_END, 0, 0);
 
+                prof_save();                // 処理時間の計測結果を出力
                 t_state = GOAL;             // 終了処理へ移行
                 break;
 
             case GOAL:
-                ev3_motor_stop(left_motor, true);
-                ev3_motor_stop(right_motor, true);
+                Motor_stop(left_motor, true);
+                Motor_stop(right_motor, true);
 
                 break;
 
             default:
                 break;
         }
-        tslp_tsk(4 * 1000U); /* 4msec周期起動 */
+        Clock_wait();        /* 制御周期ごとに起動 */
 
-        logflag = 0;        // ファイル書き込み停止フラグ(周期ハンドラ用)
-        fclose(outputfile); // txtファイル出力終了
+        log_close();        // ログファイル出力終了
     }
     /**
     * Main loop END ***********************************************************************************************************************************
@@ -285,13 +351,18 @@ void main_task(intptr_t unused)
     // タスク,ハンドラ終了処理
     // ter_tsk(SHUTDOWN_TASK);     // タスク
     stp_cyc(CYC_DATALOG_TSK);   // 周期ハンドラ
+    log_close();                // 書き込み途中のログを閉じる
+    trace_close();              // イベントトレースを閉じる
+    ter_tsk(LOG_TASK);          // ログ書き込みタスク
     // 追記終了-------------------------------------------------------------
 
-    ev3_motor_stop(left_motor, false);
-    ev3_motor_stop(right_motor, false);
+    Motor_stop(left_motor, false);
+    Motor_stop(right_motor, false);
 
     if (_bt_enabled)
     {
+        Tele_enable(false);
+        ter_tsk(TELE_TASK);
         ter_tsk(BT_TASK);
         fclose(bt);
     }
@@ -340,6 +411,8 @@ static int sonar_alert(void)
 // 返り値 : なし
 // 概要 : Bluetooth通信によるリモートスタート。 Tera Termなどのターミナルソフトから、
 //       ASCIIコードで1を送信すると、リモートスタートする。
+//       tを送信するとテレメトリ(走行データのバイナリ送信 Tele.h)を開始/停止する。受信はtools/tele_recvで行う。
+//       tools/tele_ctlから送ったパラメータの取得・変更要求(Param.h)も受け付ける。
 //*****************************************************************************
 void bt_task(intptr_t unused)
 {
@@ -348,15 +421,21 @@ void bt_task(intptr_t unused)
         if (_bt_enabled)
         {
             uint8_t c = fgetc(bt); /* 受信 */
+            if (Tele_input(c))  /* パラメータ調整などのフレーム(Tele.h)の一部 */
+                continue;
             switch(c)
             {
-            case '1':
+            case CMD_START:
                 bt_cmd = 1;
                 break;
+            case CMD_TELEMETRY:
+                Tele_enable(!Tele_isEnabled());
+                break;
             default:
                 break;
             }
-            fputc(c, bt); /* エコーバック */
+            if (!Tele_isEnabled())  /* テレメトリ送信中はバイナリのフレームに文字が混ざらないようエコーしない */
+                fputc(c, bt); /* エコーバック */
         }
     }
 }
@@ -394,28 +473,148 @@ static void _log(char *text){
 
 // 追記箇所-----------------------------------------------------------------------------------------------------------------------------------------
 
+// 走行を開始できるかどうかを返す関数
+    // 実機ではラインの参照値(Line.h)の白・黒を両方測定するまで開始しない(既定値はホストの模擬コースの値のため)
+static bool_t start_ready(void)
+{
+    if (_SIM || Line_isCalibrated())
+        return true;
+
+    _log("calibrate black/white first");
+    if (_bt_enabled && !Tele_isEnabled())   /* テレメトリ送信中はフレームに文字が混ざらないよう送らない */
+        fprintf(bt, "calibrate black (LEFT) and white (RIGHT) first\n");
+    return false;
+}
+
 // 引数filenameに入力した文字列のファイルを書き込み用にオープンする関数
     // 参考：https://ylb.jp/2006b/proc/fileio/fileoutput.html   https://9cguide.appspot.com/17-01.html
     // 出力先は \\wsl$\Ubuntu-20.04\home\ユーザー名\etrobo\hrp3\sdk\workspace\simdist\hamapoly\__ev3rtfs
     // vscode左側フォルダ欄の"hrp3"から探して右クリック→"Reveal in Explorer"または"ダウンロード"(メモ帳推奨)
     // *生成されたtxtファイルを削除すると次に実行したときにファイルが生成されなくなることがあった
+    // *ログはバイナリ形式(Log.h参照)。tools/log_decodeで従来のタブ区切り形式に変換できる
 static void log_open(char *filename)
 {
-    outputfile = fopen(filename, "w");  // ファイルを書き込み用にオープン
+    log_header_t header = { LOG_MAGIC, LOG_VERSION, sizeof(log_record_t), CLOCK_PERIOD_MS, 0 };
+
+    log_close();                        // 前のファイルが残っている場合は閉じる
+
+    outputfile = fopen(filename, "wb"); // ファイルを書き込み用にオープン
     if(outputfile == NULL)              // オープンに失敗した場合
     {
         printf("cannot open\n");            // エラーメッセージを出して
         exit(1);                            // 異常終了
     }
-    fprintf(outputfile, "R\tG\tB\tDistance\tDirection\tAngle\tPower_L\tPower_R\tTime\n");     // データの項目名をファイルに書き込み
+    fwrite(&header, sizeof(header), 1, outputfile);  // ファイルヘッダを書き込み
 
+    Log_init();     // リングバッファを初期化
     logflag = 1;    // ファイル書き込みフラグ
 }
 
-// 引数stampに入力した文字列をログに出力する関数
-void log_stamp(char *stamp)
+// ログファイルを閉じる関数(書き込みタスクが残りのレコードを書き込んでファイルを閉じるまで待機)
+static void log_close(void)
+{
+    logflag = 0;                        // ファイル書き込み停止フラグ(周期ハンドラ用)
+    if(outputfile == NULL)              // ファイルが開かれていない場合
+        return;
+
+    log_close_req = 1;                  // 書き込みタスクにファイルを閉じるよう要求
+    while(log_close_req)
+        tslp_tsk(4 * 1000U);            /* 4msecウェイト */
+}
+
+// 処理時間の計測結果をファイルに出力する関数(GOAL到達時、停止時に呼ぶ)
+static void prof_save(void)
+{
+    FILE *fp = fopen("Log_Prof.txt", "w");
+
+    if(fp == NULL)
+        return;
+    Prof_dump(fp);
+    Motor_dump(fp);                     // モーターのドライバ呼び出しを省略した回数
+    fclose(fp);
+}
+
+// タッチセンサで停止した後の後処理(計測結果の出力、停止の記録、ログとトレースを閉じる要求)
+// ファイル操作とトレースの記録を周期ハンドラで行わないよう、タスクから呼ぶ(メインタスクと周期ハンドラを止めた後)
+static void stop_save(void)
+{
+    prof_save();                        // 処理時間の計測結果を出力
+
+    Trace_mark(TRACE_SHUTDOWN, 0);      // メインタスクは終了しているためここから記録できる
+    Log_pushStamps();                   // 周期ハンドラが止まっているためここで積む
+    logflag = 0;                        // ファイル書き込みoff
+    log_close_req = 1;                  // 書き込みタスクに残りの書き込みとファイルを閉じる処理を要求
+    trace_close_req = 1;
+}
+
+// イベントトレースのファイル(Trace.bin)を開く関数(tools/trace_exportでChrome trace形式に変換できる)
+static void trace_open(void)
 {
-    fprintf(outputfile, stamp);
+    trace_header_t header = { TRACE_MAGIC, TRACE_VERSION, sizeof(trace_event_t), 1, 0 };
+
+    tracefile = fopen("Trace.bin", "wb");
+    if(tracefile == NULL)               // 開けない場合はトレースなしで走行する
+        return;
+    fwrite(&header, sizeof(header), 1, tracefile);
+    Trace_init();
+}
+
+// イベントトレースのファイルを閉じる関数(書き込みタスクが残りを書き込んで閉じるまで待機)
+static void trace_close(void)
+{
+    if(tracefile == NULL)
+        return;
+
+    trace_close_req = 1;
+    while(trace_close_req)
+        tslp_tsk(4 * 1000U);            /* 4msecウェイト */
+}
+
+// リングバッファに溜まったログをSDカードに書き込むタスク(優先度は最低)
+void log_task(intptr_t unused)
+{
+    while(1)
+    {
+        if(stop_req)                    // 周期ハンドラで停止した場合の後処理
+        {
+            stop_req = 0;
+            stop_save();
+        }
+        if(outputfile != NULL)
+        {
+            Log_flush(outputfile, log_close_req);   // 閉じる要求がある場合は端数も書き込む
+
+            if(log_close_req)
+            {
+                fclose(outputfile);                     // ログファイル出力終了
+                outputfile = NULL;
+                log_close_req = 0;
+            }
+        }
+        if(tracefile != NULL)
+        {
+            Trace_flush(tracefile, trace_close_req);    // イベントトレースも同様に書き込む
+
+            if(trace_close_req)
+            {
+                fclose(tracefile);
+                tracefile = NULL;
+                trace_close_req = 0;
+            }
+        }
+        tslp_tsk(LOG_FLUSH_PERIOD);
+    }
+}
+
+// 走行データとパラメータ要求への応答をBluetoothに送信するタスク(優先度は最低)
+// 送信周期(Tele_getPeriod)ごとに最新のスナップショットを送るだけなので、送信が詰まった分は間引かれ、制御側は待たされない
+void tele_task(intptr_t unused)
+{
+    while(1)
+    {
+        Tele_poll();
+        tslp_tsk(TELE_POLL_MS * 1000U);
+    }
 }
 
 // タッチセンサ押下でプログラムを終了するタスク
@@ -429,14 +628,11 @@ void shutdown_task(intptr_t unused)
         {
             ter_tsk(MAIN_TASK);                 // mainタスク終了
 
-            log_stamp("\n\n\tShutdown\n\n\n");
-            logflag = 0;                        // ファイル書き込みoff
-            fclose(outputfile);                 // txtファイル出力終了
-
             stp_cyc(CYC_DATALOG_TSK);           // 周期ハンドラ停止
+            stop_save();                        // 計測結果の出力とファイルを閉じる要求
 
-            ev3_motor_stop(left_motor, false);  // 停車
-            ev3_motor_stop(right_motor, false);
+            Motor_stop(left_motor, false);      // 停車
+            Motor_stop(right_motor, false);
 
             ext_tsk();
         }
@@ -450,51 +646,61 @@ void shutdown_task(intptr_t unused)
     }
 }
 
-// 5msごとに計測値の更新を行う周期ハンドラ (*シミュレータの場合、4ms以下の周期起動にするとtimescaleが1を下回ることがある)
+// 制御周期(Clock.hのCLOCK_PERIOD_MS、初期値5ms)ごとに計測値の更新を行う周期ハンドラ (*シミュレータの場合、4ms以下の周期起動にするとtimescaleが1を下回ることがある)
     // タスク・周期ハンドラについて(各種計測値の更新などに利用)：https://qiita.com/koushiro/items/22a10c7dd451291fd95b , https://qiita.com/yamanekko/items/7ddb6029820d3cfbd583
     // 上記機能APIの名称・仕様と変更点                        ：https://dev.toppers.jp/trac_user/ev3pf/wiki/FAQ *(Q：周期的な処理を追加するためには~ Q：タスクの優先度を変更するには~)
     // もっと詳しいやつ                                       ：https://www.tron.org/ja/page-722/
     // CRE_CYCの記述については workspace > periodic-task を参考
 void datalog_cyc(intptr_t unused)
 {
-    int32_t cur_angle = ev3_motor_get_counts(arm_motor);    // 現在のモーター角度
+    int32_t cur_angle;
+    log_record_t record;
+
+    Prof_enter(PROF_DATALOG);   // 処理時間の計測開始
+
+    cur_angle = ev3_motor_get_counts(arm_motor);    // 現在のモーター角度
 
     Run_update();       // 時間、RGB値、位置角度を更新
+    Motion_update();    // キューに積まれた走行命令を1周期分実行
+    Clock_tick();       // 時刻を進め、Clock_waitで待機中の区間のループを起こす
 
     if(logflag == 1)    // ファイル書き込みフラグを確認
     {
-        fprintf(outputfile, "%d\t%d\t%d\t%8.3f\t%9.1f\t%4d\t%4d\t%4d\t%6dms\t%d\n", // txtファイル書き込み処理
-        Run_getRGB_R(),
-        Run_getRGB_G(),
-        Run_getRGB_B(),
-        Run_getDistance(),
-        Run_getDirection(),
-        Run_getAngle(),
-        Run_getPower_L(),
-        Run_getPower_R(),
-        Run_getTime() * 5,
-        cur_angle
-        );
+        Log_pushStamps();                   // 予約されたスタンプを先に積む
+
+        record.data.type      = LOG_TYPE_DATA;  // 計測値をバイナリのレコードに詰めてリングバッファに積む(書き込みはlog_taskが行う)
+        record.data.power_L   = Run_getPower_L();
+        record.data.power_R   = Run_getPower_R();
+        record.data.reserved  = 0;
+        record.data.r         = Run_getRGB_R();
+        record.data.g         = Run_getRGB_G();
+        record.data.b         = Run_getRGB_B();
+        record.data.angle     = Run_getAngle();
+        record.data.distance  = Run_getDistance();
+        record.data.direction = Run_getDirection();
+        record.data.time      = Run_getTime();
+        record.data.arm_angle = cur_angle;
+        record.data.reserved2 = 0;
+        Log_push(&record);
     }
 
     // タッチセンサによる停止処理(実機でタスクが機能しない問題を解決できていないため、タッチセンサで実機を停止させたい場合はこの処理をコメント解除する)
-    if(!ev3_touch_sensor_is_pressed(touch_sensor) && cnt_cyc > 50)
+    if(!ev3_touch_sensor_is_pressed(touch_sensor) && cnt_cyc > CLOCK_TICKS(250))
     {
         ter_tsk(MAIN_TASK);                 // mainタスク終了
 
-        log_stamp("\n\n\tShutdown\n\n\n");
-        logflag = 0;                        // ファイル書き込みoff
-        fclose(outputfile);                 // txtファイル出力終了
-
-        ev3_motor_stop(left_motor, false);  // 停車
-        ev3_motor_stop(right_motor, false);
+        Motor_stop(left_motor, false);      // 停車
+        Motor_stop(right_motor, false);
 
         stp_cyc(CYC_DATALOG_TSK);           // 周期ハンドラ停止
+        stop_req = 1;                       // ファイル操作とトレースの記録は書き込みタスクに任せる(stop_save)
     }
-    if(ev3_touch_sensor_is_pressed(touch_sensor) && cnt_cyc < 100)
+    if(ev3_touch_sensor_is_pressed(touch_sensor) && cnt_cyc < CLOCK_TICKS(500))
         cnt_cyc++;
     else if(!ev3_touch_sensor_is_pressed(touch_sensor))
         cnt_cyc = 0;
+
+    Prof_exit(PROF_DATALOG);    // 処理時間の計測終了
 }
 
 // 追記終了-----------------------------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
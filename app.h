@@ -76,6 +76,10 @@ extern "C" {
 #define STACK_SIZE      4096        /* タスクのスタックサイズ */
 #endif /* STACK_SIZE */
 
+// 追記箇所-------------------------------------------------------------
+#include "Clock.h"                  /* 制御周期(周期ハンドラの周期 CLOCK_PERIOD_US) */
+// 追記終了-------------------------------------------------------------
+
 /*
  *  関数のプロトタイプ宣言
  */
@@ -87,7 +91,9 @@ extern void bt_task(intptr_t exinf);
 // 追記箇所-------------------------------------------------------------
 extern void shutdown_task(intptr_t exinf);  // Mainタスクに並行して(=Mainタスクのスリープ中に)実行される測定値書き込み関数
 
-extern void datalog_cyc(intptr_t);          // 周期ハンドラによって5msごとに計測値の更新を行う関数
+extern void datalog_cyc(intptr_t);          // 周期ハンドラによって制御周期(Clock.h)ごとに計測値の更新を行う関数
+extern void log_task(intptr_t exinf);       // 周期ハンドラが積んだログをSDカードに書き込むタスク
+extern void tele_task(intptr_t exinf);      // 走行データをBluetoothに送信するタスク
 // 追記終了-------------------------------------------------------------
 
 #endif /* TOPPERS_MACRO_ONLY */
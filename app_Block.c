@@ -1,20 +1,56 @@
 #include "app_Block.h"
 
 /* マクロ定義 */
+#define KP      1.38    // PIDゲイン(ブロック搬入区間(power10~50)用。R値の偏差に対する値で、目標値でのLine_rPerOffsetを掛けて使う *Line.h)
+#define KI      0.0
+#define KD      0.15
+
+// 赤ラインから黒ラインへの復帰に経路計画(Grid.c)を使うかどうか
+// 0 : 実機で調整した走行(距離と方位で区切った円弧)。1 : GRID_ROUTE_RETURNの経路を走行
+// *Grid.cの地図は実測前の見積もりのため、実測した地図で確かめるまでは0にしておくこと
+#define USE_GRID_ROUTE  0
+
+#define ROUTE_POWER     40  // 経路走行時のモーター出力
+#define ROUTE_TURN_MAX  60  // 経路走行時の旋回値の上限
 
 /* グローバル変数 */
-static const sensor_port_t
-    sonar_sensor    = EV3_PORT_3;
+static pid_ctrl_t pid;      // ブロック搬入区間用のPID制御器
+static int16_t trace_r;         // ゲインを換算した目標値(R値 *_traceを参照)
+static uint32_t trace_version;  // 同換算をしたときのパラメータの変更回数
 
 /* 関数 */
+//*****************************************************************************
+// 関数名 : Block_trace
+// 引数 : offset (ラインのエッジからのずれ[0.1mm]), r (R値で調整した目標値)
+// 返り値 : 旋回値
+// 概要 : 目標値rでライントレースする旋回値をPID制御で求める
+//       R値で調整したゲインは目標値rの付近のR値の傾きで換算する(目標値・参照値が変わった場合のみ換算し直す *Line.h)
+//*****************************************************************************
+static int16_t Block_trace(int16_t offset, int16_t r)
+{
+    float k;
+
+    if(r != trace_r || Param_getVersion() != trace_version)
+    {
+        k = Line_rPerOffset(r);
+        Pid_setGains(&pid, KP * k, KI * k, KD * k);
+        trace_r = r;
+        trace_version = Param_getVersion();
+    }
+    return Pid_update(&pid, offset, Line_offsetFromR(r));
+}
+
 void section_Block()
 {
     /* ローカル変数 */
+    run_data_t run;     // 走行データ(1周期分の値の一式)
     float temp = 0.0;       // 走行距離、方位の一時保存用
+#if USE_GRID_ROUTE
+    uint32_t route = 0;     // 経路の最後の命令番号
+#endif
 
     int8_t flag = 0;
 
-    int8_t power = 0;   // モーターの出力値を格納する変数(-100 ~ +100)
     int16_t turn = 0;   // モーターによる旋回量を格納する変数(-200 ~ +200)
 
     /* 列挙 */
@@ -28,10 +64,12 @@ void section_Block()
         RETURN,
         END
     } r_state = PRE;
+    int pre_state = -1;     // 前回のループでの状態(トレース用)
 
     /* 初期化処理 */
     Run_init();         // 走行データを初期化
-    Ctrl_initPID();     // PIDの値を初期化
+    Pid_init(&pid, KP, KI, KD); // PIDの値を初期化(ゲインはBlock_traceで目標値ごとにずれに対する値に換算する)
+    trace_r = -1;
 
     /**
     * Main loop ****************************************************************************************************************************************
@@ -41,22 +79,31 @@ void section_Block()
         if(flag == 1)   // 終了フラグを確認
             break;      // メインループ終了
 
+        Prof_enter(PROF_BLOCK);   // 1周期の処理時間の計測開始
+        Run_getSnapshot(&run);    // この周期で使う走行データを一度に取得
+
+        if(r_state != pre_state)    // 状態が遷移した場合はトレースに記録
+        {
+            Trace_state(TRACE_BLOCK, r_state);
+            pre_state = r_state;
+        }
+
         switch(r_state)
         {
             case PRE: // 区間単体での練習用case *************************************************
-                turn = Ctrl_getTurn_PID(Run_getRGB_R(), 64);    // PID制御を用いて旋回値を取得
+                turn = Block_trace(run.offset, 64);    // PID制御を用いて旋回値を取得
                 Ctrl_motor_steer(20, turn);                       // 指定出力で走行
 
-                if(Run_getRGB_R() < 75 && Run_getRGB_G() < 95 && Run_getRGB_B() > 120) // 青色検知
+                if(run.color[COLOR_SET_BLOCK] == COLOR_BLUE) // 青色検知
                 {
-                    temp = Run_getDistance();
+                    temp = run.distance;
                     turn = 0;
                     r_state = START;
                 }
 
                 break;
             case START: // ********************************************************************
-                if(Run_getDirection() < 40)
+                if(run.direction < 40)
                 {
                     turn = Ctrl_getTurn_Change(73, 0.5);
                     Ctrl_motor_steer_alt(80, turn, 0.5);
@@ -67,20 +114,20 @@ void section_Block()
                     Ctrl_motor_steer(60, turn);
                 }
 
-                if(turn == 0 && Run_getDistance() > 200)
+                if(turn == 0 && run.distance > 200)
                     r_state = MOVE;
 
                 break;
 
             case MOVE: // *********************************************************************
-                if(Run_getRGB_R() > 90 && Run_getRGB_G() > 90 && Run_getRGB_B() < 30)  // 黄色検知
+                if(run.color[COLOR_SET_BLOCK] == COLOR_YELLOW)  // 黄色検知
                 {
-                    log_stamp("\n\n\tYellow detected\n\n\n");
+                    Trace_mark(TRACE_YELLOW, (int32_t)run.distance);
                     r_state = CURVE;
                 }
-                else if(Run_getDistance() > temp + 1000)              // もしくは指定距離に到達した場合
+                else if(run.distance > temp + 1000)              // もしくは指定距離に到達した場合
                 {
-                    log_stamp("\n\n\tReached ditance\n\n\n");
+                    Trace_mark(TRACE_DISTANCE, (int32_t)run.distance);
                     r_state = CURVE;
                 }
 
@@ -89,7 +136,7 @@ void section_Block()
             case CURVE:   // ********************************************************************
                 Ctrl_motor_steer_alt(50, 27, 0.1);                // 指定速度まで減速しつつ右曲がりに前進
 
-                if(Run_getRGB_R() < 60 && Run_getRGB_G() < 60 && Run_getRGB_B() < 60)  // 黒色検知
+                if(run.color[COLOR_SET_BLOCK] == COLOR_BLACK)  // 黒色検知
                 {
                     Ctrl_motor_steer(0, 0);                           // モーター停止
                     tslp_tsk(300 * 1000U);                      // 待機
@@ -100,23 +147,33 @@ void section_Block()
                 break;
 
             case LINE:  // ********************************************************************
-                turn = Ctrl_getTurn_PID(Run_getRGB_R(), 64);    // PID制御を用いて旋回値を取得
+                turn = Block_trace(run.offset, 64);    // PID制御を用いて旋回値を取得
                 Ctrl_motor_steer_alt(20, turn * -1, 0.5);         // 加速しつつライントレース走行
 
-                if(Run_getRGB_R() > 75 && Run_getRGB_G() < 40 && Run_getRGB_B() < 50)  //赤色検知
+                if(run.color[COLOR_SET_BLOCK] == COLOR_RED)  //赤色検知
                 {
-                    log_stamp("\n\n\tRed detected\n\n\n");
+                    Trace_mark(TRACE_RED, (int32_t)run.distance);
                     turn = 0;
-                    temp = Run_getDistance();
+                    temp = run.distance;
+#if USE_GRID_ROUTE
+                    Grid_setPose(1, 1, 0.0);                        // 赤ラインの位置を地図の基準にする
+                    route = Grid_pushRoute(GRID_ROUTE_RETURN, ROUTE_POWER, ROUTE_TURN_MAX); // 黒ラインの手前までの経路を積む
+#endif
                     r_state = RETURN;
                 }
 
                 break;
 
             case RETURN:   // ********************************************************************
-                if(Run_getDistance() < temp + 1100)      //1170
+#if USE_GRID_ROUTE
+                if(route != 0 && !Motion_isDone(route))     // 経路の走行中(モーターは周期ハンドラが操作する)
+                    break;
+
+                Ctrl_motor_steer_alt(15, 0, 0.1);           // 減速して直進
+#else
+                if(run.distance < temp + 1100)      //1170
                 {
-                    if(Run_getDirection() < 240)         //250
+                    if(run.direction < 240)         //250
                     {
                         turn = Ctrl_getTurn_Change(34, 0.3);       //42, 04
                         Ctrl_motor_steer_alt(50, turn, 0.4);
@@ -126,36 +183,35 @@ void section_Block()
                         turn = Ctrl_getTurn_Change(0, 0.4);
                         Ctrl_motor_steer(50, turn);
                     }
+                    break;                          // 指定距離に到達するまではラインを判定しない
                 }
-                else                                // 指定距離に到達した場合
-                {
-                    
-                    if(Run_getDirection() < 320)
-                    {
-                        turn = Ctrl_getTurn_Change(20, 0.3);           //90, 0.4
-                        Ctrl_motor_steer_alt(15, turn, 0.1);        // 減速して右曲がりに走行
-                    }
-                    else
-                    {
-                        Ctrl_motor_steer(15, 0);
-                    }
 
-                    if( Run_getRGB_R() < 60 && Run_getRGB_G() < 60 && Run_getRGB_B() < 60)         // 黒色検知
-                    {                    
-                        Ctrl_motor_steer(0,0);
-                        tslp_tsk(300 * 1000U);  // 待機
-                        Ctrl_runDirection(20, 200, 20);
-                        r_state = END;
-                        log_stamp("\n\n\nlinetrace\n\n\n");
-                    }
-                    else if(Run_getRGB_R() < 75 && Run_getRGB_G() < 95 && Run_getRGB_B() > 120)    // 青色検知
-                    {
-                        Ctrl_motor_steer(0,0);
-                        tslp_tsk(300 * 1000U);  // 待機
-                        Ctrl_runDirection(20, 200, 20);
-                        r_state = END;
-                        log_stamp("\n\n\nlinetrace\n\n\n");
-                    }
+                if(run.direction < 320)             // 指定距離に到達した場合
+                {
+                    turn = Ctrl_getTurn_Change(20, 0.3);           //90, 0.4
+                    Ctrl_motor_steer_alt(15, turn, 0.1);        // 減速して右曲がりに走行
+                }
+                else
+                {
+                    Ctrl_motor_steer(15, 0);
+                }
+#endif
+
+                if(run.color[COLOR_SET_BLOCK] == COLOR_BLACK)          // 黒色検知
+                {                    
+                    Ctrl_motor_steer(0,0);
+                    tslp_tsk(300 * 1000U);  // 待機
+                    Ctrl_runDirection(20, 200, 20);
+                    r_state = END;
+                    Trace_mark(TRACE_LINE, (int32_t)run.distance);
+                }
+                else if(run.color[COLOR_SET_BLOCK] == COLOR_BLUE)    // 青色検知
+                {
+                    Ctrl_motor_steer(0,0);
+                    tslp_tsk(300 * 1000U);  // 待機
+                    Ctrl_runDirection(20, 200, 20);
+                    r_state = END;
+                    Trace_mark(TRACE_LINE, (int32_t)run.distance);
                 }
                 break;
 
@@ -165,7 +221,7 @@ void section_Block()
                 {
                     Ctrl_motor_steer(20, 0);
                     
-                    if(ev3_ultrasonic_sensor_get_distance(sonar_sensor) <= 4)
+                    if(Run_getSonarRaw() <= 4)
                     {
                         Ctrl_motor_steer(0, 0);                       // ガレージの壁を検知して停車
                         flag = 1;                               // 終了フラグ
@@ -173,7 +229,7 @@ void section_Block()
                 }
                 else
                 {
-                    turn = Ctrl_getTurn_PID(Run_getRGB_R(), 48);    // PID制御を用いて旋回値を取得
+                    turn = Block_trace(run.offset, 48);    // PID制御を用いて旋回値を取得
                     Ctrl_motor_steer_alt(10, turn * -1, 0.5);         // 加速しつつライントレース走行
                 }
 
@@ -184,7 +240,9 @@ void section_Block()
             default:
                 break;
         }
-        tslp_tsk(4 * 1000U); /* 4msec周期起動 */
+        Prof_exit(PROF_BLOCK);    // 1周期の処理時間の計測終了
+
+        Clock_wait();        /* 制御周期ごとに起動 */
     }
     /**
     * Main loop END ************************************************************************************************************************************
@@ -2,6 +2,11 @@
 #define INCLUDED_Block_h_
 
 #include "Controller.h"
+#include "Prof.h"
+#include "Trace.h"
+#include "Grid.h"
+#include "Line.h"
+#include "Param.h"
 
 /* 関数プロトタイプ宣言 */
 void section_Block();
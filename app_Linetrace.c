@@ -2,31 +2,120 @@
 
 /* マクロ定義 */
 #define MOTOR_POWER     50  // モーターの出力値(-100 ~ +100)
-#define PID_TARGET_VAL  74  // PID制御におけるセンサRun_getRGB_R()の目標値 *参考 : https://qiita.com/pulmaster2/items/fba5899a24912517d0c5
+#define PID_TARGET_VAL  74  // PID制御におけるセンサRun_getRGB_R()の目標値(Line_offsetFromRでずれに換算して使う) *参考 : https://qiita.com/pulmaster2/items/fba5899a24912517d0c5
+#define END_TARGET_VAL  55  // 青ラインを検知した後の減速中の目標値(R値)
+
+// PID制御のゲイン(区間ごとに設定する)
+// 下記のPID値が走行に与える影響については次のサイトが参考になります https://www.tsone.co.jp/blog/archives/889
+// R値の偏差に対するゲイン。偏差はエッジからのずれ[0.1mm](Line.h)のため、目標値でのLine_rPerOffsetを掛けて使う
+#define KP      1.38    // sim_power100 1.68     //sim_power80-70 1.68     //実機_power50 1.38
+#define KI      0.0     // sim_power100 0.47?    //sim_power80-70 0.00     //実機_power50 0.00
+#define KD      0.15    // sim_power100 0.50     //sim_power80-70 0.30     //実機_power50 0.15
+
+#define FF_GAIN_MAX 0.9     // 曲率のフィードフォワードの倍率の上限(1未満 *下記のparam.ff_gainを参照)
+
+#define TREAD   145.0   // 車体トレッド幅[mm](Run.cと同じ値)
+#define EDGE    1       // 1でLコース、-1でRコース(Controller.cと合わせること)
+
+/* グローバル変数 */
+static pid_ctrl_t pid;      // ライントレース区間用のPID制御器
+
+// 調整用のパラメータ(初期値は上記のマクロ。区間の開始前にLinetrace_setParamで変更できる)
+static linetrace_param_t param = {
+    KP, KI, KD,         // PIDゲイン
+    PID_TARGET_VAL,     // PID制御の目標値
+    MOTOR_POWER,        // 開始時の出力
+    80,                 // 直線での出力(実機で走らせていた出力。上げる場合はBluetoothで調整した値を使う)
+    60,                 // 急カーブでの出力
+    0.7,                // 曲率のフィードフォワードの倍率
+    1800.0              // カーブで許容する横方向の加速度
+};
 
 /* 関数 */
+
+// 曲率[1/mm](右旋回が正)からCtrl_motor_steerのturn値に換算
+// turn値tでは内側の車輪が外側の(1 - t/100)倍になるため、曲率 = 2t / (トレッド幅 * (200 - t))
+static float Linetrace_turnFromCurvature(float curvature)
+{
+    float k = fabsf(curvature) * TREAD;
+    float t = 200.0 * k / (2.0 + k);
+
+    return (curvature < 0) ? -t : t;
+}
+
+// turn値から曲率に換算(Linetrace_turnFromCurvatureの逆)
+static float Linetrace_curvatureFromTurn(float turn)
+{
+    float t = Ctrl_math_limit(fabsf(turn), 0, 199);
+    float k = 2.0 * t / (TREAD * (200.0 - t));
+
+    return (turn < 0) ? -k : k;
+}
+
+// 曲率から出力を決める(横方向の加速度が許容値以下になる速度を、出力の上限・下限に収める)
+static int8_t Linetrace_powerFromCurvature(float curvature)
+{
+    float v = Profile_toPower(sqrtf(param.lat_accel / fmaxf(fabsf(curvature), 1.0e-6)));
+
+    return (int8_t)Ctrl_math_limit(v, param.power_slow, param.power_fast);
+}
+
+// パラメータを取得
+void Linetrace_getParam(linetrace_param_t *p)
+{
+    *p = param;
+}
+
+// パラメータを設定(次にsection_Linetraceを開始したときに反映される)
+void Linetrace_setParam(const linetrace_param_t *p)
+{
+    param = *p;
+}
+
+// パラメータを登録
+// Bluetoothからの変更は制御周期の境目に反映され、PIDゲインは走行中でもその周期から切り替わる(開始時の出力は次の開始時から)
+void Linetrace_initParam(void)
+{
+    Param_add("kp",     PARAM_FLOAT, &param.kp,         0, 10);
+    Param_add("ki",     PARAM_FLOAT, &param.ki,         0, 10);
+    Param_add("kd",     PARAM_FLOAT, &param.kd,         0, 10);
+    Param_add("target", PARAM_INT16, &param.target,     0, 255);
+    Param_add("power",  PARAM_INT8,  &param.power,      0, 100);
+    Param_add("fast",   PARAM_INT8,  &param.power_fast, 0, 100);
+    Param_add("slow",   PARAM_INT8,  &param.power_slow, 0, 100);
+    Param_add("ff",     PARAM_FLOAT, &param.ff_gain,    0, FF_GAIN_MAX);
+    Param_add("lat",    PARAM_FLOAT, &param.lat_accel,  100, 10000);
+}
+
 void section_Linetrace()
 {
     /* ローカル変数 */
+    run_data_t run;     // 走行データ(1周期分の値の一式)
 
     float temp = 0.0;   // 距離、方位の一時保存用
+    profile_t profile;  // 加減速用の速度プロファイル
+    course_t course;    // 区間表の実行状態
+    uint32_t pre_time = 0;  // 前回のループでの走行時間
+    uint32_t version = Param_getVersion();  // 反映済みのパラメータの変更回数
+    int pre_state = -1;     // 前回のループでの状態(トレース用)
+    uint32_t rgb_stamp = 0; // PID制御に使ったRGB値を読み出した周期
+    float dt;               // 前回のループからの経過時間[s]
 
     int8_t flag = 0;
-    int8_t flag_line[] = {0, 0, 0, 0};
-    int8_t power = MOTOR_POWER;
+    int8_t power = param.power;
 
     int16_t turn = 0;
-
-    char message[30];
+    int16_t fb = 0;     // PID制御による旋回値
+    int16_t target_r = param.target;    // PID制御の目標値(R値)
+    int16_t target;     // 同目標値をずれに換算した値
+    float k;            // ずれ1あたりのR値の変化(R値で調整したゲインの換算 *Line.h)
+    float ff;           // 曲率のフィードフォワードによる旋回値
+    float curvature;    // 予測した曲率
 
     /* 列挙 */
     enum {
         START,
-        MOVE,
-        CURVE_1,
-        CURVE_2,
-        CURVE_Z,
-        CURVE_4,
+        COURSE,         // 区間表(Course.c)に従ってショートカット走行
         LINETRACE,
         END,
         GOAL_LINE
@@ -34,7 +123,10 @@ void section_Linetrace()
 
     /* 初期化処理 */
     Run_init();         // 走行時間を初期化
-    Ctrl_initPID();     // PIDの値を初期化
+    k = Line_rPerOffset(target_r);      // 目標値の付近のR値の傾きで換算
+    Pid_init(&pid, param.kp * k, param.ki * k, param.kd * k); // PIDの値を初期化
+    target = Line_offsetFromR(target_r);
+    Course_start(&course, &pid);    // 区間表を先頭から実行
 
     /**
     * Main loop ****************************************************************************************************************************************
@@ -48,146 +140,77 @@ void section_Linetrace()
         // while(Run_getDistance() < 3000)
         // {
         //     power = Ctrl_getPower_Change(70, 0.5);
-        //     turn = Ctrl_getTurn_PID(Run_getRGB_R(), 65);
+        //     turn = Pid_update(&pid, Run_getRGB_R(), 65);
         //     Ctrl_motor_steer(power, turn);
         //     tslp_tsk(4 * 1000U);
         // }
         // end-----
 
-        switch(line_state)
-        {
-            case START: // スタート後の走行処理 *****************************************************
-                line_state = MOVE;
-
-                break;
+        Prof_enter(PROF_LINETRACE);   // 1周期の処理時間の計測開始
+        Run_getSnapshot(&run);    // この周期で使う走行データを一度に取得
+        dt = (run.time - pre_time) * CLOCK_DT;  // 加減速はループの回数ではなく経過時間で進める
+        pre_time = run.time;
 
-            case MOVE: // 通常走行 *****************************************************************
-                Ctrl_motor_steer_alt(100, 0, 0.2);                        // 指定出力になるまで加速して走行
-
-                if(Run_getDistance() > 1850 && flag_line[0] == 0)
-                {                                                   // 指定距離に到達した場合かつフラグが立っていない場合
-                    line_state = CURVE_1;                                  //状態を遷移する
-                }
-                else if(Run_getDistance() > 2900 && flag_line[1] == 0)
-                {                                                   // 指定距離に到達した場合かつフラグが立っていない場合
-                    line_state = CURVE_2;                                  //状態を遷移する
-                }
-                else if(Run_getDistance() > 3750 && flag_line[2] == 0)
-                {                                                   // 指定距離に到達した場合かつフラグが立っていない場合
-                    line_state = CURVE_Z;                                  //状態を遷移する
-                }
-                else if(Run_getDistance() > 5750 && flag_line[3] == 0)
-                {                                                   // 指定距離に到達した場合かつフラグが立っていない場合
-                    line_state = CURVE_4;                                  //状態を遷移する
-                }
-                // else if(Run_getDistance() > 8500)
-                // {
-                //     Ctrl_motor_steer(50, 0);
-                //     if(Run_getRGB_R() < 60 && Run_getRGB_G() < 90 && Run_getRGB_B() < 90)
-                //     {
-                //         line_state = LINETRACE;
-                //     }
-                // }
-            
-                break;
-
-            case CURVE_1: // カーブ１走行 *****************************************************************
-                if(Run_getDirection() > -80)                  // 指定角度に到達するまで
-                {
-                    Ctrl_motor_steer(100, -50);                               //左旋回
-                }
-                else                                                // 指定角度に到達した場合
-                {
-                    flag_line[0] = 1;                                   //フラグを立てる
-                    line_state = MOVE;                                     //状態を遷移する
-                }
+        if(line_state != pre_state)     // 状態が遷移した場合はトレースに記録
+        {
+            Trace_state(TRACE_LINETRACE, line_state);
+            pre_state = line_state;
+        }
 
-                break;
+        if(Param_getVersion() != version)   // Bluetoothからパラメータが変更された場合
+        {
+            version = Param_getVersion();
+            if(line_state != END)
+                target_r = param.target;
+            k = Line_rPerOffset(target_r);      // 参照値が変更された場合も換算し直す
+            Pid_setGains(&pid, param.kp * k, param.ki * k, param.kd * k);
+            target = Line_offsetFromR(target_r);
+        }
 
-            case CURVE_2: // カーブ2走行 *****************************************************************
-                if(Run_getDirection() > -220)                 // 指定角度に到達するまで
-                {
-                    Ctrl_motor_steer(100, -65);                               //左旋回
-                }
-                else                                                // 指定角度に到達した場合
-                {
-                    flag_line[1] = 1;                                   //フラグを立てる
-                    line_state = MOVE;                                     //状態を遷移する
-                }
+        switch(line_state)
+        {
+            case START: // スタート後の走行処理 *****************************************************
+                line_state = COURSE;
 
                 break;
 
-            case CURVE_Z: // カーブZ字走行 *****************************************************************                
-                if(Run_getDistance() < 4300 && Run_getDirection() < -170)
-                {                                                   // 指定距離・角度に到達するまで
-                    Ctrl_motor_steer(100, 65);                                // 右旋回
-                }
-                else if(Run_getDistance() < 4400)              //指定距離に到達するまで
-                {
-                    Ctrl_motor_steer(100, 0);                                 // 前進
-                }
-                else if(Run_getDistance() < 4800 && Run_getDirection() < -40)
-                {                                                   // 指定距離・角度に到達するまで
-                    Ctrl_motor_steer(100, 70);                                // 右旋回
-                }
-                else if(Run_getDistance() < 4900)              // 指定距離に到達するまで
-                {
-                    Ctrl_motor_steer(100, 0);                                 // 前進
-                }
-                else if(Run_getDirection() > -155)            // 指定角度に到達するまで
-                {
-                    Ctrl_motor_steer(100, -70);                               // 左旋回
-                }
-                else                                                // 指定角度に到達した場合
-                {
-                    flag_line[2] = 1;                                   // フラグを立てる
-                    line_state = MOVE;                                     // 状態を遷移する
-                }
+            case COURSE: // 区間表に従って走行 *****************************************************
+                if(Course_step(&course, &run, dt))      // 全区間を走り終えた場合(黒ラインに復帰)
+                    line_state = LINETRACE;                 // 状態を遷移する
 
                 break;
 
-            case CURVE_4: // カーブ4走行 *****************************************************************
+            case LINETRACE:
 
-                if(Run_getDistance() < 6100 && Run_getDirection() > -230)
-                {                                                   // 指定距離・角度に到達するまで
-                   Ctrl_motor_steer(100, -70);                                // 左旋回
-                }
-                else if(Run_getDistance() < 6200)              // 指定距離に到達するまで
-                {
-                    Ctrl_motor_steer(100, 0);                                 // 前進
-                }
-                else if(Run_getDirection() < -90)             // 指定角度に到達するまで
+                // 現在の走行経路の曲率に見合う旋回値を先に与え、PID制御はラインからのずれの分だけを補正する
+                // (走行経路の曲率はR/Lコースで向きが逆になるため、turn値と同じ向きに揃える)
+                // *曲率は走行体自身の車輪の動きから求めた値のため、これは自身の旋回値を倍率ff_gainで戻す正帰還になる
+                //  倍率が1以上では旋回が自己保持されるため、FF_GAIN_MAX(1未満)に制限する
+                ff = Ctrl_math_limit(param.ff_gain, 0, FF_GAIN_MAX) * Linetrace_turnFromCurvature(run.curvature * EDGE);
+                if(run.stamp[RUN_SRC_COLOR] != rgb_stamp)   // PID制御はRGB値(ずれ)が読み出された周期のみ更新する(同じ値で微分・積分を進めない)
                 {
-                    Ctrl_motor_steer(100, 55);                                // 右旋回
+                    rgb_stamp = run.stamp[RUN_SRC_COLOR];
+                    fb = Pid_update(&pid, run.offset, target);
                 }
-                else                                                // 指定角度に到達した場合
-                {
-                    Ctrl_motor_steer(100, 18);                                // 右旋回
-                    if(Run_getRGB_R() < 60 && Run_getRGB_G() < 90 && Run_getRGB_B() < 90)      // 黒ラインを検知した場合
-                    {
-                        flag_line[3] = 1;                               //フラグを立てる
-                        line_state = LINETRACE;                            //状態を遷移する
-                    }
-                }
-
-                break;
+                turn = Ctrl_math_limit(ff + fb, -200, 200);
 
-            case LINETRACE:
-
-                turn = Ctrl_getTurn_PID(Run_getRGB_R(), PID_TARGET_VAL);    // PID制御で旋回量を算出
+                // カラーセンサーは車軸より前にあるため、カーブの入口では指令した旋回値の方が走行経路の曲率より先に大きくなる
+                // 両者の大きい方をこれから走る曲率として出力を決める
+                curvature = fmaxf(fabsf(run.curvature), fabsf(Linetrace_curvatureFromTurn(turn)));
+                Ctrl_motor_steer_alt(Linetrace_powerFromCurvature(curvature), turn, 0.5);
 
-                if(-50 < turn && turn < 50)             // 旋回量が少ない場合
-                    Ctrl_motor_steer_alt(80, turn, 0.5);       // 加速して走行
-                else                                    // 旋回量が多い場合
-                    Ctrl_motor_steer_alt(60, turn, 0.5);          // 減速して走行
-
-                if(Run_getRGB_R() < 65 && Run_getRGB_G() < 90 && Run_getRGB_B() > 70 && Run_getDistance() > 11000)    // 2つ目の青ラインを検知  Run_getDistance() > 11000
+                if(run.color[COLOR_SET_LINETRACE] == COLOR_BLUE && run.distance > 11000)    // 2つ目の青ラインを検知  Run_getDistance() > 11000
                 {
-                    temp = Run_getDistance();  // 検知時点でのdistanceを仮置き
-                    log_stamp("\n\n\tBlue detected\n\n\n");
+                    temp = run.distance;  // 検知時点でのdistanceを仮置き
+                    Trace_mark(TRACE_BLUE, (int32_t)run.distance);
                     line_state = END;
+                    target_r = END_TARGET_VAL;      // 減速中の目標値とそのゲインに切り替える
+                    k = Line_rPerOffset(target_r);
+                    Pid_setGains(&pid, param.kp * k, param.ki * k, param.kd * k);
+                    target = Line_offsetFromR(target_r);
                     Ctrl_motor_steer(0,0);
                     Ctrl_arm_down(100, true);
+                    Profile_init(&profile, 100, Profile_fromPower(30), Profile_fromPower(30), PROFILE_ACCEL, PROFILE_JERK);  // 100mmの間に出力30まで加速
                 }
 
                 // Run_getAngle() = ev3_gyro_sensor_get_angle(gyro_sensor);
@@ -198,12 +221,12 @@ void section_Linetrace()
 
             case END: // 青ラインを検知したら減速 **************************************************
                 
-                if(Run_getDistance() < temp + 100)   // 指定距離進むまで
-                    power = Ctrl_getPower_Change(30, 1);  // 指定出力になるように減速
+                if(run.distance < temp + 100)   // 指定距離進むまで
+                    power = Profile_toPower(Profile_update(&profile, run.distance - temp, dt));  // 指定出力になるように加減速
                 else                        // 減速が終了
                     flag = 1;               // メインループ終了フラグ
 
-                turn = Ctrl_getTurn_PID(Run_getRGB_R(), 55);
+                turn = Pid_update(&pid, run.offset, target);
                 Ctrl_motor_steer(power, turn);    // PID制御で走行
 
                 break;
@@ -216,7 +239,9 @@ void section_Linetrace()
             default: // **************************************************************************
                 break;
         }
-        tslp_tsk(4 * 1000U); /* 4msec周期起動 */
+        Prof_exit(PROF_LINETRACE);    // 1周期の処理時間の計測終了
+
+        Clock_wait();        /* 制御周期ごとに起動 */
     }
     /**
     * Main loop END ************************************************************************************************************************************
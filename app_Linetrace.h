@@ -2,8 +2,28 @@
 #define INCLUDED_Linetrace_h_
 
 #include "Controller.h"
+#include "Prof.h"
+#include "Trace.h"
+#include "Line.h"
+#include "Profile.h"
+#include "Course.h"
+#include "Param.h"
+
+/* 調整用のパラメータ */
+typedef struct {
+    float   kp, ki, kd;         // PIDゲイン(R値の偏差に対する値 *Line_rPerOffsetで換算して使う)
+    int16_t target;             // PID制御の目標値(R値 *Line_offsetFromRでずれに換算して使う)
+    int8_t  power;              // 開始時の出力
+    int8_t  power_fast;         // 直線での出力(出力の上限)
+    int8_t  power_slow;         // 急カーブでの出力(出力の下限)
+    float   ff_gain;            // 曲率のフィードフォワードの倍率(0で無効。実際は自身の旋回の正帰還のゲインのため0 ~ 0.9 *app_Linetrace.cのFF_GAIN_MAX)
+    float   lat_accel;          // カーブで許容する横方向の加速度[mm/s^2](出力の決定に使用)
+} linetrace_param_t;
 
 /* 関数プロトタイプ宣言 */
 void section_Linetrace();
+void Linetrace_getParam(linetrace_param_t *p);
+void Linetrace_setParam(const linetrace_param_t *p);
+void Linetrace_initParam(void);     // パラメータをBluetoothから調整できるように登録(Param.h)
 
 #endif
\ No newline at end of file
@@ -1,11 +1,49 @@
 ﻿#include "app_Slalom.h"
 
 /* マクロ定義 */
+#define KP      1.38    // PIDゲイン(スラローム板上の低速(power10~20)走行用。R値の偏差に対する値で、目標値でのLine_rPerOffsetを掛けて使う *Line.h)
+#define KI      0.0
+#define KD      0.15
+#define EDGE    1       // 1でLコース、-1でRコース(Controller.cと合わせること)
+
+// 段差の上り(UP_STAIRS)
+// 傾き、または傾きの速度(Traction.h)を検知するまで一定の出力で近づき、傾いている間は車輪の停止・空転に応じて出力を増減しながら上る
+// 近づいている間(平らな場所)は車輪の回転速度のモデルを補正する(Traction_learn)
+// 傾きが戻って傾きの速度も収まり、傾きを検知してからCLIMB_MIN_DISTANCE以上進んだ時点で上りきったとみなす
+// 方位はモーター角度のみの値で保つ(ジャイロセンサーは傾きを計測するため *Run.cのDIR_GYRO_FUSION)
+#define CLIMB_POWER_APPROACH    25      // 段差に近づく出力
+#define CLIMB_POWER             30      // 上り始める出力
+#define CLIMB_POWER_MIN         20      // 出力の下限(空転している間はここまで下げる)
+#define CLIMB_POWER_MAX         45      // 出力の上限(停止している間はここまで上げる)
+#define CLIMB_POWER_STEP        1       // 1周期あたりに増減する出力
+#define CLIMB_TILT              3       // 傾きとみなす角度[deg]
+#define CLIMB_MIN_DISTANCE      60.0    // 傾きを検知してから上りきったとみなすまでの最短の走行距離[mm]
+#define CLIMB_TIMEOUT_MS        3000    // 傾きを検知してから上りきれない場合に打ち切る時間[ms]
+#define CLIMB_KP_DIR            2.0     // 上り始めの方位を保つ旋回量のゲイン(片輪だけが空転して向きが変わるのを防ぐ)
+#define CLIMB_TURN_MAX          30      // 同旋回量の上限
 
 /* グローバル変数 */
-static const sensor_port_t
-    sonar_sensor    = EV3_PORT_3,
-    gyro_sensor     = EV3_PORT_4;
+static pid_ctrl_t pid;      // スラローム区間用のPID制御器
+static int16_t trace_r;         // ゲインを換算した目標値(R値 *_traceを参照)
+static uint32_t trace_version;  // 同換算をしたときのパラメータの変更回数
+
+/* 段差の上りの状態 */
+typedef struct {
+    enum {
+        CLIMB_APPROACH,     // 傾きを検知するまで前進
+        CLIMB_UP            // 傾いている間、グリップに応じて出力を調整
+    } phase;
+    traction_t traction;    // 車輪の空転・停止の検知器
+    int8_t  power;          // 現在の出力
+    float   direction;      // 保つ方位(モーター角度のみの値)
+    float   distance;       // 傾きを検知したときの走行距離
+    uint32_t start;         // 傾きを検知したときの周期(run_data_t.tick)
+    int     pre_state;      // 前回の検知器の状態(トレース用)
+} climb_t;
+
+static int16_t Slalom_trace(int16_t offset, int16_t r);
+static void Slalom_initClimb(climb_t *c);
+static bool_t Slalom_climb(climb_t *c);
 
 /* メイン関数 */
 void section_Slalom()
@@ -16,9 +54,11 @@ void section_Slalom()
     int8_t flag = 0;        // 便利なflag
     int8_t edge = 0;        // 左コース走行時、1 でラインの左側をトレース、-1 で右側をトレース
 
-    int8_t power = 0;       // モーターの出力値を格納する変数(-100 ~ +100)
     int16_t turn = 0;       // モーターによる旋回量を格納する変数(-200 ~ +200)
 
+    uint32_t motion = 0;    // 走行命令の番号(完了待ち用)
+    climb_t climb;          // 段差の上りの状態
+
     /* 列挙 */
     enum {
         START,          // 段差の手前で段差を上る準備
@@ -31,11 +71,13 @@ void section_Slalom()
         LINETRACE,      // ラインに復帰する
         END             // 次のタスクへ移行
     } r_state = START;
+    int pre_state = -1;     // 前回のループでの状態(トレース用)
 
     /* 初期化処理 */
-    ev3_gyro_sensor_reset(gyro_sensor);     // ジャイロセンサーの初期化
+    Run_resetGyro();    // ジャイロセンサーの初期化
     Run_init();         // 走行データを初期化
-    Ctrl_initPID();     // PIDの値を初期化
+    Pid_init(&pid, KP, KI, KD); // PIDの値を初期化(ゲインはSlalom_traceで目標値ごとにずれに対する値に換算する)
+    trace_r = -1;
 
     temp = Run_getDistance();  // 指定距離ライントレースのため、処理開始時点の距離を取り置き
 
@@ -47,13 +89,21 @@ void section_Slalom()
         if(flag == 1)   // 終了フラグを確認
             return;     // 関数終了
 
+        Prof_enter(PROF_SLALOM);   // 1周期の処理時間の計測開始
+
+        if(r_state != pre_state)    // 状態が遷移した場合はトレースに記録
+        {
+            Trace_state(TRACE_SLALOM, r_state);
+            pre_state = r_state;
+        }
+
         switch(r_state)
         {
             case START: // 壁にアームを押し付けて方位を調整、後退してアームを上げる **************
 
                 if(Run_getDistance() < temp + 50)     // 指定距離に到達していない場合
                 {
-                    turn = Ctrl_getTurn_PID(Run_getRGB_R(), 60);    // PID制御で旋回量を算出
+                    turn = Slalom_trace(Run_getLineOffset(), 60);    // PID制御で旋回量を算出
                     Ctrl_motor_steer(15, turn);                       // 指定出力とPIDでライントレース走行
                 }
                 else                                        // 指定距離に到達した場合
@@ -66,23 +116,15 @@ void section_Slalom()
 
                     Ctrl_motor_steer(0, 0);                           // モーター停止
                     Ctrl_arm_up(100, true);                           // アームを上げる
+                    Slalom_initClimb(&climb);
                     r_state = UP_STAIRS;                        // 状態を遷移する
                 }
                 break;
 
             case UP_STAIRS: // 段差を上る ***************************************
-                if(-3 < Run_getAngle() && Run_getAngle() < 3)
-                {                                           // 傾きが検知されない場合
-                    Ctrl_motor_steer(25, 0);                          // 指定出力で前進
-                }
-                else                                        // 傾きを検知した場合
+                if(Slalom_climb(&climb))                    // 上りきった場合
                 {
-                    Ctrl_motor_steer(30, 0);                          // 指定出力で前進
-                    tslp_tsk(200 * 1000U);                      // 待機
-                    if(-3 > Run_getAngle() || Run_getAngle() > 3)
-                    {                                           // 傾きを検出した場合
-                        Ctrl_motor_steer(33, 0);                          // 指定出力で前進
-                    }
+                    Ctrl_motor_steer(13, 0);                          // 次の区間の出力に下げて
                     Ctrl_arm_down(30, true);                         // アームをおろす
 
                     r_state = MOVE_1;                           // 状態を遷移する
@@ -93,7 +135,7 @@ void section_Slalom()
             case MOVE_1: // 2つ目のペットボトル手前まで移動 ************************************
                 if( Run_getDistance() < temp + 180)        // 指定距離内に障害物を検知するか、指定距離を走りきるまで
                 {
-                    turn = Ctrl_getTurn_PID(Run_getRGB_R(), 51);        // PID制御で旋回量を算出
+                    turn = Slalom_trace(Run_getLineOffset(), 51);        // PID制御で旋回量を算出
                     Ctrl_motor_steer(13, turn);                           // ライントレース
                 }
                 else                                            // 指定距離内に障害物を検知したか、指定距離を走りきった場合
@@ -117,17 +159,23 @@ void section_Slalom()
 
             case MOVE_2: // 3つ目のペットボトル手前まで移動 ************************************
 
-                Slalom_run(20, -85, 100);                       // 左旋回
-                
-                Slalom_run(20, 80, 160);                        // 右旋回
+                if(motion == 0)                                 // 一連の走行命令をまとめてキューに積む
+                {
+                    Motion_pushRun(20, -85, 100);                   // 左旋回
 
-                Ctrl_runDetection(10, 0, 9, 0);                 // 障害物を検知するまで前進
+                    Motion_pushRun(20, 80, 160);                    // 右旋回
 
-                Slalom_run(20, -65, 90);                        // 左旋回
+                    Motion_pushDetection(10, 0, 9, 0);              // 障害物を検知するまで前進
 
-                Slalom_run(20, 25, 30);                         // 右旋回
+                    Motion_pushRun(20, -65, 90);                    // 左旋回
 
-                r_state = BRANCH;                               // 状態を遷移する
+                    motion = Motion_pushRun(20, 25, 30);            // 右旋回
+                }
+                else if(Motion_isDone(motion))                  // 最後の命令が完了した場合
+                {
+                    motion = 0;
+                    r_state = BRANCH;                               // 状態を遷移する
+                }
                 break;
 
             case BRANCH: // 4つ目のペットボトル手前まで移動して配置パターンを判断する ************
@@ -149,11 +197,11 @@ void section_Slalom()
 
                 Ctrl_arm_up(60, true);                               // アームを上げる
 
-                ev3_gyro_sensor_reset(gyro_sensor);             // ジャイロセンサーの初期化
+                Run_resetGyro();                                // ジャイロセンサーの初期化
                 while(-3.5 < Run_getAngle() && Run_getAngle() < 3.5)
                 {                                               // 傾きを検知するまでループ
                     Ctrl_motor_steer(20, 30);                             // 右曲がりに前進
-                    tslp_tsk(4 * 1000U);                            /* 4msec周期起動 */
+                    Clock_wait();                                   /* 制御周期ごとに起動 */
                 }
                 tslp_tsk(500 * 1000U);                          // 待機
 
@@ -179,11 +227,11 @@ void section_Slalom()
 
                 Slalom_run(20, -80, 90);                        // 左旋回
 
-                ev3_gyro_sensor_reset(gyro_sensor);             // ジャイロセンサーの初期化
+                Run_resetGyro();                                // ジャイロセンサーの初期化
                 while(-3.5 < Run_getAngle() && Run_getAngle() < 3.5)
                 {                                               // 傾きを検知するまでループ
                     Ctrl_motor_steer(20, -50);                            // 左曲がりに前進
-                    tslp_tsk(4 * 1000U);                            /* 4msec周期起動 */
+                    Clock_wait();                                   /* 制御周期ごとに起動 */
                 }
                 tslp_tsk(500 * 1000U);                          // 待機
 
@@ -198,16 +246,16 @@ void section_Slalom()
                 break;
 
             case LINETRACE: // **********************************************************
-                turn = Ctrl_getTurn_PID(Run_getRGB_R(), 60);        // PID制御で旋回量を算出(Line.cを参照)
+                turn = Slalom_trace(Run_getLineOffset(), 60);        // PID制御で旋回量を算出(Line.cを参照)
                 Ctrl_motor_steer(10, turn * edge);                    // ライントレース
                 
-                if(flag == 2 && Run_getRGB_R() < 65 && Run_getRGB_G() < 75 && Run_getRGB_B() < 95) 
+                if(flag == 2 && Run_getColor(COLOR_SET_SLALOM) == COLOR_BLACK)
                 {                                               // 黒ラインを検知
                     Ctrl_motor_steer(15, 0);                              // 前進しながら
                     r_state = END;                                  // 最後の処理に移る
                 }
 
-                if(Run_getRGB_R() < 75 && Run_getRGB_G() < 95 && Run_getRGB_B() > 120)     // 青ラインを検知
+                if(Run_getColor(COLOR_SET_SLALOM) == COLOR_BLUE)     // 青ラインを検知
                 {
                     flag = 1;                                       // フラグを立てて上のif条件を解除する
                 }
@@ -215,7 +263,7 @@ void section_Slalom()
                 break;
 
             case END: // **************************************************************
-                if(ev3_ultrasonic_sensor_get_distance(sonar_sensor) < 5)
+                if(Run_getSonarRaw() < 5)
                 {                                           // ガレージの壁を検知した場合
                     Ctrl_motor_steer(0, 0);                       // モーター停止
                     flag = 1;                               // 終了フラグを立てる
@@ -225,7 +273,9 @@ void section_Slalom()
             default:
                 break;
         }
-        tslp_tsk(4 * 1000U); /* 4msec周期起動 */
+        Prof_exit(PROF_SLALOM);    // 1周期の処理時間の計測終了
+
+        Clock_wait();        /* 制御周期ごとに起動 */
     }
     /**
     * Main loop END ************************************************************************************************************************************
@@ -233,42 +283,118 @@ void section_Slalom()
 }
 
 //*****************************************************************************
-// 関数名 : Slalpm_run
-// power        : Ctrl_motor_steer関数のpower値(-100 ~ +100)
-// turn         : Ctrl_motor_steer関数のturn値(-200 ~ +200)
-// distance     : 移動する距離
-// 概要 : 加減速なしで指定距離走行を行う(スラローム区間のスムーズな走行を実現するため)
+// 関数名 : Slalom_trace
+// 引数 : offset (ラインのエッジからのずれ[0.1mm]), r (R値で調整した目標値)
+// 返り値 : 旋回値
+// 概要 : 目標値rでライントレースする旋回値をPID制御で求める
+//       R値で調整したゲインは目標値rの付近のR値の傾きで換算する(目標値・参照値が変わった場合のみ換算し直す *Line.h)
 //*****************************************************************************
-void Slalom_run(int8_t power, int16_t turn, float distance)
+static int16_t Slalom_trace(int16_t offset, int16_t r)
 {
-    float ref_distance = Run_getDistance();                // 処理開始時点での距離を取得
-    if(power > 0 && distance > 0)                               // 前進の場合
+    float k;
+
+    if(r != trace_r || Param_getVersion() != trace_version)
     {
-        while(1)                                                    // モーターが停止するまでループ
-        {
-            Ctrl_motor_steer(power, turn);
-            if(Run_getDistance() >= (ref_distance + distance))     // 指定距離に到達した場合
-            {
-                return;                                                     // 関数を終了
-            }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
+        k = Line_rPerOffset(r);
+        Pid_setGains(&pid, KP * k, KI * k, KD * k);
+        trace_r = r;
+        trace_version = Param_getVersion();
+    }
+    return Pid_update(&pid, offset, Line_offsetFromR(r));
+}
+
+//*****************************************************************************
+// 関数名 : Slalom_initClimb
+// 引数 : c (段差の上りの状態)
+// 概要 : 段差の上りを始める(現在の方位を保って前進する)
+//*****************************************************************************
+static void Slalom_initClimb(climb_t *c)
+{
+    c->phase = CLIMB_APPROACH;
+    c->power = CLIMB_POWER_APPROACH;
+    c->direction = Run_getDirectionOdometry();
+    c->pre_state = -1;
+    Traction_init(&c->traction);
+    Traction_learn(&c->traction, true);
+}
+
+//*****************************************************************************
+// 関数名 : Slalom_climb
+// 引数 : c (段差の上りの状態)
+// 返り値 : true(上りきった、または打ち切った)/false(上っている途中)
+// 概要 : 段差の上りを1周期分進める。待機はしない。
+//       傾いている間は、車輪が止まっていれば出力を上げ、空転していれば出力を下げてグリップを保つ
+//*****************************************************************************
+static bool_t Slalom_climb(climb_t *c)
+{
+    run_data_t run;
+    traction_state_t state;
+    bool_t tilted;
+    int16_t turn;
+
+    Run_getSnapshot(&run);
+    state = Traction_update(&c->traction, &run);
+    tilted = (run.angle <= -CLIMB_TILT || CLIMB_TILT <= run.angle || Traction_isTilting(&c->traction));
+
+    if((int)state != c->pre_state)  // 検知器の状態が変わった場合はトレースに記録
+    {
+        Trace_state(TRACE_TRACTION, state);
+        c->pre_state = state;
     }
-    else if(power < 0 && distance < 0)                          // 後退の場合
+
+    switch(c->phase)
     {
-        while(1)                                                    // モーターが停止するまでループ
-        {
-            Ctrl_motor_steer(power, turn);
-            if(Run_getDistance() <= (ref_distance + distance))     // 指定距離に到達した場合
+        case CLIMB_APPROACH:
+            if(tilted)                                  // 傾きを検知した場合
             {
-                return;                                                     // 関数を終了
+                Traction_learn(&c->traction, false);
+                c->phase = CLIMB_UP;
+                c->power = CLIMB_POWER;
+                c->distance = run.distance;
+                c->start = run.tick;
             }
-            tslp_tsk(4 * 1000U); /* 4msec周期起動 */
-        }
+            break;
+
+        case CLIMB_UP:
+            if(!tilted && run.distance - c->distance >= CLIMB_MIN_DISTANCE)     // 傾きが戻った場合
+                return true;
+            if(run.tick - c->start >= CLOCK_TICKS(CLIMB_TIMEOUT_MS))           // 上りきれない場合は打ち切る
+            {
+                Trace_mark(TRACE_CLIMB_TIMEOUT, (int32_t)run.distance);
+                return true;
+            }
+
+            if(state == TRACTION_STALL && c->power < CLIMB_POWER_MAX)           // 止まっている場合は出力を上げる
+                c->power += CLIMB_POWER_STEP;
+            else if(state == TRACTION_SLIP && c->power > CLIMB_POWER_MIN)       // 空転している場合は出力を下げる
+                c->power -= CLIMB_POWER_STEP;
+            break;
+
+        default:
+            break;
     }
-    else                                                        // 正しい引数が得られなかった場合
+
+    // 実際の方位で計算した旋回値のため、Ctrl_motor_steerでのR/Lコースの変換を打ち消す
+    turn = Ctrl_math_limit(CLIMB_KP_DIR * (c->direction - run.direction_odo) * EDGE, -CLIMB_TURN_MAX, CLIMB_TURN_MAX);
+    Ctrl_motor_steer(c->power, turn);
+    return false;
+}
+
+//*****************************************************************************
+// 関数名 : Slalpm_run
+// power        : Ctrl_motor_steer関数のpower値(-100 ~ +100)
+// turn         : Ctrl_motor_steer関数のturn値(-200 ~ +200)
+// distance     : 移動する距離
+// 概要 : 加減速なしで指定距離走行を行う(スラローム区間のスムーズな走行を実現するため)
+//*****************************************************************************
+void Slalom_run(int8_t power, int16_t turn, float distance)
+{
+    uint32_t id = Motion_pushRun(power, turn, distance);        // 命令をキューに積み、周期ハンドラで実行する
+
+    if(id == 0)                                                 // 正しい引数が得られなかった場合
     {
         printf("argument out of range @ Slalom_run()\n");       // エラーメッセージを出して
         exit(1);                                                // 異常終了
     }
+    Motion_wait(id);                                            // 指定距離に到達するまで待機
 }
\ No newline at end of file
@@ -2,6 +2,12 @@
 #define INCLUDED_Slalom_h_
 
 #include "Controller.h"
+#include "Motion.h"
+#include "Prof.h"
+#include "Trace.h"
+#include "Traction.h"
+#include "Line.h"
+#include "Param.h"
 
 /* 関数プロトタイプ宣言 */
 void section_Slalom();
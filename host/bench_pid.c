@@ -0,0 +1,106 @@
+// PID制御のマイクロベンチマーク
+// 従来のfloat版(Ctrl_getTurn_PID)と固定小数点版(Pid_update)の1回あたりの処理時間と出力の差を比較する
+// 使い方 : make -C host bench_pid && ./host/bench_pid [回数]
+// *ホストのCPUはFPUを持つため、EV3(ソフトウェア浮動小数点)での差はこれより大きくなる
+
+#include <time.h>
+#include "ev3api.h"
+#include "../Pid.h"
+
+/* マクロ定義 */
+#define DELTA_T 0.004
+#define KP      1.38
+#define KI      0.0
+#define KD      0.15
+#define SAMPLES 4096    // 入力データの数(2のべき乗)
+
+/* グローバル宣言 */
+static int32_t diff[2] = {0, 0};
+static float integral = 0.0;
+
+static uint16_t input[SAMPLES];
+static volatile int32_t sink;
+
+/* 関数 */
+
+// 従来のfloat版(Controller.cのCtrl_getTurn_PIDと同じ処理)
+static int16_t float_pid(uint16_t sensor_val, uint16_t target_val)
+{
+    float p, i, d, out;
+
+    diff[0] = diff[1];
+    diff[1] = sensor_val - target_val;
+    integral += (diff[1] + diff[0]) / 2.0 * DELTA_T;
+
+    p = KP * diff[1];
+    i = KI * integral;
+    d = KD * (diff[1] - diff[0]) / DELTA_T;
+
+    out = p + i + d;
+    if(out > 200.0)  out = 200.0;
+    if(out < -200.0) out = -200.0;
+    return roundf(out);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static uint64_t cycles(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+#else
+static uint64_t cycles(void) { return 0; }
+#endif
+
+int main(int argc, char *argv[])
+{
+    long n = (argc > 1) ? atol(argv[1]) : 10000000L;
+    pid_ctrl_t pid;
+    double t0, t_float, t_fixed;
+    uint64_t c0, c_float, c_fixed;
+    long k;
+    int max_err = 0;
+    int i;
+
+    srand(1);
+    for(i = 0; i < SAMPLES; i++)            // ライン上を走行しているような入力(目標値74の周辺)
+        input[i] = 74 + (int)(30.0 * sin(i * 0.05)) + rand() % 11 - 5;
+
+    // 出力の比較
+    Pid_init(&pid, KP, KI, KD);
+    Pid_setDt(&pid, DELTA_T);               // float版と同じ周期で、微分フィルタなしで比較する
+    Pid_setFilter(&pid, 1.0);
+    for(i = 0; i < SAMPLES; i++)
+    {
+        int a = float_pid(input[i], 74);
+        int b = Pid_update(&pid, input[i], 74);
+        if(i > 0 && abs(a - b) > max_err)   // 初回はfloat版の前回偏差が0のため除外
+            max_err = abs(a - b);
+    }
+
+    // float版
+    t0 = now_ns(); c0 = cycles();
+    for(k = 0; k < n; k++)
+        sink = float_pid(input[k & (SAMPLES - 1)], 74);
+    c_float = cycles() - c0; t_float = now_ns() - t0;
+
+    // 固定小数点版
+    t0 = now_ns(); c0 = cycles();
+    for(k = 0; k < n; k++)
+        sink = Pid_update(&pid, input[k & (SAMPLES - 1)], 74);
+    c_fixed = cycles() - c0; t_fixed = now_ns() - t0;
+
+    printf("calls       : %ld\n", n);
+    printf("float PID   : %6.2f ns/call %6.1f cycles/call\n", t_float / n, (double)c_float / n);
+    printf("fixed PID   : %6.2f ns/call %6.1f cycles/call\n", t_fixed / n, (double)c_fixed / n);
+    printf("max |diff|  : %d (turn)\n", max_err);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#ifndef INCLUDED_host_ev3api_h_
+#define INCLUDED_host_ev3api_h_
+
+// ホスト(PC)ビルド用のev3api.hの代替
+// Run.c, Controller.c, app_*.cが使用するev3api/TOPPERSの関数のみを実装している
+// センサー値はhost_set_*関数またはモデル関数で与え、モーター出力は記録してhost_get_*関数やトレースファイルで参照する
+// *実機/シミュレータ用のビルドには含めないこと(Makefile.incには追加しない)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+/* TOPPERS/HRP3の型 */
+typedef int         bool_t;
+typedef int         ER;
+typedef int         ID;
+typedef uint32_t    TMO;        // タイムアウト[us]
+typedef uint64_t    SYSTIM;     // システム時刻[us]
+typedef uint32_t    HRTCNT;     // 高分解能タイマのカウント値[us]
+
+#define E_OK        0
+#define E_PAR       (-17)
+#define E_ID        (-18)
+#define E_QOVR      (-43)
+#define E_TMOUT     (-50)
+
+#ifndef true
+#define true        1
+#define false       0
+#endif
+
+/* ev3apiの型 */
+typedef enum {
+    EV3_PORT_1 = 0,
+    EV3_PORT_2,
+    EV3_PORT_3,
+    EV3_PORT_4,
+    TNUM_SENSOR_PORT
+} sensor_port_t;
+
+typedef enum {
+    EV3_PORT_A = 0,
+    EV3_PORT_B,
+    EV3_PORT_C,
+    EV3_PORT_D,
+    TNUM_MOTOR_PORT
+} motor_port_t;
+
+typedef enum {
+    NONE_SENSOR = 0,
+    ULTRASONIC_SENSOR,
+    GYRO_SENSOR,
+    TOUCH_SENSOR,
+    COLOR_SENSOR,
+    TNUM_SENSOR_TYPE
+} sensor_type_t;
+
+typedef enum {
+    NONE_MOTOR = 0,
+    MEDIUM_MOTOR,
+    LARGE_MOTOR,
+    UNREGULATED_MOTOR,
+    TNUM_MOTOR_TYPE
+} motor_type_t;
+
+typedef enum {
+    COLOR_NONE = 0,
+    COLOR_BLACK,
+    COLOR_BLUE,
+    COLOR_GREEN,
+    COLOR_YELLOW,
+    COLOR_RED,
+    COLOR_WHITE,
+    COLOR_BROWN,
+    TNUM_COLOR
+} colorid_t;
+
+typedef struct {
+    uint16_t r;
+    uint16_t g;
+    uint16_t b;
+} rgb_raw_t;
+
+/* ev3api(使用している関数のみ) */
+ER       ev3_sensor_config(sensor_port_t port, sensor_type_t type);
+ER       ev3_motor_config(motor_port_t port, motor_type_t type);
+
+ER       ev3_motor_set_power(motor_port_t port, int power);
+int      ev3_motor_get_power(motor_port_t port);
+int32_t  ev3_motor_get_counts(motor_port_t port);
+ER       ev3_motor_reset_counts(motor_port_t port);
+ER       ev3_motor_stop(motor_port_t port, bool_t brake);
+ER       ev3_motor_steer(motor_port_t left_motor, motor_port_t right_motor, int power, int turn_ratio);
+
+void     ev3_color_sensor_get_rgb_raw(sensor_port_t port, rgb_raw_t *val);
+int16_t  ev3_gyro_sensor_get_angle(sensor_port_t port);
+int16_t  ev3_gyro_sensor_get_rate(sensor_port_t port);
+ER       ev3_gyro_sensor_reset(sensor_port_t port);
+int16_t  ev3_ultrasonic_sensor_get_distance(sensor_port_t port);
+bool_t   ev3_touch_sensor_is_pressed(sensor_port_t port);
+
+ER       ev3_lcd_draw_string(const char *str, int32_t x, int32_t y);
+
+/* TOPPERSのサービスコール(使用している関数のみ) */
+ER       tslp_tsk(TMO tmout);   // シミュレーション時刻を進める
+ER       sig_sem(ID semid);     // セマフォ(資源数の上限は1)を返却
+ER       twai_sem(ID semid, TMO tmout);  // 資源を獲得できるまでシミュレーション時刻を進める
+ER       get_tim(SYSTIM *p_systim);
+HRTCNT   fch_hrt(void);
+
+/* ホスト専用の関数 ***********************************************************/
+// 初期化(センサー値、モーター、時刻をすべて0に戻す)
+void     host_init(void);
+
+// 1ms毎に呼ばれるモデル関数を設定(センサー値をスクリプトで与えるために使用)
+void     host_set_model(void (*model)(void));
+
+// 周期ハンドラの代替を設定(period_us毎に呼ばれる。datalog_cycの代わりにRun_updateなどを設定する)
+void     host_set_cyclic(void (*handler)(void), uint32_t period_us);
+
+// シミュレーション時刻がlimit_usを超えた場合に終了する(0で無効)
+void     host_set_timeout(uint64_t limit_us);
+
+// モーター出力100のときの回転速度[deg/s]
+void     host_set_motor_speed(float deg_per_sec);
+
+// 動作を記録するファイルを設定(モーター出力の変化をCSVで記録する。NULLで無効)
+void     host_set_trace(FILE *fp);
+
+// 模擬コースのカラーセンサーの検出範囲の直径[mm](host_set_lineに渡す)
+// 以前の模擬コース(エッジからのずれ1mmあたりR値4、黒20 ~ 白150)と同じ、黒から白までの変化の幅にしている
+// *Line.hのLINE_SPOT_MMとは別の値(PIDゲインはR値の変化で換算するため、LINE_SPOT_MMが実際と違っても旋回値は変わらない)
+#define  HOST_SPOT_MM   32.5
+
+// センサー値の設定
+void     host_set_rgb(uint16_t r, uint16_t g, uint16_t b);
+void     host_set_gyro(int16_t angle, int16_t rate);
+void     host_set_pitch(double deg);            // 走行体の傾き[deg]からジャイロセンサーの角度・角速度を設定(モデル関数から毎回呼ぶ *実機の取り付け)
+void     host_set_yaw(double theta);            // 走行体の向き[rad](左回転が正)から設定(ジャイロセンサーを旋回を測る向きに取り付けた場合)
+void     host_set_gyro_bias(float deg_per_sec); // ジャイロセンサーのバイアス(零点のずれ)[deg/s]
+void     host_set_line(double offset, double spot);  // ラインのエッジからのずれ[mm](白の側が正)に応じたRGB値を設定(検出範囲は直径spot[mm]の円)
+void     host_set_sonar(int16_t distance);
+void     host_set_touch(bool_t pressed);
+
+// 状態の取得
+uint64_t host_get_time(void);                   // シミュレーション時刻[us]
+float    host_get_counts(motor_port_t port);    // モーターの回転角度(小数点以下も含む)
+uint32_t host_get_motor_calls(void);            // ev3_motor_*の呼び出し回数
+
+#endif
@@ -0,0 +1,266 @@
+// ホスト(PC)ビルド用のev3api/TOPPERSの代替実装
+// 時刻はtslp_tskで1msずつ進め、そのたびにモーターの回転角度を出力から積分し、モデル関数と周期ハンドラの代替を呼び出す
+
+#include "ev3api.h"
+
+/* マクロ定義 */
+#define STEP_US         1000        // シミュレーションの刻み幅[us]
+#define MOTOR_SPEED     900.0       // モーター出力100のときの回転速度[deg/s](初期値)
+#define SEM_NUM         4           // セマフォの数(IDはkernel_cfg.hを参照)
+
+/* グローバル宣言 */
+typedef struct {
+    int     power;      // 設定された出力値
+    float   counts;     // 回転角度
+} host_motor_t;
+
+static host_motor_t motor[TNUM_MOTOR_PORT];
+
+static rgb_raw_t rgb;
+static int16_t gyro_angle, gyro_rate;
+static double gyro_deg;             // ジャイロセンサーの内部で積分した角度[deg](host_set_yawを使う場合)
+static double gyro_zero;            // リセットしたときの角度[deg]
+static float gyro_bias;
+static int16_t sonar = 255;
+static bool_t touch;
+
+static uint64_t now_us;
+static uint64_t timeout_us;
+static float motor_speed = MOTOR_SPEED;
+static uint32_t motor_calls;
+
+static void (*model_func)(void);
+static void (*cyclic_func)(void);
+static uint32_t cyclic_period_us;
+static uint64_t cyclic_next_us;
+
+static FILE *trace;
+static int sem_count[SEM_NUM];
+
+/* 関数 */
+
+// モーター出力の変化を記録
+static void host_trace(motor_port_t port, int power)
+{
+    if(trace != NULL && motor[port].power != power)
+        fprintf(trace, "%llu,%c,%d\n", (unsigned long long)now_us, 'A' + port, power);
+}
+
+// 1ms分シミュレーションを進める
+static void host_step(void)
+{
+    int i;
+
+    now_us += STEP_US;
+    for(i = 0; i < TNUM_MOTOR_PORT; i++)
+        motor[i].counts += motor[i].power * motor_speed / 100.0f * STEP_US / 1000000.0f;
+
+    if(model_func != NULL)
+        model_func();
+
+    if(cyclic_func != NULL && now_us >= cyclic_next_us)
+    {
+        cyclic_next_us += cyclic_period_us;
+        cyclic_func();
+    }
+
+    if(timeout_us != 0 && now_us > timeout_us)
+    {
+        fprintf(stderr, "host: timeout at %llu us\n", (unsigned long long)now_us);
+        exit(2);
+    }
+}
+
+void host_init(void)
+{
+    memset(motor, 0, sizeof(motor));
+    memset(&rgb, 0, sizeof(rgb));
+    gyro_angle = gyro_rate = 0;
+    gyro_deg = gyro_zero = 0.0;
+    gyro_bias = 0.0;
+    sonar = 255;
+    touch = false;
+    now_us = 0;
+    timeout_us = 0;
+    motor_speed = MOTOR_SPEED;
+    motor_calls = 0;
+    model_func = NULL;
+    cyclic_func = NULL;
+    cyclic_period_us = 0;
+    cyclic_next_us = 0;
+    memset(sem_count, 0, sizeof(sem_count));
+}
+
+void host_set_model(void (*model)(void))    { model_func = model; }
+void host_set_timeout(uint64_t limit_us)    { timeout_us = limit_us; }
+void host_set_motor_speed(float deg_per_sec){ motor_speed = deg_per_sec; }
+void host_set_trace(FILE *fp)               { trace = fp; }
+
+void host_set_cyclic(void (*handler)(void), uint32_t period_us)
+{
+    cyclic_func = handler;
+    cyclic_period_us = period_us;
+    cyclic_next_us = now_us + period_us;
+}
+
+void host_set_rgb(uint16_t r, uint16_t g, uint16_t b)   { rgb.r = r; rgb.g = g; rgb.b = b; }
+void host_set_gyro(int16_t angle, int16_t rate)         { gyro_angle = angle; gyro_rate = rate; }
+// 検出範囲のうち白にかかる割合で、黒(20, 40, 40)と白(150, 170, 170)の間の値にする
+void host_set_line(double offset, double spot)
+{
+    double u = 2.0 * offset / spot;
+    double white;
+    int v;
+
+    if(u < -1.0) u = -1.0;
+    if(u > 1.0)  u = 1.0;
+    white = 0.5 + (asin(u) + u * sqrt(1.0 - u * u)) / M_PI;
+    v = 20 + (int)lround(130.0 * white);
+    host_set_rgb(v, v + 20, v + 20);
+}
+
+void host_set_gyro_bias(float deg_per_sec)             { gyro_bias = deg_per_sec; }
+
+// ジャイロセンサーが測る軸の角度[deg]にバイアスを加え、角速度と1度単位の角度を求める
+static void host_set_gyro_deg(double deg)
+{
+    deg += gyro_bias * (now_us / 1000000.0);
+
+    gyro_rate  = (int16_t)lround((deg - gyro_deg) * 1000000.0 / STEP_US);
+    gyro_deg   = deg;
+    gyro_angle = (int16_t)lround(deg - gyro_zero);
+}
+
+// 走行体のジャイロセンサーは傾き(ピッチ)を測る向きに取り付けている(Run_getAngle、スラローム区間の傾きの判定)
+void host_set_pitch(double deg)
+{
+    host_set_gyro_deg(deg);
+}
+
+// ジャイロセンサーを旋回を測る向きに取り付けた場合(Run.cのDIR_GYRO_FUSIONを確かめる場合のみ)
+// EV3のジャイロセンサーは右回転で角度が増える
+void host_set_yaw(double theta)
+{
+    host_set_gyro_deg(-theta * 180.0 / M_PI);
+}
+
+void host_set_sonar(int16_t distance)                   { sonar = distance; }
+void host_set_touch(bool_t pressed)                     { touch = pressed; }
+
+uint64_t host_get_time(void)                { return now_us; }
+float    host_get_counts(motor_port_t port) { return motor[port].counts; }
+uint32_t host_get_motor_calls(void)         { return motor_calls; }
+
+// ev3api ***********************************************************************
+ER ev3_sensor_config(sensor_port_t port, sensor_type_t type)  { return E_OK; }
+ER ev3_motor_config(motor_port_t port, motor_type_t type)     { return E_OK; }
+
+ER ev3_motor_set_power(motor_port_t port, int power)
+{
+    motor_calls++;
+    if(power > 100)  power = 100;
+    if(power < -100) power = -100;
+    host_trace(port, power);
+    motor[port].power = power;
+    return E_OK;
+}
+
+int ev3_motor_get_power(motor_port_t port)
+{
+    motor_calls++;
+    return motor[port].power;
+}
+
+int32_t ev3_motor_get_counts(motor_port_t port)
+{
+    motor_calls++;
+    return (int32_t)floorf(motor[port].counts);
+}
+
+ER ev3_motor_reset_counts(motor_port_t port)
+{
+    motor_calls++;
+    motor[port].counts = 0.0f;
+    return E_OK;
+}
+
+ER ev3_motor_stop(motor_port_t port, bool_t brake)
+{
+    motor_calls++;
+    host_trace(port, 0);
+    motor[port].power = 0;
+    return E_OK;
+}
+
+ER ev3_motor_steer(motor_port_t left_motor, motor_port_t right_motor, int power, int turn_ratio)
+{
+    if(turn_ratio >= 0)
+    {
+        ev3_motor_set_power(left_motor, power);
+        ev3_motor_set_power(right_motor, power - turn_ratio * power / 50);
+    }
+    else
+    {
+        ev3_motor_set_power(left_motor, power + turn_ratio * power / 50);
+        ev3_motor_set_power(right_motor, power);
+    }
+    return E_OK;
+}
+
+void    ev3_color_sensor_get_rgb_raw(sensor_port_t port, rgb_raw_t *val) { *val = rgb; }
+int16_t ev3_gyro_sensor_get_angle(sensor_port_t port)          { return gyro_angle; }
+int16_t ev3_gyro_sensor_get_rate(sensor_port_t port)           { return gyro_rate; }
+ER      ev3_gyro_sensor_reset(sensor_port_t port)              { gyro_angle = 0; gyro_zero = gyro_deg; return E_OK; }
+int16_t ev3_ultrasonic_sensor_get_distance(sensor_port_t port) { return sonar; }
+bool_t  ev3_touch_sensor_is_pressed(sensor_port_t port)        { return touch; }
+
+ER ev3_lcd_draw_string(const char *str, int32_t x, int32_t y)
+{
+    fprintf(stderr, "lcd(%d,%d): %s\n", (int)x, (int)y, str);
+    return E_OK;
+}
+
+// TOPPERS ***********************************************************************
+ER tslp_tsk(TMO tmout)
+{
+    uint64_t end = now_us + tmout;
+
+    while(now_us < end)
+        host_step();
+    return E_OK;
+}
+
+ER sig_sem(ID semid)
+{
+    if(semid < 1 || semid >= SEM_NUM)
+        return E_ID;
+    if(sem_count[semid] > 0)
+        return E_QOVR;
+    sem_count[semid]++;
+    return E_OK;
+}
+
+ER twai_sem(ID semid, TMO tmout)
+{
+    uint64_t end = now_us + tmout;
+
+    if(semid < 1 || semid >= SEM_NUM)
+        return E_ID;
+    while(sem_count[semid] == 0 && now_us < end)
+        host_step();
+    if(sem_count[semid] == 0)
+        return E_TMOUT;
+    sem_count[semid]--;
+    return E_OK;
+}
+
+ER get_tim(SYSTIM *p_systim)
+{
+    *p_systim = now_us;
+    return E_OK;
+}
+
+HRTCNT fch_hrt(void)
+{
+    return (HRTCNT)now_us;
+}
@@ -0,0 +1,223 @@
+// ホスト(PC)上でライントレース区間を実行するサンプル
+// 直線のラインを単純な運動モデルで走行させ、青ラインを検知してsection_Linetraceが終了するまでの結果を表示する
+// 使い方 : make -C host && ./host/host_run [-t telemetry] [-e Trace.bin] [-s slip] [-g bias] [trace.csv]
+//   -s : SLIP_X0～SLIP_X1の範囲での左車輪の滑り[%](モーターが回った分のうち、走行体が進まない割合 *方位の推定の確認用)
+//   -g : ジャイロセンサーのバイアス[deg/s](スタート前にSTANDBY_MSだけ停止する)
+//   -e : イベントトレース(Trace.h)を指定したファイルに書き込む(tools/trace_exportでChrome trace形式に変換できる)
+//   -t : テレメトリのフレームを指定したファイル(tools/tele_recv -lが作成した擬似端末など)に書き込む
+//        端末の場合はパラメータの取得・変更要求(tools/tele_ctl)も受け付け、シミュレーションを実時間に合わせて進める
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "ev3api.h"
+#include "../Run.h"
+#include "../app_Linetrace.h"
+#include "../Prof.h"
+#include "../Color.h"
+#include "../Motion.h"
+#include "../Sonar.h"
+#include "../Tele.h"
+#include "../Param.h"
+#include "../Line.h"
+#include "../Trace.h"
+
+/* マクロ定義 */
+#define TREAD           145.0   // 車体トレッド幅[mm] (Run.cと同じ値)
+#define TIRE_DIAMETER   100.0   // タイヤ直径[mm] (Run.cと同じ値)
+#define BLUE_X          11500.0 // 青ラインの位置[mm]
+#define SLIP_X0         4000.0  // 車輪が滑る範囲[mm](-s *スラロームの板などの代わり)
+#define SLIP_X1         5000.0
+#define STANDBY_MS      3000    // スタート前に停止している時間[ms](-g *実機のスタート待ちの間にバイアスを推定するため)
+
+/* グローバル宣言 */
+static double x, y, theta;      // 走行体の位置[mm]と向き[rad](左回転が正)
+static double pre_L, pre_R;     // モーター角度の過去値
+static double max_y;            // ラインからの最大のずれ[mm]
+static int tele_in = -1;        // パラメータ要求の受信用(-tで端末を指定した場合のみ)
+static struct timespec start;   // 実時間に合わせる場合の開始時刻
+static FILE *events;            // イベントトレースの出力先
+static double slip;             // 左車輪の滑り(0～1)
+
+/* 関数 */
+
+// datalog_cycの代わりに制御周期(CLOCK_PERIOD_MS)ごとに呼ぶ関数
+static void cyclic(void)
+{
+    Run_update();
+    Motion_update();
+    Clock_tick();
+
+    // bt_task, tele_taskの代わり(実機では受信は受信タスク、送信は最低優先度のタスクが行う)
+    if(tele_in >= 0)
+    {
+        uint8_t buf[64];
+        int i, n = read(tele_in, buf, sizeof(buf));
+        struct timespec now;
+        int64_t ahead_us;
+
+        for(i = 0; i < n; i++)
+            Tele_input(buf[i]);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);   // シミュレーションが実時間より進んでいる分だけ待つ
+        ahead_us = (int64_t)host_get_time() - ((now.tv_sec - start.tv_sec) * 1000000LL + (now.tv_nsec - start.tv_nsec) / 1000);
+        if(ahead_us > 0)
+            usleep(ahead_us);
+    }
+    if(Tele_isEnabled())
+        Tele_poll();
+
+    // log_taskの代わり
+    if(events != NULL)
+        Trace_flush(events, 0);
+}
+
+// 1ms毎に走行体の位置を更新し、位置に応じたRGB値を設定する
+static void course_model(void)
+{
+    double cur_L = host_get_counts(EV3_PORT_C);
+    double cur_R = host_get_counts(EV3_PORT_B);
+    double dL = M_PI * TIRE_DIAMETER * (cur_L - pre_L) / 360.0;
+    double dR = M_PI * TIRE_DIAMETER * (cur_R - pre_R) / 360.0;
+
+    pre_L = cur_L;
+    pre_R = cur_R;
+    if(SLIP_X0 <= x && x < SLIP_X1)
+        dL *= 1.0 - slip;
+
+    theta += (dR - dL) / TREAD;
+    x += (dL + dR) / 2.0 * cos(theta);
+    y += (dL + dR) / 2.0 * sin(theta);
+    host_set_pitch(0.0);                // 平らなコース(ジャイロセンサーは傾きを測る)
+    if(fabs(y) > max_y)
+        max_y = fabs(y);
+
+    if(x > BLUE_X)                          // 青ライン
+    {
+        host_set_rgb(40, 70, 130);
+        return;
+    }
+    host_set_line(y, HOST_SPOT_MM);     // 検出範囲がエッジにかかっている割合に応じた反射光
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *trace = NULL;
+    FILE *tele = NULL;
+    run_pose_t pose;
+    int opt;
+
+    double gyro_bias = 0.0;
+    uint64_t start_us;
+
+    while((opt = getopt(argc, argv, "t:e:s:g:")) != -1)
+    {
+        switch(opt)
+        {
+            case 't':
+                tele = fopen(optarg, "wb");
+                if(tele == NULL)
+                {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'e':
+                events = fopen(optarg, "wb");
+                if(events == NULL)
+                {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+                slip = atof(optarg) / 100.0;
+                break;
+            case 'g':
+                gyro_bias = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t telemetry] [-e Trace.bin] [-s slip] [-g bias] [trace.csv]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(optind < argc)
+    {
+        trace = fopen(argv[optind], "w");
+        if(trace == NULL)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+        fprintf(trace, "time_us,port,power\n");
+        host_set_trace(trace);
+    }
+
+    host_init();
+    host_set_gyro_bias(gyro_bias);
+    Motor_init();
+    host_set_model(course_model);
+    host_set_cyclic(cyclic, CLOCK_PERIOD_US); // datalog_cycの代わり
+    host_set_timeout(240 * 1000000ULL);     // 競技時間で打ち切り
+
+    if(tele != NULL)
+    {
+        Tele_init(tele);
+        Tele_enable(true);
+        if(isatty(fileno(tele)))
+            tele_in = open(ttyname(fileno(tele)), O_RDONLY | O_NONBLOCK | O_NOCTTY);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+    Linetrace_initParam();
+    Line_initParam();
+
+    if(events != NULL)
+    {
+        trace_header_t header = { TRACE_MAGIC, TRACE_VERSION, sizeof(trace_event_t), 1, 0 };
+
+        fwrite(&header, sizeof(header), 1, events);
+        Trace_init();
+    }
+
+    if(gyro_bias != 0.0)                    // スタート待ち(停止中にジャイロセンサーのバイアスを推定する)
+        tslp_tsk(STANDBY_MS * 1000U);
+    start_us = host_get_time();
+
+    Run_init();
+    Prof_init();
+    Color_init();
+    Line_init();
+    Sonar_init();
+    Trace_event(TRACE_LINETRACE, TRACE_PH_BEGIN, 0, 0);
+    section_Linetrace();
+    Trace_event(TRACE_LINETRACE, TRACE_PH_END, 0, 0);
+
+    printf("time      : %.3f s\n", (host_get_time() - start_us) / 1000000.0);
+    printf("distance  : %.1f mm\n", Run_getDistance());
+    printf("direction : %.1f deg (odometry %.1f, model %.1f)\n", Run_getDirection(), Run_getDirectionOdometry(), -theta * 180.0 / M_PI);
+    printf("max |y|   : %.1f mm\n", max_y);
+    Run_getPose(&pose);                     // モデルのyは左が正、Run_getPoseは右が正
+    printf("pose      : x %.1f (model %.1f) mm, y %.1f (model %.1f) mm, heading %.2f (model %.2f) deg\n",
+           pose.x, x, pose.y, -y, pose.heading, -theta * 180.0 / M_PI);
+    printf("motor api : %u calls\n", host_get_motor_calls());
+    Prof_dump(stdout);
+    Motor_dump(stdout);
+
+    if(tele != NULL)
+    {
+        printf("telemetry : %u frames\n", Tele_getSent());
+        fclose(tele);
+        if(tele_in >= 0)
+            close(tele_in);
+    }
+    if(events != NULL)
+    {
+        Trace_flush(events, 1);
+        printf("events    : %u dropped\n", Trace_getDropped());
+        fclose(events);
+    }
+    if(trace != NULL)
+        fclose(trace);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef INCLUDED_host_kernel_cfg_h_
+#define INCLUDED_host_kernel_cfg_h_
+
+// ホスト(PC)ビルド用のkernel_cfg.hの代替(app.cfgで生成されるオブジェクトIDのうち、使用しているもののみ)
+
+#define CLOCK_SEM   1
+
+#endif
@@ -0,0 +1,114 @@
+// 車輪の空転・停止の検知(Traction.c)の確認
+// 合成した走行データを1周期ずつ渡し、停止・空転・傾きの速度の判定と回転速度のモデルの補正を確かめる
+// 使い方 : make -C host test (または ./host/test_traction)
+// *失敗した項目があれば終了コード1を返す
+
+#include "ev3api.h"
+#include "../Traction.h"
+
+/* マクロ定義 */
+#define POWER       30      // 左右の出力
+#define GYRO_TICKS  2       // ジャイロセンサーを読み出す間隔[周期](計測元ごとの周期の代わり)
+
+/* グローバル宣言 */
+static run_data_t run;
+static double counts_L, counts_R;   // 合成したモーターの回転角度[deg]
+static double angle;                // 合成した傾き[deg]
+static int failed;
+
+/* 関数 */
+
+// 1周期分の走行データを作って検知器に渡す(dps : 出力1あたりの回転速度[deg/s]、tilt_rate : 傾きの速度[deg/s])
+static traction_state_t step(traction_t *t, double dps, double tilt_rate)
+{
+    counts_L += dps * run.power_L * CLOCK_DT;
+    counts_R += dps * run.power_R * CLOCK_DT;
+    angle    += tilt_rate * CLOCK_DT;
+    run.tick++;
+    run.counts_L = (int32_t)counts_L;
+    run.counts_R = (int32_t)counts_R;
+    if(run.tick % GYRO_TICKS == 0)
+    {
+        run.angle = (int16_t)angle;
+        run.stamp[RUN_SRC_GYRO] = run.tick;
+    }
+    return Traction_update(t, &run);
+}
+
+// 指定時間[ms]だけ同じ条件で走行させ、最後の状態を返す
+static traction_state_t run_for(traction_t *t, int ms, double dps, double tilt_rate)
+{
+    traction_state_t state = TRACTION_OK;
+    int i;
+
+    for(i = 0; i < CLOCK_TICKS(ms); i++)
+        state = step(t, dps, tilt_rate);
+    return state;
+}
+
+static void check(const char *name, int ok)
+{
+    printf("%-40s %s\n", name, ok ? "ok" : "FAIL");
+    if(!ok)
+        failed = 1;
+}
+
+int main(void)
+{
+    traction_t t;
+    traction_state_t state;
+
+    run.power_L = POWER;
+    run.power_R = POWER;
+
+    // 見込みどおりに回っている
+    Traction_init(&t);
+    state = run_for(&t, 500, TRACTION_DPS_PER_POWER, 0.0);
+    check("steady run is OK", state == TRACTION_OK);
+
+    // 車輪が止まる(段差の角に当たった)
+    state = run_for(&t, 40, 0.0, 0.0);
+    check("stall is not confirmed before hold", state == TRACTION_OK);
+    state = run_for(&t, 200, 0.0, 0.0);
+    check("stall is detected", state == TRACTION_STALL);
+
+    // 車輪が見込みの2倍で回る(空転)
+    state = run_for(&t, 300, 2.0 * TRACTION_DPS_PER_POWER, 0.0);
+    check("spin is detected as slip", state == TRACTION_SLIP);
+    state = run_for(&t, 300, TRACTION_DPS_PER_POWER, 0.0);
+    check("recovers to OK", state == TRACTION_OK);
+
+    // 傾きの速度(段差に乗り上げる)
+    run_for(&t, 100, TRACTION_DPS_PER_POWER, 60.0);
+    check("tilt rate 60deg/s is tilting", Traction_isTilting(&t));
+    check("tilt rate is measured", t.tilt_rate > 40.0 && t.tilt_rate < 80.0);
+    run_for(&t, 200, TRACTION_DPS_PER_POWER, 0.0);
+    check("constant tilt is not tilting", !Traction_isTilting(&t));
+    angle = 0.0;                                            // 1deg単位の揺れ(誤差)
+    run_for(&t, 100, TRACTION_DPS_PER_POWER, 0.0);
+    angle = 1.0;
+    run_for(&t, 20, TRACTION_DPS_PER_POWER, 0.0);
+    check("1deg jitter is not tilting", !Traction_isTilting(&t));
+
+    // 回転速度のモデルの補正(実際は出力1あたり8deg/s)
+    Traction_init(&t);
+    Traction_learn(&t, true);
+    angle = 0.0;
+    run_for(&t, 3000, 8.0, 0.0);
+    check("model learns 8deg/s per power", t.dps_per_power > 7.8 && t.dps_per_power < 8.2);
+    run_for(&t, 500, 6.0, 60.0);                            // 上っている間は遅くなるが補正しない
+    check("model is kept while tilting", t.dps_per_power > 7.8 && t.dps_per_power < 8.2);
+    state = run_for(&t, 300, 0.0, 0.0);
+    check("model is kept while stalled", state == TRACTION_STALL && t.dps_per_power > 7.8);
+
+    // 加速中(出力を上げた直後)は補正しない
+    Traction_init(&t);
+    run_for(&t, 500, TRACTION_DPS_PER_POWER, 0.0);
+    Traction_learn(&t, true);
+    run.power_L = run.power_R = 2 * POWER;
+    run_for(&t, TRACTION_SETTLE_MS - 2 * CLOCK_PERIOD_MS, 0.6 * TRACTION_DPS_PER_POWER, 0.0);
+    check("model is kept while accelerating", t.dps_per_power == (float)TRACTION_DPS_PER_POWER);
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
@@ -0,0 +1,395 @@
+// ライントレース区間のパラメータをホスト(PC)上で探索するツール
+// カーブを含む模擬コースでsection_Linetraceを閉ループで走らせ、走行時間とラインからの最大のずれで順位を付ける
+// 1つの設定を1つの子プロセスで実行し、CPUのコア数だけ同時に実行する(各モジュールの状態がstaticのため、プロセスで分離する)
+// 結果は親プロセスと共有したメモリの各設定の欄に子プロセスが直接書き込む
+//
+// 使い方 : make -C host && ./host/tune [-j 並列数] [-r 試行数] [-s 乱数の種] [-n 表示数] [名前=最小:最大:刻み ...]
+//   名前 : kp, ki, kd, target, fast, slow, ff, lat (指定しなかったパラメータは初期値のまま)
+//   -rを指定しない場合は全組み合わせ(グリッド)、指定した場合は範囲内から一様に選んだ組み合わせを試す(刻みは無視)
+//   例   : ./host/tune kp=1.0:2.0:0.1 kd=0:0.5:0.05
+//          ./host/tune -r 2000 kp=0.8:2.5:0 kd=0:0.8:0 fast=60:100:0 slow=40:80:0
+//   *targetとPIDゲインはR値に対する値(section_Linetraceが参照値でエッジからのずれに換算する *Line.h)
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include "ev3api.h"
+#include "../Run.h"
+#include "../app_Linetrace.h"
+#include "../Color.h"
+#include "../Sonar.h"
+#include "../Motion.h"
+#include "../Line.h"
+
+/* マクロ定義 */
+#define TREAD           145.0   // 車体トレッド幅[mm] (Run.cと同じ値)
+#define TIRE_DIAMETER   100.0   // タイヤ直径[mm] (Run.cと同じ値)
+#define SENSOR_AHEAD    60.0    // 車軸からカラーセンサーまでの距離[mm]
+#define BLUE_S          11500.0 // 青ラインの位置(コースの始点からの距離)[mm]
+#define LOST_OFFSET     150.0   // ラインを見失ったとみなすずれ[mm]
+#define TIME_LIMIT      60      // 1回の走行の打ち切り時間[s]
+#define PARAM_NUM       8
+#define SWEEP_MAX       100000  // 試す組み合わせの最大数
+
+/* 模擬コース(直線と円弧をつないだもの。curvatureは左カーブが正) */
+typedef struct {
+    double length;
+    double curvature;
+} piece_t;
+
+static const piece_t course[] = {
+    { 3000.0,  0.0         },
+    {  942.5,  1.0 / 600.0 },   // 左90度
+    { 2000.0,  0.0         },
+    { 1570.8, -1.0 / 500.0 },   // 右180度
+    { 1500.0,  0.0         },
+    { 1256.6,  1.0 / 800.0 },   // 左90度
+    { 2000.0,  0.0         },
+};
+#define PIECE_NUM   ((int)(sizeof(course) / sizeof(course[0])))
+
+typedef struct {
+    double x, y, theta, s;      // 始点の位置・向き・コースの始点からの距離
+} piece_start_t;
+
+/* パラメータ */
+typedef struct {
+    const char  *name;
+    double      min, max, step;
+    bool_t      sweep;          // 探索するかどうか
+} range_t;
+
+typedef struct {
+    double      value[PARAM_NUM];
+    int         done;           // 青ラインまで走りきったかどうか
+    double      time;           // 走行時間[s]
+    double      max_offset;     // ラインからの最大のずれ[mm]
+} result_t;
+
+/* グローバル宣言 */
+static range_t range[PARAM_NUM] = {
+    { "kp" }, { "ki" }, { "kd" }, { "target" }, { "fast" }, { "slow" }, { "ff" }, { "lat" },
+};
+
+static piece_start_t piece_start[PIECE_NUM];
+static double x, y, theta;      // 走行体の位置[mm]と向き[rad](左回転が正)
+static double pre_L, pre_R;
+static int piece;               // 走行中のコースの部品
+static double max_offset;
+static result_t *current;       // 実行中の設定と結果の書き込み先(共有メモリ)
+
+/* 関数 */
+
+// 各部品の始点を求める
+static void course_build(void)
+{
+    double px = 0, py = 0, pt = 0, ps = 0, k, l;
+    int i;
+
+    for(i = 0; i < PIECE_NUM; i++)
+    {
+        piece_start[i].x = px;
+        piece_start[i].y = py;
+        piece_start[i].theta = pt;
+        piece_start[i].s = ps;
+        k = course[i].curvature;
+        l = course[i].length;
+        if(k == 0)
+        {
+            px += l * cos(pt);
+            py += l * sin(pt);
+        }
+        else
+        {
+            px += (sin(pt + k * l) - sin(pt)) / k;
+            py -= (cos(pt + k * l) - cos(pt)) / k;
+            pt += k * l;
+        }
+        ps += l;
+    }
+}
+
+// 部品iに対する点(px, py)の位置。ラインからの左方向のずれと、部品の始点からの距離を返す
+static void course_locate(int i, double px, double py, double *offset, double *along)
+{
+    const piece_start_t *p = &piece_start[i];
+    double k = course[i].curvature;
+    double cx, cy, r, a;
+
+    if(k == 0)
+    {
+        *along  =  (px - p->x) * cos(p->theta) + (py - p->y) * sin(p->theta);
+        *offset = -(px - p->x) * sin(p->theta) + (py - p->y) * cos(p->theta);
+        return;
+    }
+    r = 1.0 / fabs(k);
+    cx = p->x - sin(p->theta) / k;      // 円弧の中心(左カーブなら左側)
+    cy = p->y + cos(p->theta) / k;
+    *offset = (k > 0) ? r - hypot(px - cx, py - cy) : hypot(px - cx, py - cy) - r;
+    a = atan2(py - cy, px - cx) - atan2(p->y - cy, p->x - cx);
+    if(k < 0)
+        a = -a;
+    a = remainder(a - fabs(k) * course[i].length / 2, 2 * M_PI) + fabs(k) * course[i].length / 2;   // 円弧の中間を基準に±180度に収める
+    *along = a * r;
+}
+
+// 結果を書き込んで終了する
+static void finish(int done)
+{
+    current->time = host_get_time() / 1000000.0;
+    current->max_offset = max_offset;
+    current->done = done;
+    _exit(0);
+}
+
+// datalog_cycの代わりに制御周期(CLOCK_PERIOD_MS)ごとに呼ぶ関数
+static void cyclic(void)
+{
+    Run_update();
+    Motion_update();
+    Clock_tick();
+}
+
+// 1ms毎に走行体の位置を更新し、センサーの位置に応じたRGB値を設定する
+static void course_model(void)
+{
+    double cur_L = host_get_counts(EV3_PORT_C);
+    double cur_R = host_get_counts(EV3_PORT_B);
+    double dL = M_PI * TIRE_DIAMETER * (cur_L - pre_L) / 360.0;
+    double dR = M_PI * TIRE_DIAMETER * (cur_R - pre_R) / 360.0;
+    double sx, sy, offset, along, s;
+
+    pre_L = cur_L;
+    pre_R = cur_R;
+
+    theta += (dR - dL) / TREAD;
+    x += (dL + dR) / 2.0 * cos(theta);
+    y += (dL + dR) / 2.0 * sin(theta);
+    host_set_pitch(0.0);                // 平らなコース(ジャイロセンサーは傾きを測る)
+
+    sx = x + SENSOR_AHEAD * cos(theta);
+    sy = y + SENSOR_AHEAD * sin(theta);
+    course_locate(piece, sx, sy, &offset, &along);
+    if(along > course[piece].length && piece + 1 < PIECE_NUM)   // 次の部品へ
+    {
+        piece++;
+        course_locate(piece, sx, sy, &offset, &along);
+    }
+    if(fabs(offset) > max_offset)
+        max_offset = fabs(offset);
+    if(fabs(offset) > LOST_OFFSET)          // ラインを見失った場合は失敗
+        finish(0);
+    if(host_get_time() > TIME_LIMIT * 1000000ULL)
+        finish(0);
+
+    s = piece_start[piece].s + along;
+    if(s > BLUE_S)                          // 青ライン
+    {
+        host_set_rgb(40, 70, 130);
+        return;
+    }
+    host_set_line(offset, HOST_SPOT_MM);     // 検出範囲がエッジにかかっている割合に応じた反射光
+}
+
+// 1つの設定で走行する(子プロセス)
+static void run_one(result_t *res)
+{
+    linetrace_param_t p;
+
+    current = res;
+    Linetrace_getParam(&p);
+    p.kp             = res->value[0];
+    p.ki             = res->value[1];
+    p.kd             = res->value[2];
+    p.target         = (int16_t)res->value[3];
+    p.power_fast     = (int8_t)res->value[4];
+    p.power_slow     = (int8_t)res->value[5];
+    p.ff_gain        = res->value[6];
+    p.lat_accel      = res->value[7];
+    Linetrace_setParam(&p);
+
+    host_init();
+    host_set_model(course_model);
+    host_set_cyclic(cyclic, CLOCK_PERIOD_US);
+    Motor_init();
+    Run_init();
+    Color_init();
+    Line_init();
+    Sonar_init();
+    section_Linetrace();
+    finish(1);
+}
+
+// 初期値を探索範囲に設定
+static void range_init(void)
+{
+    linetrace_param_t p;
+    double def[PARAM_NUM];
+    int i;
+
+    Linetrace_getParam(&p);
+    def[0] = p.kp;
+    def[1] = p.ki;
+    def[2] = p.kd;
+    def[3] = p.target;
+    def[4] = p.power_fast;
+    def[5] = p.power_slow;
+    def[6] = p.ff_gain;
+    def[7] = p.lat_accel;
+    for(i = 0; i < PARAM_NUM; i++)
+    {
+        range[i].min = range[i].max = def[i];
+        range[i].step = 1;
+    }
+}
+
+// 名前=最小:最大:刻み を解析
+static int range_parse(const char *arg)
+{
+    char name[16];
+    double min, max, step;
+    int i;
+
+    if(sscanf(arg, "%15[^=]=%lf:%lf:%lf", name, &min, &max, &step) != 4 || min > max)
+        return -1;
+    for(i = 0; i < PARAM_NUM; i++)
+    {
+        if(strcmp(name, range[i].name) == 0)
+        {
+            range[i].min = min;
+            range[i].max = max;
+            range[i].step = step;
+            range[i].sweep = true;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// 組み合わせを作る(グリッドまたは乱数)
+static int make_configs(result_t *cfg, int random_num)
+{
+    int n = 0, i, idx[PARAM_NUM] = { 0 }, steps[PARAM_NUM];
+
+    if(random_num > 0)
+    {
+        for(n = 0; n < random_num && n < SWEEP_MAX; n++)
+        {
+            for(i = 0; i < PARAM_NUM; i++)
+                cfg[n].value[i] = range[i].min + (range[i].max - range[i].min) * (rand() / (RAND_MAX + 1.0));
+        }
+        return n;
+    }
+
+    for(i = 0; i < PARAM_NUM; i++)
+        steps[i] = (range[i].sweep && range[i].step > 0) ? (int)((range[i].max - range[i].min) / range[i].step + 1e-9) + 1 : 1;
+
+    while(n < SWEEP_MAX)
+    {
+        for(i = 0; i < PARAM_NUM; i++)
+            cfg[n].value[i] = range[i].min + idx[i] * range[i].step;
+        n++;
+        for(i = 0; i < PARAM_NUM; i++)      // 桁上がりで次の組み合わせへ
+        {
+            if(++idx[i] < steps[i])
+                break;
+            idx[i] = 0;
+        }
+        if(i == PARAM_NUM)
+            break;
+    }
+    return n;
+}
+
+// 順位付け(走りきったもの、走行時間、最大のずれの順)
+static int compare(const void *a, const void *b)
+{
+    const result_t *ra = a, *rb = b;
+
+    if(ra->done != rb->done)
+        return rb->done - ra->done;
+    if(ra->time != rb->time)
+        return (ra->time < rb->time) ? -1 : 1;
+    return (ra->max_offset < rb->max_offset) ? -1 : (ra->max_offset > rb->max_offset);
+}
+
+int main(int argc, char *argv[])
+{
+    result_t *cfg;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int random_num = 0, show = 10, n, next = 0, running = 0, done = 0, opt, i;
+    pid_t pid;
+
+    range_init();
+    while((opt = getopt(argc, argv, "j:r:s:n:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'j': jobs = atoi(optarg);          break;
+            case 'r': random_num = atoi(optarg);    break;
+            case 's': srand(atoi(optarg));          break;
+            case 'n': show = atoi(optarg);          break;
+            default:
+                fprintf(stderr, "usage: %s [-j jobs] [-r samples] [-s seed] [-n show] [name=min:max:step ...]\n", argv[0]);
+                return 1;
+        }
+    }
+    for(i = optind; i < argc; i++)
+    {
+        if(range_parse(argv[i]) < 0)
+        {
+            fprintf(stderr, "%s: bad range '%s' (names: kp ki kd target fast slow ff lat)\n", argv[0], argv[i]);
+            return 1;
+        }
+    }
+    if(jobs < 1)
+        jobs = 1;
+
+    // 子プロセスと共有する結果の領域(子プロセスが異常終了した場合はdoneが0のまま残る)
+    cfg = mmap(NULL, sizeof(result_t) * SWEEP_MAX, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(cfg == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    course_build();
+    n = make_configs(cfg, random_num);
+    fprintf(stderr, "%d configurations on %d jobs\n", n, jobs);
+
+    while(next < n || running > 0)
+    {
+        while(running < jobs && next < n)   // 空いているコアに次の設定を割り当てる
+        {
+            fflush(NULL);
+            pid = fork();
+            if(pid < 0)
+            {
+                perror("fork");
+                return 1;
+            }
+            if(pid == 0)
+                run_one(&cfg[next]);
+            next++;
+            running++;
+        }
+
+        if(wait(NULL) > 0)                  // 1つ終わるのを待つ
+            running--;
+    }
+
+    for(i = 0; i < n; i++)
+        done += cfg[i].done;
+    qsort(cfg, n, sizeof(cfg[0]), compare);
+
+    printf("%d / %d configurations finished\n", done, n);
+    printf("rank     kp     ki     kd target fast slow    ff    lat   time[s] max_offset[mm]\n");
+    for(i = 0; i < n && i < show; i++)
+    {
+        printf("%4d %6.3f %6.3f %6.3f %6.0f %4.0f %4.0f %5.2f %6.0f %9.3f %14.1f%s\n", i + 1,
+               cfg[i].value[0], cfg[i].value[1], cfg[i].value[2], cfg[i].value[3],
+               cfg[i].value[4], cfg[i].value[5], cfg[i].value[6], cfg[i].value[7],
+               cfg[i].time, cfg[i].max_offset, cfg[i].done ? "" : "  (lost)");
+    }
+    return 0;
+}
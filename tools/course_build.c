@@ -0,0 +1,179 @@
+// コースの区間表をテキスト形式からバイナリ形式(Course_*.bin)に変換するホスト用ツール
+// 使い方 : course_build Course_Linetrace.txt Course_Linetrace.bin   (作成したファイルをSDカードのアプリと同じ場所に置く)
+//          course_build -d Course_Linetrace.bin                    (バイナリ形式をテキスト形式で表示)
+// *EV3(ARM, リトルエンディアン)でそのまま読むため、リトルエンディアンのPCで実行すること
+//
+// テキスト形式 : 1行に1区間を「ステアリング 出力 旋回値 開始条件 終了条件1 [終了条件2]」の順に書く(#以降はコメント)
+//   ステアリング : fixed, accel, pid (pidの場合、旋回値の欄はPID制御の目標値)
+//   条件         : 対象と比較と値を空白なしで書く(例 : distance>1850, direction<=-80, color==black)。条件なしは -
+//   対象         : distance(区間の開始からの距離), direction(方位), seg(この区間の開始からの距離), color(色)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COURSE_HOST
+#include "../Course.h"
+
+static const char *const steer_name[] = { "fixed", "accel", "pid" };
+static const char *const var_name[]   = { "-", "distance", "direction", "seg", "color" };
+static const char *const op_name[]    = { ">", ">=", "<", "<=", "==" };
+static const char *const color_name[] = { "none", "black", "blue", "green", "yellow", "red", "white", "brown" };   // colorid_tと同じ順
+
+#define NUM(a)  ((int)(sizeof(a) / sizeof(a[0])))
+
+// 名前の一覧から番号を探す(見つからない場合は-1)
+static int find(const char *const *names, int num, const char *s, size_t len)
+{
+    int i;
+
+    for(i = 0; i < num; i++)
+        if(strlen(names[i]) == len && strncmp(names[i], s, len) == 0)
+            return i;
+    return -1;
+}
+
+// 条件を解析する
+static int parse_cond(const char *s, course_cond_t *cond)
+{
+    size_t len = strcspn(s, "<>=");
+    size_t op_len = strspn(s + len, "<>=");
+    const char *value = s + len + op_len;
+    char *end;
+    int var, op, color;
+
+    memset(cond, 0, sizeof(*cond));
+    if(strcmp(s, "-") == 0)
+        return 0;
+
+    var = find(var_name, NUM(var_name), s, len);
+    op = find(op_name, NUM(op_name), s + len, op_len);
+    if(op < 0 && op_len == 1 && s[len] == '=')
+        op = COURSE_OP_EQ;
+    if(var <= 0 || op < 0 || *value == '\0')
+        return -1;
+
+    cond->var = var;
+    cond->op = op;
+    if(var == COURSE_VAR_COLOR && (color = find(color_name, NUM(color_name), value, strlen(value))) >= 0)
+    {
+        cond->value = color;
+        return 0;
+    }
+    cond->value = strtof(value, &end);
+    return (*end == '\0') ? 0 : -1;
+}
+
+// 条件を表示する
+static void print_cond(const course_cond_t *cond)
+{
+    if(cond->var == COURSE_VAR_NONE || cond->var >= NUM(var_name) || cond->op >= NUM(op_name))
+        printf(" -");
+    else if(cond->var == COURSE_VAR_COLOR && cond->value >= 0 && cond->value < NUM(color_name))
+        printf(" %s%s%s", var_name[cond->var], op_name[cond->op], color_name[(int)cond->value]);
+    else
+        printf(" %s%s%g", var_name[cond->var], op_name[cond->op], cond->value);
+}
+
+// バイナリ形式をテキスト形式で表示する
+static int dump(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    course_header_t header;
+    course_seg_t seg;
+    int i;
+
+    if(fp == NULL)
+    {
+        perror(path);
+        return 1;
+    }
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != COURSE_MAGIC
+       || header.version != COURSE_VERSION || header.seg_size != sizeof(course_seg_t))
+    {
+        fprintf(stderr, "%s: not a course file\n", path);
+        return 1;
+    }
+    for(i = 0; i < header.num && fread(&seg, sizeof(seg), 1, fp) == 1; i++)
+    {
+        printf("%-6s %4d %5d", seg.steer < NUM(steer_name) ? steer_name[seg.steer] : "?", seg.power, seg.turn);
+        print_cond(&seg.entry);
+        print_cond(&seg.exit[0]);
+        print_cond(&seg.exit[1]);
+        printf("\n");
+    }
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in, *out;
+    char line[256], steer[16], entry[64], exit1[64], exit2[64];
+    course_header_t header = { COURSE_MAGIC, COURSE_VERSION, sizeof(course_seg_t), 0 };
+    course_seg_t seg[COURSE_SEG_MAX];
+    int power, turn, n, s, lineno = 0;
+
+    if(argc == 3 && strcmp(argv[1], "-d") == 0)
+        return dump(argv[2]);
+    if(argc != 3)
+    {
+        fprintf(stderr, "usage: %s Course_xxx.txt Course_xxx.bin\n       %s -d Course_xxx.bin\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    in = fopen(argv[1], "r");
+    if(in == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    memset(seg, 0, sizeof(seg));
+    while(fgets(line, sizeof(line), in) != NULL)
+    {
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';        // コメントと改行を除く
+        strcpy(exit2, "-");
+        n = sscanf(line, "%15s %d %d %63s %63s %63s", steer, &power, &turn, entry, exit1, exit2);
+        if(n <= 0)
+            continue;                               // 空行
+
+        if(header.num >= COURSE_SEG_MAX)
+        {
+            fprintf(stderr, "%s:%d: too many segments (max %d)\n", argv[1], lineno, COURSE_SEG_MAX);
+            return 1;
+        }
+        s = find(steer_name, NUM(steer_name), steer, strlen(steer));
+        if(n < 5 || s < 0 || power < -100 || power > 100 || turn < -200 || turn > 200
+           || parse_cond(entry, &seg[header.num].entry) < 0
+           || parse_cond(exit1, &seg[header.num].exit[0]) < 0
+           || parse_cond(exit2, &seg[header.num].exit[1]) < 0)
+        {
+            fprintf(stderr, "%s:%d: syntax error\n", argv[1], lineno);
+            return 1;
+        }
+        seg[header.num].steer = s;
+        seg[header.num].power = power;
+        seg[header.num].turn = turn;
+        header.num++;
+    }
+    fclose(in);
+
+    if(header.num == 0)
+    {
+        fprintf(stderr, "%s: no segments\n", argv[1]);
+        return 1;
+    }
+
+    out = fopen(argv[2], "wb");
+    if(out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(seg, sizeof(course_seg_t), header.num, out);
+    fclose(out);
+    return 0;
+}
@@ -0,0 +1,429 @@
+// 走行ログを集計するホスト用ツール
+// バイナリ形式(Log_*.bin)と、タブ区切り形式(Log_*.txt、log_decodeの出力)のどちらも読める
+// ファイルはmmapして先頭から1回だけ走査し、全体をメモリに読み込んだり値を配列に溜めたりはしない
+// Trace_markで記録したマーカーの名前(「Blue detected」など)を区切りとして、区切りごとの時間・距離・速度・加速度と、区切りの間隔を表示する
+//
+// 使い方 : log_analyze [-q] [-m] [-p 出力ファイル] Log_*.bin ...
+//   -q : ファイルごとの表示を省略し、全ファイルの集計(区切りの名前ごとの平均・最小・最大)のみ表示する
+//   -m : モーター出力と車輪の回転速度の比(Traction.hのTRACTION_DPS_PER_POWER)を全ファイルから求める
+//        出力が一定の時間がMODEL_SETTLE続いた後のSPEED_WINDOWごとの回転速度を、左右の車輪ごとに原点を通る直線で近似する
+//        (傾いている間は除く。方位はモーター角度のみの値であること *Run.cのDIR_GYRO_FUSIONが0)
+//   -p : 速度・加速度の推移をCSVで出力する(ファイルを1つ指定した場合のみ)
+// *バイナリ形式はEV3(リトルエンディアン)で書き出したものをそのまま読むため、リトルエンディアンのPCで実行すること
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LOG_HOST
+#include "../Log.h"
+
+/* マクロ定義 */
+#define SPEED_WINDOW    20      // 速度・加速度を求める間隔(レコード数。5ms周期で100ms)
+#define NAME_LEN        32      // 区切りの名前の最大長
+#define SEGMENT_MAX     64      // 1ファイルあたりの区切りの最大数
+#define SUMMARY_MAX     128     // 集計する区切りの名前の最大数
+
+#define TREAD           145.0   // 車体トレッド幅[mm](Run.cと同じ値)
+#define TIRE_DIAMETER   100.0   // タイヤ直径[mm](Run.cと同じ値)
+#define MM_PER_COUNT    (3.14159265358 * TIRE_DIAMETER / 360.0)    // モーター角度1度あたりの走行距離[mm]
+#define DEG_PER_COUNT   (TIRE_DIAMETER / (2.0 * TREAD))             // 左右のモーター角度の差1度あたりの方位の変化[deg]
+#define MODEL_SETTLE    (2 * SPEED_WINDOW)  // 出力が変わってから速度モデルに使うまでのレコード数(加減速の遅れを除く)
+#define MODEL_MIN_POWER 8       // これ未満の出力は速度モデルに使わない(Traction.hのTRACTION_MIN_POWERと同じ値)
+#define MODEL_TILT      3       // 傾きがこれ以上の間は速度モデルに使わない[deg]
+
+/* 区切り(マーカーから次のマーカーまで) */
+typedef struct {
+    char    name[NAME_LEN];
+    double  start_ms;           // 開始時刻
+    double  start_mm;           // 開始時点の距離
+    double  end_ms;
+    double  end_mm;
+    double  v_max;              // 最高速度[mm/s]
+    double  a_max;              // 最大の加速度[mm/s^2]
+    double  a_min;              // 最大の減速度(負の値)
+} segment_t;
+
+/* 全ファイルの集計 */
+typedef struct {
+    char    name[NAME_LEN];
+    int     count;
+    double  sum, min, max;      // 区切りの時間[s]
+    double  v_max_sum;
+} summary_t;
+
+/* 1ファイルの走査状態 */
+typedef struct {
+    double  t[SPEED_WINDOW];    // 直近の時刻[ms](リングバッファ)
+    double  d[SPEED_WINDOW];    // 直近の距離[mm]
+    double  v[SPEED_WINDOW];    // 直近の速度[mm/s]
+    double  dir[SPEED_WINDOW];  // 直近の方位[deg]
+    int     pre_L, pre_R;       // 前回の左右のモーター出力
+    long    steady;             // 左右のモーター出力が変わらずに続いているレコード数
+    long    n;                  // 計測値レコードの数
+    double  last_ms, last_mm;
+    segment_t seg[SEGMENT_MAX];
+    int     num_seg;
+    FILE    *profile;           // 速度・加速度の出力先(NULLで無効)
+} scan_t;
+
+static summary_t summary[SUMMARY_MAX];
+static int num_summary;
+
+// 速度モデル(左右の車輪ごとに 出力 * 回転速度 と 出力^2 の和。回転速度 = 比 * 出力 の最小二乗)
+static double model_pw[2], model_pp[2];
+static long model_n[2];
+
+/* 関数 */
+
+// 新しい区切りを開始する
+static void segment_begin(scan_t *s, const char *name, size_t len)
+{
+    segment_t *g;
+
+    while(len > 0 && (isspace((unsigned char)*name) || *name == '#'))   // 前後の空白・改行と、log_decodeが付けた'#'を除く
+    {
+        name++;
+        len--;
+    }
+    while(len > 0 && isspace((unsigned char)name[len - 1]))
+        len--;
+    if(len == 0)
+        return;
+
+    if(s->num_seg > 0)                                      // 前の区切りを閉じる
+    {
+        s->seg[s->num_seg - 1].end_ms = s->last_ms;
+        s->seg[s->num_seg - 1].end_mm = s->last_mm;
+    }
+    if(s->num_seg >= SEGMENT_MAX)
+        return;
+
+    g = &s->seg[s->num_seg++];
+    if(len >= NAME_LEN)
+        len = NAME_LEN - 1;
+    memcpy(g->name, name, len);
+    g->name[len] = '\0';
+    g->start_ms = g->end_ms = s->last_ms;
+    g->start_mm = g->end_mm = s->last_mm;
+    g->v_max = g->a_max = g->a_min = 0.0;
+}
+
+// 速度モデルに1区間を追加する(出力pの車輪がdt秒でdegだけ回った)
+static void model_add(int side, int p, double deg, double dt)
+{
+    if(p > -MODEL_MIN_POWER && p < MODEL_MIN_POWER)
+        return;
+    model_pw[side] += p * (deg / dt);
+    model_pp[side] += (double)p * p;
+    model_n[side]++;
+}
+
+// 計測値を1つ追加する(速度・加速度はSPEED_WINDOW前の値との差から求める)
+static void sample(scan_t *s, double ms, double mm, double dir, int power_L, int power_R, int angle)
+{
+    int cur = s->n % SPEED_WINDOW;
+    double v = 0.0, a = 0.0, dt, dd, ddir;
+    segment_t *g;
+
+    if(s->n == 0 || power_L != s->pre_L || power_R != s->pre_R)
+        s->steady = 0;
+    s->steady++;
+    s->pre_L = power_L;
+    s->pre_R = power_R;
+
+    if(s->n >= SPEED_WINDOW)
+    {
+        dt = (ms - s->t[cur]) / 1000.0;                     // s->t[cur]はSPEED_WINDOW個前の値
+        if(dt > 0)
+        {
+            v = (mm - s->d[cur]) / dt;
+            if(s->n >= 2 * SPEED_WINDOW)
+                a = (v - s->v[cur]) / dt;
+
+            // 距離と方位の変化を左右の車輪の回転角度に戻して速度モデルに加える(出力が落ち着いた平らな区間のみ)
+            if(s->steady > MODEL_SETTLE && angle > -MODEL_TILT && angle < MODEL_TILT && s->n % SPEED_WINDOW == 0)
+            {
+                dd   = (mm - s->d[cur]) / MM_PER_COUNT;
+                ddir = (dir - s->dir[cur]) / DEG_PER_COUNT / 2.0;
+                model_add(0, power_L, dd + ddir, dt);
+                model_add(1, power_R, dd - ddir, dt);
+            }
+        }
+    }
+    s->t[cur] = ms;
+    s->d[cur] = mm;
+    s->v[cur] = v;
+    s->dir[cur] = dir;
+    s->n++;
+    s->last_ms = ms;
+    s->last_mm = mm;
+
+    if(s->num_seg == 0)
+        segment_begin(s, "(start)", 7);
+    g = &s->seg[s->num_seg - 1];
+    if(v > g->v_max) g->v_max = v;
+    if(a > g->a_max) g->a_max = a;
+    if(a < g->a_min) g->a_min = a;
+    g->end_ms = ms;
+    g->end_mm = mm;
+
+    if(s->profile != NULL && s->n % SPEED_WINDOW == 0)      // 推移はSPEED_WINDOWごとに間引いて出力
+        fprintf(s->profile, "%.0f,%.1f,%.1f,%.1f\n", ms, mm, v, a);
+}
+
+// 数値を読む(符号・小数点に対応。区切り文字の前の空白は読み飛ばす)
+static const char *parse_num(const char *p, const char *end, double *out)
+{
+    double v = 0.0, scale = 1.0;
+    int neg = 0, digits = 0;
+
+    while(p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    if(p < end && *p == '-')
+    {
+        neg = 1;
+        p++;
+    }
+    while(p < end && *p >= '0' && *p <= '9')
+    {
+        v = v * 10.0 + (*p++ - '0');
+        digits++;
+    }
+    if(p < end && *p == '.')
+    {
+        p++;
+        while(p < end && *p >= '0' && *p <= '9')
+        {
+            scale *= 0.1;
+            v += (*p++ - '0') * scale;
+            digits++;
+        }
+    }
+    *out = neg ? -v : v;
+    return digits ? p : NULL;
+}
+
+// タブ区切り形式を走査
+static void scan_text(scan_t *s, const char *p, const char *end)
+{
+    const char *line, *eol, *q;
+    double f[9];
+    int i;
+
+    for(line = p; line < end; line = eol + 1)
+    {
+        eol = memchr(line, '\n', end - line);
+        if(eol == NULL)
+            eol = end;
+
+        // 計測値の行 : R G B Distance Direction Angle Power_L Power_R Time(ms) [Arm]
+        for(i = 0, q = line; i < 9 && q != NULL && q < eol; i++)
+        {
+            q = parse_num(q, eol, &f[i]);
+            if(q != NULL && q < eol && *q == '\t')
+                q++;
+            else if(q != NULL && i == 8 && q + 1 < eol && q[0] == 'm' && q[1] == 's')
+                q += 2;
+        }
+        if(i == 9 && q != NULL)
+        {
+            sample(s, f[8], f[3], f[4], (int)f[6], (int)f[7], (int)f[5]);
+            continue;
+        }
+
+        if(strncmp(line, "R\tG\tB", 5) == 0)                // 項目名の行
+            continue;
+        segment_begin(s, line, eol - line);                 // それ以外はマーカーの名前
+    }
+}
+
+// バイナリ形式を走査
+static int scan_binary(scan_t *s, const char *p, const char *end, const char *path)
+{
+    const log_header_t *header = (const log_header_t *)p;
+    const log_record_t *r;
+
+    if(header->version != LOG_VERSION || header->record_size != sizeof(log_record_t))
+    {
+        fprintf(stderr, "%s: unsupported version %u (record size %u)\n", path, header->version, header->record_size);
+        return -1;
+    }
+    if(end - p < (long)sizeof(*header))                  // ヘッダ(1ブロック)の途中で切れている
+    {
+        fprintf(stderr, "%s: truncated header\n", path);
+        return -1;
+    }
+    for(r = (const log_record_t *)(header + 1); (const char *)(r + 1) <= end; r++)
+    {
+        if(r->type == LOG_TYPE_DATA)
+            sample(s, (double)r->data.time * header->tick_ms, r->data.distance, r->data.direction,
+                   r->data.power_L, r->data.power_R, r->data.angle);
+        else if(r->type == LOG_TYPE_STAMP)
+            segment_begin(s, r->stamp.text, strnlen(r->stamp.text, LOG_STAMP_LEN));
+    }
+    return 0;
+}
+
+// 集計に追加
+static void summarize(const segment_t *g)
+{
+    summary_t *m = NULL;
+    double sec = (g->end_ms - g->start_ms) / 1000.0;
+    int i;
+
+    for(i = 0; i < num_summary; i++)
+        if(strcmp(summary[i].name, g->name) == 0)
+            m = &summary[i];
+    if(m == NULL)
+    {
+        if(num_summary >= SUMMARY_MAX)
+            return;
+        m = &summary[num_summary++];
+        strcpy(m->name, g->name);
+        m->min = sec;
+        m->max = sec;
+    }
+    m->count++;
+    m->sum += sec;
+    m->v_max_sum += g->v_max;
+    if(sec < m->min) m->min = sec;
+    if(sec > m->max) m->max = sec;
+}
+
+// 1ファイルを処理
+static int analyze(const char *path, int quiet, FILE *profile)
+{
+    static scan_t s;
+    struct stat st;
+    const char *p;
+    int fd, ret, i;
+    const segment_t *g;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0 || fstat(fd, &st) < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    if(st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED)
+    {
+        perror(path);
+        return -1;
+    }
+    madvise((void *)p, st.st_size, MADV_SEQUENTIAL);
+
+    memset(&s, 0, sizeof(s));
+    s.profile = profile;
+    if(st.st_size >= (off_t)offsetof(log_header_t, padding) && ((const log_header_t *)p)->magic == LOG_MAGIC)
+        ret = scan_binary(&s, p, p + st.st_size, path);
+    else
+    {
+        scan_text(&s, p, p + st.st_size);
+        ret = 0;
+    }
+    munmap((void *)p, st.st_size);
+    if(ret < 0)
+        return -1;
+
+    for(i = 0; i < s.num_seg; i++)
+        summarize(&s.seg[i]);
+    if(quiet)
+        return 0;
+
+    printf("%s: %ld records, %.3f s, %.1f mm\n", path, s.n, s.last_ms / 1000.0, s.last_mm);
+    printf("  %-31s %8s %8s %9s %8s %8s %9s %9s\n", "segment", "start[s]", "time[s]", "dist[mm]", "v_avg", "v_max", "a_max", "a_min");
+    for(i = 0; i < s.num_seg; i++)
+    {
+        g = &s.seg[i];
+        printf("  %-31s %8.3f %8.3f %9.1f %8.1f %8.1f %9.1f %9.1f\n", g->name, g->start_ms / 1000.0,
+               (g->end_ms - g->start_ms) / 1000.0, g->end_mm - g->start_mm,
+               (g->end_ms > g->start_ms) ? (g->end_mm - g->start_mm) / (g->end_ms - g->start_ms) * 1000.0 : 0.0,
+               g->v_max, g->a_max, g->a_min);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *profile = NULL;
+    int quiet = 0, model = 0, files = 0, opt, i;
+
+    while((opt = getopt(argc, argv, "qmp:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'q':
+                quiet = 1;
+                break;
+            case 'm':
+                model = 1;
+                break;
+            case 'p':
+                profile = fopen(optarg, "w");
+                if(profile == NULL)
+                {
+                    perror(optarg);
+                    return 1;
+                }
+                fprintf(profile, "time_ms,distance_mm,speed_mm_s,accel_mm_s2\n");
+                break;
+            default:
+                optind = argc + 1;
+                break;
+        }
+    }
+    if(optind >= argc || (profile != NULL && argc - optind != 1))
+    {
+        fprintf(stderr, "usage: %s [-q] [-m] [-p profile.csv] Log_xxx.bin|Log_xxx.txt ...\n", argv[0]);
+        return 1;
+    }
+
+    for(i = optind; i < argc; i++)
+    {
+        if(analyze(argv[i], quiet, profile) == 0)
+            files++;
+    }
+    if(profile != NULL)
+        fclose(profile);
+
+    if(files > 1 || quiet)                                  // 全ファイルの集計
+    {
+        printf("%d files\n", files);
+        printf("  %-31s %6s %8s %8s %8s %8s\n", "segment", "count", "avg[s]", "min[s]", "max[s]", "v_max");
+        for(i = 0; i < num_summary; i++)
+            printf("  %-31s %6d %8.3f %8.3f %8.3f %8.1f\n", summary[i].name, summary[i].count,
+                   summary[i].sum / summary[i].count, summary[i].min, summary[i].max,
+                   summary[i].v_max_sum / summary[i].count);
+    }
+
+    if(model)                                               // 速度モデル
+    {
+        if(model_n[0] + model_n[1] == 0)
+        {
+            printf("motor model: no steady samples\n");
+            return 0;
+        }
+        printf("motor model: %ld + %ld windows\n", model_n[0], model_n[1]);
+        if(model_n[0] > 0)
+            printf("  left  : %6.2f deg/s per power\n", model_pw[0] / model_pp[0]);
+        if(model_n[1] > 0)
+            printf("  right : %6.2f deg/s per power\n", model_pw[1] / model_pp[1]);
+        printf("  both  : %6.2f deg/s per power (TRACTION_DPS_PER_POWER)\n",
+               (model_pw[0] + model_pw[1]) / (model_pp[0] + model_pp[1]));
+    }
+    return 0;
+}
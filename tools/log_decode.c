@@ -0,0 +1,76 @@
+// 走行ログ(Log_*.bin)を従来のタブ区切り形式(Log_*.txt)に変換するホスト用ツール
+// 使い方 : log_decode Log_Linetrace.bin > Log_Linetrace.txt
+// *EV3(ARM, リトルエンディアン)で書き出したファイルをそのまま読むため、リトルエンディアンのPCで実行すること
+
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_HOST
+#include "../Log.h"
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    log_header_t header;
+    log_record_t record;
+    char text[LOG_STAMP_LEN + 1];
+
+    if(argc != 2)
+    {
+        fprintf(stderr, "usage: %s Log_xxx.bin\n", argv[0]);
+        return 1;
+    }
+
+    fp = fopen(argv[1], "rb");
+    if(fp == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != LOG_MAGIC)
+    {
+        fprintf(stderr, "%s: not a log file\n", argv[1]);
+        return 1;
+    }
+    if(header.version != LOG_VERSION || header.record_size != sizeof(log_record_t))
+    {
+        fprintf(stderr, "%s: unsupported version %u (record size %u)\n", argv[1], header.version, header.record_size);
+        return 1;
+    }
+
+    printf("R\tG\tB\tDistance\tDirection\tAngle\tPower_L\tPower_R\tTime\n");     // データの項目名
+
+    while(fread(&record, sizeof(record), 1, fp) == 1)
+    {
+        switch(record.type)
+        {
+            case LOG_TYPE_DATA:     // app.cで書き込んでいた形式と同じ
+                printf("%d\t%d\t%d\t%8.3f\t%9.1f\t%4d\t%4d\t%4d\t%6dms\t%d\n",
+                record.data.r,
+                record.data.g,
+                record.data.b,
+                record.data.distance,
+                record.data.direction,
+                record.data.angle,
+                record.data.power_L,
+                record.data.power_R,
+                (int)(record.data.time * header.tick_ms),
+                (int)record.data.arm_angle
+                );
+                break;
+
+            case LOG_TYPE_STAMP:    // 計測値の列を崩さないよう、'#'で始まる1行にする
+                memcpy(text, record.stamp.text, LOG_STAMP_LEN);
+                text[LOG_STAMP_LEN] = '\0';
+                printf("# %s\n", text);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,214 @@
+// Bluetooth経由で実行中のパラメータ(Param.h)を取得・変更するホスト用ツール
+// 要求をフレーム(Tele.h)で送り、EV3が制御周期の境目に反映した後の応答を表示する
+// 応答が無い場合は再送する(走行データのフレームが同時に届いていても読み飛ばす)
+//
+// 使い方 : tele_ctl [-d デバイス | -l] [list | 名前 | 名前=値] ...
+//   -d : Bluetoothのシリアルポート(/dev/rfcomm0など)
+//   -l : 擬似端末を作成してその名前を表示し、相手から最初のフレームが届いてから要求を送る(ループバック試験用)
+//        例 : tools/tele_ctl -l kp=1.5 kd list & host/host_run -t /dev/pts/N
+//   list       : 全パラメータの値を表示
+//   名前       : 値を表示
+//   名前=値    : 値を変更(範囲外の場合は変更されない)
+// *EV3(リトルエンディアン)の構造体をそのまま読み書きするため、リトルエンディアンのPCで実行すること
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "../Tele.h"         // TELE_HOSTはMakefileで定義する(Tele.cも同じ定義でビルドするため)
+
+/* マクロ定義 */
+#define TIMEOUT_MS  500     // 応答を待つ時間[ms]
+#define RETRY       3       // 再送回数
+
+/* グローバル宣言 */
+static int fd = -1;
+static tele_parser_t parser;
+
+/* 関数 */
+
+// 端末の場合はバイナリをそのまま通すよう生モードにする
+static void set_raw(int fd)
+{
+    struct termios tio;
+
+    if(tcgetattr(fd, &tio) != 0)
+        return;
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+// ループバック試験用の擬似端末を作成し、こちら側(マスター)を返す
+static int open_loopback(int *slave)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    char *name;
+
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || (name = ptsname(master)) == NULL)
+    {
+        perror("pty");
+        return -1;
+    }
+
+    // 相手が開く前や閉じた後にマスターの読み出しがエラーにならないよう、スレーブをこちらでも開いておく
+    *slave = open(name, O_RDWR | O_NOCTTY);
+    if(*slave < 0)
+    {
+        perror(name);
+        return -1;
+    }
+    set_raw(*slave);
+
+    fprintf(stderr, "tele_ctl: listening on %s\n", name);
+    return master;
+}
+
+// フレームを1つ受信する(timeout_ms以内に届かない場合は0、timeout_msが負の場合は届くまで待つ)
+static int receive(int timeout_ms)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    uint8_t c;
+
+    while(poll(&pfd, 1, timeout_ms) > 0)
+    {
+        if(read(fd, &c, 1) != 1)
+            return 0;
+        if(Tele_parse(&parser, c))
+            return 1;
+    }
+    return 0;
+}
+
+// 応答を1行表示し、成功した場合は1を返す
+static int print_ack(const tele_param_t *ack)
+{
+    switch(ack->status)
+    {
+        case TELE_PARAM_OK:
+            printf("%-*.*s = %.4f", TELE_PARAM_NAME_LEN, TELE_PARAM_NAME_LEN, ack->name, ack->value);
+            if(ack->op == TELE_TYPE_PARAM_SET)
+                printf("  (set at tick %u)", ack->time);
+            printf("\n");
+            return 1;
+        case TELE_PARAM_UNKNOWN:
+            printf("%.*s: unknown parameter\n", TELE_PARAM_NAME_LEN, ack->name);
+            return 0;
+        case TELE_PARAM_RANGE:
+            printf("%.*s: out of range (unchanged, %.4f)\n", TELE_PARAM_NAME_LEN, ack->name, ack->value);
+            return 0;
+        default:
+            printf("%.*s: error %u\n", TELE_PARAM_NAME_LEN, ack->name, ack->status);
+            return 0;
+    }
+}
+
+// 要求を送り、対応する応答を待つ(全パラメータの取得要求では最後のパラメータまで待つ)
+static int request(uint8_t op, const tele_param_t *req)
+{
+    uint8_t frame[TELE_FRAME_MAX];
+    uint32_t size = Tele_encode(frame, op, req, (req != NULL) ? sizeof(*req) : 0);
+    tele_param_t ack;
+    int retry, ok = 1;
+
+    for(retry = 0; retry <= RETRY; retry++)
+    {
+        if(write(fd, frame, size) != (ssize_t)size)
+        {
+            perror("write");
+            return 0;
+        }
+
+        while(receive(TIMEOUT_MS))
+        {
+            if(parser.type != TELE_TYPE_PARAM_ACK || parser.len != sizeof(ack))
+                continue;
+            memcpy(&ack, parser.payload, sizeof(ack));
+            if(ack.op != op)
+                continue;
+            if(op != TELE_TYPE_PARAM_LIST && strncmp(ack.name, req->name, TELE_PARAM_NAME_LEN) != 0)
+                continue;
+
+            ok &= print_ack(&ack);
+            if(op != TELE_TYPE_PARAM_LIST || ack.index + 1 >= ack.count)
+                return ok;
+        }
+    }
+
+    fprintf(stderr, "tele_ctl: no response\n");
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    tele_param_t req;
+    char *eq;
+    size_t len;
+    int slave = -1, loopback = 0, ok = 1;
+    int opt, i;
+
+    while((opt = getopt(argc, argv, "d:l")) != -1)
+    {
+        switch(opt)
+        {
+            case 'd':
+                fd = open(optarg, O_RDWR | O_NOCTTY);
+                if(fd < 0)
+                {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                loopback = 1;
+                fd = open_loopback(&slave);
+                break;
+            default:
+                fd = -1;
+                break;
+        }
+    }
+    if(fd < 0 || optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [-d device | -l] [list | name | name=value] ...\n", argv[0]);
+        return 1;
+    }
+    if(isatty(fd))
+        set_raw(fd);
+
+    Tele_initParser(&parser);
+    if(loopback)
+        receive(-1);        // 相手が動き始めるまで待つ
+
+    for(i = optind; i < argc; i++)
+    {
+        memset(&req, 0, sizeof(req));
+
+        if(strcmp(argv[i], "list") == 0)
+        {
+            ok &= request(TELE_TYPE_PARAM_LIST, NULL);
+            continue;
+        }
+
+        eq = strchr(argv[i], '=');
+        len = (eq != NULL) ? (size_t)(eq - argv[i]) : strlen(argv[i]);
+        memcpy(req.name, argv[i], (len < TELE_PARAM_NAME_LEN) ? len : TELE_PARAM_NAME_LEN);
+        if(eq != NULL)
+        {
+            req.value = strtof(eq + 1, NULL);
+            ok &= request(TELE_TYPE_PARAM_SET, &req);
+        }
+        else
+            ok &= request(TELE_TYPE_PARAM_GET, &req);
+    }
+
+    if(slave >= 0)
+        close(slave);
+    close(fd);
+    return ok ? 0 : 1;
+}
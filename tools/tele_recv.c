@@ -0,0 +1,155 @@
+// Bluetoothテレメトリ(Tele.h)を受信して表示するホスト用ツール
+// 受信したバイト列から同期バイトを探してフレームを切り出し(Tele_parse)、CRCが一致したものだけを1行ずつ表示する
+// 起動時のメッセージやエコーバックなどの文字が混ざっても、次の同期バイトから読み直す
+//
+// 使い方 : tele_recv [-c] [-l] [デバイス]
+//   デバイス : Bluetoothのシリアルポート(/dev/rfcomm0など)。省略した場合や"-"の場合は標準入力から読む
+//   -c : CSV形式で出力する
+//   -l : 擬似端末を作成してその名前を表示し、そこに書き込まれたフレームを受信する(ループバック試験用)
+//        例 : tools/tele_recv -l & host/host_run -t /dev/pts/N
+//        (受信を始めてから1秒間何も届かなければ終了する)
+// *EV3(リトルエンディアン)の構造体をそのまま読むため、リトルエンディアンのPCで実行すること
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "../Tele.h"         // TELE_HOSTはMakefileで定義する(Tele.cも同じ定義でビルドするため)
+
+/* マクロ定義 */
+#define IDLE_MS     1000    // ループバック試験で終了とみなす無受信時間[ms]
+
+/* 関数 */
+
+// 走行データのフレームを1行表示
+static void print_run(const tele_run_t *t, int csv)
+{
+    double time = (double)t->time * t->period_ms / 1000.0;
+
+    if(csv)
+        printf("%.3f,%.1f,%.2f,%d,%d,%.2f,%d,%d,%d,%d,%d,%u,%u,%u,%u,%d,%d,%d\n",
+               time, t->distance, t->direction, t->x, t->y, t->heading / 100.0, t->speed, t->curvature,
+               t->power_L, t->power_R, t->turn, t->r, t->g, t->b, t->color, t->angle, t->sonar, t->sonar_conf);
+    else
+        printf("%8.3f s  dist %8.1f  dir %7.2f  pos (%6d, %6d) %7.2f  v %5d  k %6d  pwr %4d %4d  turn %4d  rgb %3u %3u %3u  col %u\n",
+               time, t->distance, t->direction, t->x, t->y, t->heading / 100.0, t->speed, t->curvature,
+               t->power_L, t->power_R, t->turn, t->r, t->g, t->b, t->color);
+    fflush(stdout);
+}
+
+// 端末の場合はバイナリをそのまま通すよう生モードにする
+static void set_raw(int fd)
+{
+    struct termios tio;
+
+    if(tcgetattr(fd, &tio) != 0)
+        return;
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+// ループバック試験用の擬似端末を作成し、受信側(マスター)を返す
+static int open_loopback(int *slave)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    char *name;
+
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 || (name = ptsname(fd)) == NULL)
+    {
+        perror("pty");
+        return -1;
+    }
+
+    // 書き込み側が開く前や閉じた後にマスターの読み出しがエラーにならないよう、スレーブをこちらでも開いておく
+    *slave = open(name, O_RDWR | O_NOCTTY);
+    if(*slave < 0)
+    {
+        perror(name);
+        return -1;
+    }
+    set_raw(*slave);
+
+    fprintf(stderr, "tele_recv: listening on %s\n", name);
+    return fd;
+}
+
+int main(int argc, char *argv[])
+{
+    tele_parser_t parser;
+    tele_run_t run;
+    uint8_t buf[256];
+    struct pollfd pfd;
+    int fd = 0, slave = -1;
+    int csv = 0, loopback = 0;
+    int opt, i, n;
+
+    while((opt = getopt(argc, argv, "cl")) != -1)
+    {
+        switch(opt)
+        {
+            case 'c': csv = 1;      break;
+            case 'l': loopback = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-c] [-l] [device]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(loopback)
+        fd = open_loopback(&slave);
+    else if(optind < argc && strcmp(argv[optind], "-") != 0)
+    {
+        fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+        if(fd < 0)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    if(fd < 0)
+        return 1;
+    if(isatty(fd))
+        set_raw(fd);
+
+    Tele_initParser(&parser);
+
+    if(csv)
+        printf("time,distance,direction,x,y,heading,speed,curvature,power_L,power_R,turn,r,g,b,color,angle,sonar,sonar_conf\n");
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while(1)
+    {
+        if(loopback && parser.frames > 0 && poll(&pfd, 1, IDLE_MS) == 0)
+            break;
+
+        n = read(fd, buf, sizeof(buf));
+        if(n <= 0)
+            break;
+
+        for(i = 0; i < n; i++)
+        {
+            if(!Tele_parse(&parser, buf[i]))
+                continue;
+            if(parser.type == TELE_TYPE_RUN && parser.len == sizeof(run))
+            {
+                memcpy(&run, parser.payload, sizeof(run));
+                print_run(&run, csv);
+            }
+        }
+    }
+
+    fprintf(stderr, "tele_recv: %u frames, %u lost, %u crc errors, %u bytes skipped\n",
+            parser.frames, parser.lost, parser.crc_errors, parser.skipped);
+
+    if(slave >= 0)
+        close(slave);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,118 @@
+// イベントトレース(Trace.bin)をChrome trace / Perfetto用のJSONに変換するホスト用ツール
+// chrome://tracing または https://ui.perfetto.dev で開くと、区間・状態遷移・マーカー・制御周期の待機を時系列で表示できる
+//
+// 使い方 : trace_export [-w] Trace.bin > trace.json
+//   -w : 制御周期の待機(Clock_wait)を出力しない(長い走行でファイルが大きくなる場合)
+// *EV3(ARM, リトルエンディアン)で書き出したファイルをそのまま読むため、リトルエンディアンのPCで実行すること
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TRACE_HOST
+#include "../Trace.h"
+
+/* グローバル宣言 */
+static const char *const names[TNUM_TRACE] = { TRACE_EVENTS(TRACE_NAME) };
+
+/* 関数 */
+
+// イベント名(未知の番号は番号で表示)
+static const char *event_name(uint16_t id)
+{
+    static char buf[16];
+
+    if(id < TNUM_TRACE)
+        return names[id];
+    snprintf(buf, sizeof(buf), "event %u", id);
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *fp;
+    trace_header_t header;
+    trace_event_t e;
+    uint32_t pre = 0;
+    int64_t t = 0;          // 先頭のレコードからの時刻[us](32bitの折り返しを補正)
+    long n = 0;
+    int no_wait = 0, opt;
+
+    while((opt = getopt(argc, argv, "w")) != -1)
+    {
+        if(opt != 'w')
+        {
+            fprintf(stderr, "usage: %s [-w] Trace.bin > trace.json\n", argv[0]);
+            return 1;
+        }
+        no_wait = 1;
+    }
+    if(optind + 1 != argc)
+    {
+        fprintf(stderr, "usage: %s [-w] Trace.bin > trace.json\n", argv[0]);
+        return 1;
+    }
+
+    fp = fopen(argv[optind], "rb");
+    if(fp == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if(fread(&header, sizeof(header), 1, fp) != 1 || header.magic != TRACE_MAGIC)
+    {
+        fprintf(stderr, "%s: not a trace file\n", argv[optind]);
+        return 1;
+    }
+    if(header.version != TRACE_VERSION || header.event_size != sizeof(trace_event_t))
+    {
+        fprintf(stderr, "%s: unsupported version %u (event size %u)\n", argv[optind], header.version, header.event_size);
+        return 1;
+    }
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"EV3\"}},\n");
+    printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main_task\"}}");
+
+    while(fread(&e, sizeof(e), 1, fp) == 1)
+    {
+        if(n++ > 0)
+            t += (int32_t)(e.time - pre) * (int64_t)header.time_us;
+        pre = e.time;
+
+        if(e.id == TRACE_WAIT && no_wait)
+            continue;
+
+        switch(e.phase)
+        {
+            case TRACE_PH_BEGIN:
+            case TRACE_PH_END:
+                printf(",\n{\"name\":\"%s\",\"cat\":\"section\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":1}",
+                       event_name(e.id), e.phase, (long long)t);
+                break;
+
+            case TRACE_PH_COMPLETE:
+                printf(",\n{\"name\":\"%s\",\"cat\":\"wait\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%d,\"pid\":1,\"tid\":1,\"args\":{\"ticks\":%d}}",
+                       event_name(e.id), (long long)t, (int)(e.arg1 * header.time_us), (int)e.arg0);
+                break;
+
+            case TRACE_PH_INSTANT:
+                printf(",\n{\"name\":\"%s\",\"cat\":\"marker\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%lld,\"pid\":1,\"tid\":1,\"args\":{\"distance\":%d}}",
+                       event_name(e.id), (long long)t, (int)e.arg0);
+                break;
+
+            case TRACE_PH_COUNTER:      // 区間ごとの状態の推移
+                printf(",\n{\"name\":\"%s %s\",\"ph\":\"C\",\"ts\":%lld,\"pid\":1,\"args\":{\"state\":%d}}",
+                       event_name((uint16_t)e.arg0), event_name(e.id), (long long)t, (int)e.arg1);
+                break;
+
+            default:
+                break;
+        }
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "%s: %ld events\n", argv[optind], n);
+    fclose(fp);
+    return 0;
+}